@@ -0,0 +1,215 @@
+/**
+ * vim: set ts=4 sw=4 tw=99 noet :
+ * =============================================================================
+ * SourceMod Source Scramble Extension
+ * 
+ * Copyright (C) 2019 nosoop
+ * Copyright (C) 2023 cravenge
+ *
+ * All rights reserved
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2", the
+ * "Source Engine", the "SourcePawn JIT" and any Game MODs that run on software
+ * by the Valve Corporation. You must obey the GNU General Public License in
+ * all respects for all other code used. Additionally, AlliedModders LLC grants
+ * this exception to all derivative works. AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>
+ *
+ * Version: $Id$
+ */
+
+#include <sm_platform.h>
+
+#include "codecave.h"
+#include "pageprotect.h"
+
+#include <algorithm>
+#include <vector>
+
+#if defined PLATFORM_WINDOWS
+#include <windows.h>
+
+#else
+#include <sys/mman.h>
+
+#endif
+
+static constexpr size_t CAVE_REGION_SIZE = 0x10000;
+
+// Pages are only writable until their cave is finished, so no two caves share one
+static constexpr size_t CAVE_ALIGNMENT = 0x1000;
+
+// Short of 2 GiB, so that a jump from anywhere in the region still reaches back
+static constexpr uintptr_t CAVE_REACH = 0x7FF00000;
+
+// Caves are handed out in order and their space is never reused
+struct CaveRegion {
+    uint8_t* base;
+    size_t size;
+    size_t used;
+    std::vector< std::pair< size_t, size_t > > caves;   // Offset and size of those not freed yet
+};
+
+static std::vector< CaveRegion > s_Regions;
+
+static bool IsInReach( uintptr_t lower, uintptr_t upper, uintptr_t near ) {
+#ifdef PLATFORM_X64
+    uintptr_t farthest = std::max( near > lower ? near - lower : lower - near, near > upper ? near - upper : upper - near );
+    return farthest < CAVE_REACH;
+#else
+    return true;
+#endif
+}
+
+static uint8_t* MapRegion( uintptr_t hint, size_t size ) {
+#if defined PLATFORM_WINDOWS
+    return reinterpret_cast< uint8_t* >( VirtualAlloc( reinterpret_cast< void* >( hint ), size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE ) );
+#else
+    int flags = MAP_PRIVATE | MAP_ANON;
+# ifdef MAP_FIXED_NOREPLACE
+    // Fails outright if the hint is taken instead of mapping somewhere else
+    if( hint ) {
+        flags |= MAP_FIXED_NOREPLACE;
+    }
+# endif
+
+    void* mem = mmap( reinterpret_cast< void* >( hint ), size, PROT_READ | PROT_WRITE, flags, -1, 0 );
+    return mem != MAP_FAILED ? reinterpret_cast< uint8_t* >( mem ) : nullptr;
+#endif
+}
+
+static void UnmapRegion( uint8_t* base, size_t size ) {
+#if defined PLATFORM_WINDOWS
+    VirtualFree( base, 0, MEM_RELEASE );
+#else
+    munmap( base, size );
+#endif
+}
+
+// Tries addresses moving outwards from "near" until one is free and close enough
+static CaveRegion* NewRegion( uintptr_t near, size_t size ) {
+    size_t regionSize = ( size + CAVE_REGION_SIZE - 1 ) & ~( CAVE_REGION_SIZE - 1 );
+
+    uint8_t* base = nullptr;
+#ifdef PLATFORM_X64
+    uintptr_t origin = near & ~( CAVE_REGION_SIZE - 1 );
+    for( uintptr_t step = 0; base == nullptr && step + regionSize < CAVE_REACH; step += CAVE_REGION_SIZE ) {
+        uintptr_t candidates[2] = { origin + step, step <= origin ? origin - step : 0 };
+        for( uintptr_t candidate : candidates ) {
+            if( candidate < CAVE_REGION_SIZE || ( step && candidate == origin ) ) {
+                continue;
+            }
+
+            uint8_t* mem = MapRegion( candidate, regionSize );
+            if( mem == nullptr ) {
+                continue;
+            } else if( !IsInReach( reinterpret_cast< uintptr_t >( mem ), reinterpret_cast< uintptr_t >( mem ) + regionSize, near ) ) {
+                UnmapRegion( mem, regionSize );
+                continue;
+            }
+
+            base = mem;
+            break;
+        }
+    }
+#else
+    base = MapRegion( 0, regionSize );
+#endif
+
+    if( base == nullptr ) {
+        return nullptr;
+    }
+
+    CaveRegion region;
+    region.base = base;
+    region.size = regionSize;
+    region.used = 0;
+    s_Regions.push_back( std::move( region ) );
+    return &s_Regions.back();
+}
+
+void* AllocateCodeCave( const void* near, size_t size ) {
+    uintptr_t target = reinterpret_cast< uintptr_t >( near );
+    size = ( size + CAVE_ALIGNMENT - 1 ) & ~( CAVE_ALIGNMENT - 1 );
+
+    for( CaveRegion &region : s_Regions ) {
+        uintptr_t base = reinterpret_cast< uintptr_t >( region.base );
+        if( !IsInReach( base, base + region.size, target ) ) {
+            continue;
+        }
+
+        if( region.size - region.used >= size ) {
+            region.caves.push_back( std::make_pair( region.used, size ) );
+            region.used += size;
+            return region.base + region.caves.back().first;
+        }
+    }
+
+    CaveRegion* region = NewRegion( target, size );
+    if( region == nullptr ) {
+        return nullptr;
+    }
+
+    region->caves.push_back( std::make_pair( static_cast< size_t >( 0 ), size ) );
+    region->used = size;
+    return region->base;
+}
+
+bool FinishCodeCave( void* cave ) {
+    auto addr = reinterpret_cast< uint8_t* >( cave );
+    for( const CaveRegion &region : s_Regions ) {
+        if( addr < region.base || addr >= region.base + region.size ) {
+            continue;
+        }
+
+        size_t offset = static_cast< size_t >( addr - region.base );
+        for( const std::pair< size_t, size_t > &entry : region.caves ) {
+            if( entry.first == offset ) {
+                return MakeExecutable( cave, entry.second );
+            }
+        }
+        return false;
+    }
+    return false;
+}
+
+void FreeCodeCave( void* cave ) {
+    auto addr = reinterpret_cast< uint8_t* >( cave );
+    for( CaveRegion &region : s_Regions ) {
+        if( addr < region.base || addr >= region.base + region.size ) {
+            continue;
+        }
+
+        size_t offset = static_cast< size_t >( addr - region.base );
+        region.caves.erase( std::remove_if( region.caves.begin(), region.caves.end(), [offset]( const std::pair< size_t, size_t > &entry ) {
+            return entry.first == offset;
+        } ), region.caves.end() );
+        return;
+    }
+}
+
+void CodeCaveShutdown() {
+    s_Regions.erase( std::remove_if( s_Regions.begin(), s_Regions.end(), []( const CaveRegion &region ) {
+        if( !region.caves.empty() ) {
+            return false;
+        }
+
+        UnmapRegion( region.base, region.size );
+        return true;
+    } ), s_Regions.end() );
+}
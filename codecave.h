@@ -0,0 +1,65 @@
+/**
+ * vim: set ts=4 sw=4 tw=99 noet :
+ * =============================================================================
+ * SourceMod Source Scramble Extension
+ * 
+ * Copyright (C) 2019 nosoop
+ * Copyright (C) 2023 cravenge
+ *
+ * All rights reserved
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2", the
+ * "Source Engine", the "SourcePawn JIT" and any Game MODs that run on software
+ * by the Valve Corporation. You must obey the GNU General Public License in
+ * all respects for all other code used. Additionally, AlliedModders LLC grants
+ * this exception to all derivative works. AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>
+ *
+ * Version: $Id$
+ */
+
+#ifndef _INCLUDE_SOURCEMOD_SRCSCRMBL_CODECAVE_H_
+#define _INCLUDE_SOURCEMOD_SRCSCRMBL_CODECAVE_H_
+
+# ifndef _STDLIB_H_
+# include <stdlib.h>
+
+# endif
+# ifndef _STDINT_H
+# include "stdint.h"
+
+# endif
+// Memory for patches that jump out to code of their own. Caves are carved out of larger
+// regions, each placed within reach of a rel32 jump from the code it was made for, and start
+// on a page of their own. They come back writable but not executable; returns null if no
+// such memory could be found
+void* AllocateCodeCave( const void* near, size_t size );
+
+// Turns a cave read-only and executable once its code is written. It cannot be written to
+// again after that
+bool FinishCodeCave( void* cave );
+
+// Freed caves are never handed out again and stay mapped until the extension unloads, so a
+// thread still running one when its patch is disabled finds the old code there rather than
+// a fault or someone else's
+void FreeCodeCave( void* cave );
+
+// Unmaps every region without caves; those of one-time patches are left for good
+void CodeCaveShutdown();
+
+#endif // _INCLUDE_SOURCEMOD_SRCSCRMBL_CODECAVE_H_
@@ -31,9 +31,12 @@
 
 #include "PseudoAddrManager.h"
 
+#include <algorithm>
+
 #if defined PLATFORM_LINUX
 #include <stddef.h>
 #include <stdio.h>
+#include <string.h>
 
 #elif defined PLATFORM_APPLE
 #include <mach/mach.h>
@@ -42,58 +45,94 @@
 #endif
 PseudoAddressManager pseudoAddr;
 
-PseudoAddressManager::PseudoAddressManager() : m_NumEntries( 0 ) {}
+PseudoAddressManager::PseudoAddressManager() : m_NumEvictions( 0 ), m_NumFailures( 0 ) {
+    for( uint32_t i = 0; i < PSEUDO_ENTRIES; i++ ) {
+        m_Bases[i].store( nullptr, std::memory_order_relaxed );
+        m_Keys[i].store( nullptr, std::memory_order_relaxed );
+        m_RunLength[i].store( 0, std::memory_order_relaxed );
+        m_RunStart[i].store( static_cast< uint16_t >( i ), std::memory_order_relaxed );
+        m_Refs[i].store( 0, std::memory_order_relaxed );
+        m_Exposed[i].store( false, std::memory_order_relaxed );
+        m_Taken[i] = false;
+    }
+    for( auto &slot : m_BaseIndex ) {
+        slot.store( 0, std::memory_order_relaxed );
+    }
+#ifdef PLATFORM_LINUX
+
+    m_Regions.store( new std::vector< Region >(), std::memory_order_relaxed );
+    m_RegionReaders.store( 0, std::memory_order_relaxed );
+#endif
+}
 
-// A pseudo address consists of a table index in the upper 6 bits and an offset in the
-// lower 26 bits. The table consists of memory allocation base addresses.
+PseudoAddressManager::~PseudoAddressManager() {
+#ifdef PLATFORM_LINUX
+    delete m_Regions.load( std::memory_order_relaxed );
+    for( const std::vector< Region >* regions : m_RetiredRegions ) {
+        delete regions;
+    }
+#endif
+}
+
+// A pseudo address consists of a table index and an offset. The table consists of memory
+// allocation base addresses and, once those run out, runs of 256KB-aligned chunks.
 void* PseudoAddressManager::FromPseudoAddress( uint32_t paddr ) {
 #ifdef PLATFORM_X64
-    uint8_t index = paddr >> PSEUDO_OFFSET_BITS;
-    if( index >= m_NumEntries )
+    uint32_t index, offset;
+    if( paddr >= PSEUDO_CHUNK_START ) {
+        index = PSEUDO_PRIMARY_ENTRIES + ( ( paddr - PSEUDO_CHUNK_START ) >> PSEUDO_CHUNK_OFFSET_BITS );
+        offset = paddr & ( ( 1 << PSEUDO_CHUNK_OFFSET_BITS ) - 1 );
+    } else {
+        index = paddr >> PSEUDO_OFFSET_BITS;
+        offset = paddr & ( ( 1 << PSEUDO_OFFSET_BITS ) - 1 );
+    }
+
+    void* base = m_Bases[index].load( std::memory_order_acquire );
+    if( base == nullptr )
         return nullptr;
 
-    uint32_t offset = paddr & ( ( 1 << PSEUDO_OFFSET_BITS ) - 1 );
-    return reinterpret_cast< void* >( reinterpret_cast< uintptr_t >( m_AllocBases[index] ) + offset );
+    return reinterpret_cast< void* >( reinterpret_cast< uintptr_t >( base ) + offset );
 #else
     return nullptr;
 #endif
 }
 
-void* PseudoAddressManager::GetAllocationBase( void* ptr ) {
+// Finds where the allocation holding an address starts, and an upper bound that is at least
+// past the address
+bool PseudoAddressManager::GetAllocationRange( void* ptr, uintptr_t &lower, uintptr_t &upper ) {
 #if defined PLATFORM_WINDOWS
     MEMORY_BASIC_INFORMATION info;
-    if( !VirtualQuery( ptr, &info, sizeof( MEMORY_BASIC_INFORMATION ) ) )
-        return nullptr;
+    if( !VirtualQuery( ptr, &info, sizeof( MEMORY_BASIC_INFORMATION ) ) || info.AllocationBase == nullptr )
+        return false;
 
-    return info.AllocationBase;
+    // Only the part of the allocation sharing the address's attributes is known to follow it
+    lower = reinterpret_cast< uintptr_t >( info.AllocationBase );
+    upper = reinterpret_cast< uintptr_t >( info.BaseAddress ) + info.RegionSize;
+    return true;
 #elif defined PLATFORM_LINUX
     uintptr_t addr = reinterpret_cast< uintptr_t >( ptr );
 
-    // Format:
-    // lower    upper    prot     stuff                 path
-    // 08048000-0804c000 r-xp 00000000 03:03 1010107    /bin/cat
-    FILE *fp = fopen( "/proc/self/maps", "r" );
-    if( fp ) {
-        int c;
-        uintptr_t lower, upper;
-
-        while( fscanf( fp, "%" PRIxPTR "-%" PRIxPTR, &lower, &upper ) != EOF ) {
-            if( addr >= lower && addr <= upper ) {
-                fclose( fp );
-                return reinterpret_cast< void* >( lower );
-            }
+    // Mappings only change when memory is mapped or unmapped, so the file is read again
+    // only when nothing cached contains the address. A stale region may still be hit,
+    // but its lower bound is below the address either way, which is all a table base
+    // needs to be. The reader count is raised before the copy is loaded, so a refresh
+    // that sees it at zero knows nobody can still be using a copy it retired
+    m_RegionReaders.fetch_add( 1 );
+    bool found = FindCachedRegion( m_Regions.load(), addr, lower, upper );
+    m_RegionReaders.fetch_sub( 1 );
+    if( found )
+        return true;
 
-            // Read to end of line
-            while( ( c = fgetc( fp ) ) != '\n' ) {
-                if( c == EOF )
-                    break;
-            }
-            if( c == EOF )
-                break;
-        }
-        fclose( fp );
+    // Only the thread refreshing can retire a copy, so it may read without counting itself
+    std::lock_guard< std::mutex > lock( m_RegionLock );
+
+    found = FindCachedRegion( m_Regions.load( std::memory_order_relaxed ), addr, lower, upper );
+    if( !found ) {
+        RefreshRegions();
+
+        found = FindCachedRegion( m_Regions.load( std::memory_order_relaxed ), addr, lower, upper );
     }
-    return nullptr;
+    return found;
 #elif defined PLATFORM_APPLE
 # ifdef PLATFORM_X64
 # define mach_vm_region vm_region_64
@@ -126,47 +165,313 @@ void* PseudoAddressManager::GetAllocationBase( void* ptr ) {
     kern_return_t kr = mach_vm_region( mach_task_self(), &vmaddr, &size, flavor,
                                       reinterpret_cast< mach_vm_region_info_t >( &info ), 
                                       &count, &obj );
-    if( kr != KERN_SUCCESS )
-        return nullptr;
 
-    return reinterpret_cast< void* >( vmaddr );
+    // The next region is returned when the address is not mapped
+    if( kr != KERN_SUCCESS || vmaddr > reinterpret_cast< vm_address_t >( ptr ) )
+        return false;
+
+    lower = static_cast< uintptr_t >( vmaddr );
+    upper = static_cast< uintptr_t >( vmaddr + size );
+    return true;
+#else
+    return false;
 #endif
 }
 
-uint32_t PseudoAddressManager::ToPseudoAddress( void* addr ) {
-#ifdef PLATFORM_X64
-    void* base = GetAllocationBase( addr );
-    if( !base )
-        return 0;
+#ifdef PLATFORM_LINUX
+bool PseudoAddressManager::FindCachedRegion( const std::vector< Region >* regions, uintptr_t addr, uintptr_t &lower, uintptr_t &upper ) {
+    // First region that starts after the address; the one before it is the only candidate
+    auto it = std::upper_bound( regions->begin(), regions->end(), addr,
+                                []( uintptr_t a, const Region &r ) { return a < r.lower; } );
+    if( it == regions->begin() )
+        return false;
 
-    uint8_t index = 0;
-    bool hasEntry = false;
+    --it;
+    if( addr >= it->upper )
+        return false;
 
-    for( int i = 0; i < m_NumEntries; i++ ) {
-        if( m_AllocBases[i] == base ) {
-            index = i;
-            hasEntry = true;
+    lower = it->lower;
+    upper = it->upper;
+    return true;
+}
 
+// Called with m_RegionLock held
+void PseudoAddressManager::RefreshRegions() {
+    // Format:
+    // lower    upper    prot     stuff                 path
+    // 08048000-0804c000 r-xp 00000000 03:03 1010107    /bin/cat
+    FILE *fp = fopen( "/proc/self/maps", "r" );
+    if( !fp )
+        return;
+
+    std::vector< Region >* regions = new std::vector< Region >();
+
+    char line[1024];
+    Region region;
+    while( fgets( line, sizeof( line ), fp ) ) {
+        if( sscanf( line, "%" SCNxPTR "-%" SCNxPTR, &region.lower, &region.upper ) == 2 )
+            regions->push_back( region );
+
+        // Skip the rest of a line longer than the buffer
+        while( !strchr( line, '\n' ) && fgets( line, sizeof( line ), fp ) ) {}
+    }
+    fclose( fp );
+
+    // The kernel lists mappings in order already
+    if( !std::is_sorted( regions->begin(), regions->end(), []( const Region &a, const Region &b ) { return a.lower < b.lower; } ) )
+        std::sort( regions->begin(), regions->end(), []( const Region &a, const Region &b ) { return a.lower < b.lower; } );
+
+    m_RetiredRegions.push_back( m_Regions.exchange( regions ) );
+
+    // Readers that arrive from now on can only load the new copy
+    if( !m_RegionReaders.load() ) {
+        for( const std::vector< Region >* retired : m_RetiredRegions ) {
+            delete retired;
+        }
+        m_RetiredRegions.clear();
+    }
+}
+
+#endif
+// Bases are at least page-aligned, so the low bits carry nothing
+uint32_t PseudoAddressManager::HashBase( void* base ) {
+    uint64_t key = static_cast< uint64_t >( reinterpret_cast< uintptr_t >( base ) ) >> 12;
+    return static_cast< uint32_t >( ( key * 0x9E3779B97F4A7C15ULL ) >> 32 ) & ( PSEUDO_HASH_SLOTS - 1 );
+}
+
+// A primary entry covers everything its 26-bit offsets reach; a run only its own chunks
+bool PseudoAddressManager::EntryContains( uint32_t index, void* key, uintptr_t ptr ) const {
+    if( m_Keys[index].load() != key )
+        return false;
+
+    return index < PSEUDO_PRIMARY_ENTRIES || ptr - reinterpret_cast< uintptr_t >( key ) < ( static_cast< uintptr_t >( m_RunLength[index].load( std::memory_order_relaxed ) ) << PSEUDO_CHUNK_OFFSET_BITS );
+}
+
+// Runs of different allocations may start in the same chunk and share a key, so the first
+// one that contains the address is taken
+int PseudoAddressManager::FindEntry( void* key, bool chunk, uintptr_t ptr ) const {
+    for( uint32_t i = HashBase( key ), probes = 0; probes < PSEUDO_HASH_SLOTS; i = ( i + 1 ) & ( PSEUDO_HASH_SLOTS - 1 ), probes++ ) {
+        uint16_t slot = m_BaseIndex[i].load( std::memory_order_acquire );
+        if( !slot )
             break;
+
+        uint32_t index = slot - 1u;
+        if( ( index >= PSEUDO_PRIMARY_ENTRIES ) == chunk && EntryContains( index, key, ptr ) )
+            return static_cast< int >( index );
+    }
+    return -1;
+}
+
+// Called with m_AppendLock held. First fit, since runs are short next to the table
+int PseudoAddressManager::FindFreeSlots( bool chunk, uint32_t count ) const {
+    uint32_t first = chunk ? PSEUDO_PRIMARY_ENTRIES : 0;
+    uint32_t last = chunk ? PSEUDO_ENTRIES : PSEUDO_PRIMARY_ENTRIES;
+
+    uint32_t free = 0;
+    for( uint32_t i = first; i < last; i++ ) {
+        if( m_Taken[i] ) {
+            free = 0;
+            continue;
         }
+
+        if( ++free == count )
+            return static_cast< int >( i + 1 - count );
+    }
+    return -1;
+}
+
+// Called with m_AppendLock held
+int PseudoAddressManager::AddEntry( void* key, bool chunk, uint32_t count ) {
+    int index = FindFreeSlots( chunk, count );
+    if( index == -1 )
+        return -1;
+
+    m_Refs[index].store( 0, std::memory_order_relaxed );
+    m_Exposed[index].store( false, std::memory_order_relaxed );
+    m_RunLength[index].store( static_cast< uint16_t >( count ), std::memory_order_relaxed );
+    for( uint32_t i = 0; i < count; i++ ) {
+        m_Taken[index + i] = true;
+        m_RunStart[index + i].store( static_cast< uint16_t >( index ), std::memory_order_relaxed );
+    }
+    ReviveEntry( static_cast< uint32_t >( index ), key );
+    m_Keys[index].store( key, std::memory_order_release );
+
+    // Absence was checked with the lock held, so the first free slot will do
+    uint32_t i = HashBase( key );
+    while( m_BaseIndex[i].load( std::memory_order_relaxed ) ) {
+        i = ( i + 1 ) & ( PSEUDO_HASH_SLOTS - 1 );
     }
-    if( !hasEntry ) {
-        // Table is full
-        if( m_NumEntries < SM_ARRAYSIZE(m_AllocBases) )
-            return 0;
 
-        index = m_NumEntries;
+    m_BaseIndex[i].store( static_cast< uint16_t >( index + 1 ), std::memory_order_release );
+    return index;
+}
 
-        m_AllocBases[m_NumEntries++] = base;
+// Called with m_AppendLock held. Points the slots of a new or retired entry at its key
+void PseudoAddressManager::ReviveEntry( uint32_t index, void* key ) {
+    uint32_t count = m_RunLength[index].load( std::memory_order_relaxed );
+    for( uint32_t i = 0; i < count; i++ ) {
+        m_Bases[index + i].store( reinterpret_cast< void* >( reinterpret_cast< uintptr_t >( key ) + ( static_cast< uintptr_t >( i ) << PSEUDO_CHUNK_OFFSET_BITS ) ), std::memory_order_release );
     }
+}
+
+// Called with m_AppendLock held. The key is cleared before the exposed mark is read, and
+// lock-free lookups set the mark before re-checking the key, so either the lookup sees the
+// entry go away or the retirement sees the lookup and backs off. The key goes back once
+// the slots are cleared, so the same allocation can find and revive the entry later
+bool PseudoAddressManager::EvictEntry( uint32_t index ) {
+    void* key = m_Keys[index].exchange( nullptr );
+    if( m_Exposed[index].load() || m_Refs[index].load() ) {
+        m_Keys[index].store( key );
+        return false;
+    }
+
+    uint32_t count = m_RunLength[index].load( std::memory_order_relaxed );
+    for( uint32_t i = 0; i < count; i++ ) {
+        m_Bases[index + i].store( nullptr, std::memory_order_release );
+    }
+    m_Keys[index].store( key );
+
+    m_NumEvictions++;
+    return true;
+}
+
+int PseudoAddressManager::Encode( void* addr, bool pin, uint32_t &paddr ) {
+    uintptr_t ptr = reinterpret_cast< uintptr_t >( addr );
+    const uintptr_t chunkSize = static_cast< uintptr_t >( 1 ) << PSEUDO_CHUNK_OFFSET_BITS;
+
+    uintptr_t lower, upper;
+    bool known = GetAllocationRange( addr, lower, upper ) && lower <= ptr && ptr < upper;
 
-    // Ensure difference fits in 26 bits
-    ptrdiff_t diff = reinterpret_cast< uintptr_t >( addr ) - reinterpret_cast< uintptr_t >( base );
-    if( diff > ( UINT32_MAX >> PSEUDO_INDEX_BITS ) )
-        return 0;
+    // The 16MB window of the allocation the address is in, up to the end of the allocation.
+    // Offsets that stay inside it decode correctly whichever table the address ends up in
+    uintptr_t start = ( known ? lower : ptr ) & ~( chunkSize - 1 );
+    start += ( ptr - start ) / ( PSEUDO_RUN_CHUNKS * chunkSize ) * ( PSEUDO_RUN_CHUNKS * chunkSize );
+
+    uintptr_t end = known ? std::min( ( upper + chunkSize - 1 ) & ~( chunkSize - 1 ), start + PSEUDO_RUN_CHUNKS * chunkSize ) : start + chunkSize;
+
+    // Ensure the whole window fits in 26 bits, or fall back to a chunk
+    bool chunk = !known || std::min( end, upper ) - 1 - lower > ( UINT32_MAX >> PSEUDO_INDEX_BITS );
+
+    while( true ) {
+        void* key = reinterpret_cast< void* >( lower );
+        uint32_t count = 1;
+        if( chunk ) {
+            count = static_cast< uint32_t >( ( end - start ) / chunkSize );
+            key = reinterpret_cast< void* >( start );
+        }
+
+        int index = -1;
+        if( !pin ) {
+            index = FindEntry( key, chunk, ptr );
+
+            // Once exposed, an entry is never retired; if one was retiring it just now, it
+            // has to be looked up again
+            if( index != -1 && !m_Exposed[index].load( std::memory_order_relaxed ) ) {
+                m_Exposed[index].store( true );
+                if( !EntryContains( static_cast< uint32_t >( index ), key, ptr ) )
+                    index = -1;
+            }
+
+            // A retired entry is revived with the lock held
+            if( index != -1 && m_Bases[index].load( std::memory_order_acquire ) == nullptr )
+                index = -1;
+        }
+
+        if( index == -1 ) {
+            std::lock_guard< std::mutex > lock( m_AppendLock );
+
+            // Another thread may have added it in the meantime
+            index = FindEntry( key, chunk, ptr );
+            if( index == -1 )
+                index = AddEntry( key, chunk, count );
+            else if( m_Bases[index].load( std::memory_order_relaxed ) == nullptr )
+                ReviveEntry( static_cast< uint32_t >( index ), key );
+
+            if( index != -1 ) {
+                if( pin )
+                    m_Refs[index]++;
+                else
+                    m_Exposed[index].store( true );
+            }
+        }
 
-    return ( index << PSEUDO_OFFSET_BITS ) | static_cast< uint32_t >( diff );
+        if( index != -1 ) {
+            uint32_t offset = static_cast< uint32_t >( ptr - reinterpret_cast< uintptr_t >( key ) );
+            if( chunk )
+                paddr = PSEUDO_CHUNK_START + ( ( static_cast< uint32_t >( index ) - PSEUDO_PRIMARY_ENTRIES ) << PSEUDO_CHUNK_OFFSET_BITS ) + offset;
+            else
+                paddr = ( static_cast< uint32_t >( index ) << PSEUDO_OFFSET_BITS ) | offset;
+            return index;
+        }
+
+        if( chunk ) {
+            m_NumFailures++;
+            return -1;
+        }
+
+        // Primary table is full
+        chunk = true;
+    }
+}
+
+uint32_t PseudoAddressManager::ToPseudoAddress( void* addr ) {
+#ifdef PLATFORM_X64
+    uint32_t paddr = 0;
+    Encode( addr, false, paddr );
+    return paddr;
+#else
+    return 0;
+#endif
+}
+
+uint32_t PseudoAddressManager::Pin( void* addr ) {
+#ifdef PLATFORM_X64
+    uint32_t paddr = 0;
+    Encode( addr, true, paddr );
+    return paddr;
 #else
     return 0;
 #endif
+}
+
+void PseudoAddressManager::Unpin( uint32_t paddr ) {
+#ifdef PLATFORM_X64
+    uint32_t index = paddr >= PSEUDO_CHUNK_START ? m_RunStart[PSEUDO_PRIMARY_ENTRIES + ( ( paddr - PSEUDO_CHUNK_START ) >> PSEUDO_CHUNK_OFFSET_BITS )].load()
+                                                 : paddr >> PSEUDO_OFFSET_BITS;
+
+    std::lock_guard< std::mutex > lock( m_AppendLock );
+
+    // Primary entries hold module and heap bases that are bound to be asked for again
+    uint32_t refs = m_Refs[index].load();
+    if( refs && m_Refs[index].fetch_sub( 1 ) == 1 && index >= PSEUDO_PRIMARY_ENTRIES )
+        EvictEntry( index );
+#endif
+}
+
+void PseudoAddressManager::GetUsage( Usage &usage ) {
+    std::lock_guard< std::mutex > lock( m_AppendLock );
+
+    usage.primaryUsed = 0;
+    usage.chunksUsed = 0;
+    usage.pinned = 0;
+    usage.retired = 0;
+    for( uint32_t i = 0; i < PSEUDO_ENTRIES; i++ ) {
+        if( !m_Taken[i] )
+            continue;
+
+        if( i < PSEUDO_PRIMARY_ENTRIES )
+            usage.primaryUsed++;
+        else
+            usage.chunksUsed++;
+
+        if( m_Refs[i].load( std::memory_order_relaxed ) )
+            usage.pinned++;
+        else if( m_RunStart[i].load( std::memory_order_relaxed ) == i && m_Bases[i].load( std::memory_order_relaxed ) == nullptr )
+            usage.retired++;
+    }
+
+    usage.primaryCapacity = PSEUDO_PRIMARY_ENTRIES;
+    usage.chunksCapacity = PSEUDO_CHUNK_ENTRIES;
+    usage.evictions = m_NumEvictions;
+    usage.failures = m_NumFailures.load( std::memory_order_relaxed );
 }
\ No newline at end of file
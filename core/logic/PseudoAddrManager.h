@@ -41,20 +41,123 @@
 
 #  endif
 # endif
+#include <atomic>
+#include <mutex>
+#include <vector>
+
 class PseudoAddressManager {
+    // Below PSEUDO_CHUNK_START, a pseudo address holds a 6-bit index into the primary
+    // table and a 26-bit offset from an allocation base. From there on, it holds a 12-bit
+    // index into the chunk table and an 18-bit offset into a 256KB chunk, which any
+    // address can be encoded with once the primary table is full or an allocation is too
+    // large for 26 bits
     static constexpr uint8_t PSEUDO_OFFSET_BITS = 26;
     static constexpr uint8_t PSEUDO_INDEX_BITS = sizeof( uint32_t ) * 8 - PSEUDO_OFFSET_BITS;
+    static constexpr uint32_t PSEUDO_PRIMARY_ENTRIES = 48;
+    static constexpr uint32_t PSEUDO_CHUNK_START = PSEUDO_PRIMARY_ENTRIES << PSEUDO_OFFSET_BITS;
+
+    static constexpr uint8_t PSEUDO_CHUNK_OFFSET_BITS = 18;
+    static constexpr uint32_t PSEUDO_CHUNK_ENTRIES = ( 0u - PSEUDO_CHUNK_START ) >> PSEUDO_CHUNK_OFFSET_BITS;
+
+    // Chunks are handed out in runs of consecutive slots covering consecutive memory, from
+    // the allocation an address belongs to up to its end, so an offset added to a pseudo
+    // address still decodes correctly when it crosses into the next chunk. Allocations
+    // larger than this are covered by one run per 16MB window
+    static constexpr uint32_t PSEUDO_RUN_CHUNKS = 64;
+
+    static constexpr uint32_t PSEUDO_ENTRIES = PSEUDO_PRIMARY_ENTRIES + PSEUDO_CHUNK_ENTRIES;
+
+    // Open-addressed key -> index map with over three times as many slots as table
+    // entries; a slot holds index + 1, or 0 when empty. Indexes are never handed to another
+    // key, so slots are never taken out again and probe chains stay as short as the table
+    static constexpr uint32_t PSEUDO_HASH_SLOTS = 4 * PSEUDO_CHUNK_ENTRIES;
+
+    // What every slot decodes to; the slots of a run hold its key plus 256KB steps, and
+    // those of a retired run hold null
+    std::atomic< void* > m_Bases[PSEUDO_ENTRIES];
+
+    // What lookups compare against, set on the first slot of an entry only. It is cleared
+    // while an entry is being retired, which leaves decoding alone
+    std::atomic< void* > m_Keys[PSEUDO_ENTRIES];
+    std::atomic< uint16_t > m_RunLength[PSEUDO_ENTRIES];
+    std::atomic< uint16_t > m_RunStart[PSEUDO_ENTRIES];
+
+    // Each entry is fully written before the hash slot pointing at it is published, so
+    // lookups never need a lock
+    std::atomic< uint16_t > m_BaseIndex[PSEUDO_HASH_SLOTS];
+
+    // Number of live handles keeping an entry, and whether it was ever handed out without
+    // one. A chunk entry only handles ever saw is retired when the last of them goes away:
+    // its slots decode to null from then on and are never given to another key, although
+    // the same key brings them back. Anything else lives as long as the extension, as a
+    // plug-in may keep its addresses for good
+    std::atomic< uint32_t > m_Refs[PSEUDO_ENTRIES];
+    std::atomic< bool > m_Exposed[PSEUDO_ENTRIES];
 
-    void* m_AllocBases[1 << PSEUDO_INDEX_BITS];
-    uint8_t m_NumEntries;
+    // Whether a slot belongs to an entry, live or retired. Only used with m_AppendLock held
+    bool m_Taken[PSEUDO_ENTRIES];
+
+    // Serializes additions, revivals and retirements
+    std::mutex m_AppendLock;
+    uint32_t m_NumEvictions;
+    std::atomic< uint32_t > m_NumFailures;
+#ifdef PLATFORM_LINUX
+
+    struct Region {
+        uintptr_t lower;
+        uintptr_t upper;
+    };
+
+    // Sorted copy of /proc/self/maps, only re-read when an address falls outside of it.
+    // Readers load the current copy without locking; a refresh publishes a new one and
+    // retires the old one, which is freed once no reader was seen inside a lookup
+    std::atomic< const std::vector< Region >* > m_Regions;
+    std::atomic< uint32_t > m_RegionReaders;
+    std::vector< const std::vector< Region >* > m_RetiredRegions;
+
+    // Serializes refreshes
+    std::mutex m_RegionLock;
+#endif
 public:
+    struct Usage {
+        uint32_t primaryUsed;
+        uint32_t primaryCapacity;
+        uint32_t chunksUsed;
+        uint32_t chunksCapacity;
+        uint32_t pinned;
+        uint32_t retired;
+        uint32_t evictions;
+        uint32_t failures;
+    };
+
     PseudoAddressManager();
+    ~PseudoAddressManager();
 
     void* FromPseudoAddress( uint32_t paddr );
 private:
-    void* GetAllocationBase( void* ptr );
+    bool GetAllocationRange( void* ptr, uintptr_t &lower, uintptr_t &upper );
+#ifdef PLATFORM_LINUX
+    static bool FindCachedRegion( const std::vector< Region >* regions, uintptr_t addr, uintptr_t &lower, uintptr_t &upper );
+    void RefreshRegions();
+#endif
+
+    static uint32_t HashBase( void* base );
+    bool EntryContains( uint32_t index, void* key, uintptr_t ptr ) const;
+    int FindEntry( void* key, bool chunk, uintptr_t ptr ) const;
+    int FindFreeSlots( bool chunk, uint32_t count ) const;
+    int AddEntry( void* key, bool chunk, uint32_t count );
+    void ReviveEntry( uint32_t index, void* key );
+    bool EvictEntry( uint32_t index );
+    int Encode( void* addr, bool pin, uint32_t &paddr );
 public:
     uint32_t ToPseudoAddress( void* addr );
+
+    // Same as ToPseudoAddress(), but only keeps the entry alive until a matching Unpin().
+    // Handles that give out addresses use this, so their entries can be retired with them
+    uint32_t Pin( void* addr );
+    void Unpin( uint32_t paddr );
+
+    void GetUsage( Usage &usage );
 };
 
 extern PseudoAddressManager pseudoAddr;
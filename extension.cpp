@@ -33,7 +33,20 @@
  * Version: $Id$
  */
 
+#include "codecave.h"
 #include "extension.h"
+#include "livewrite.h"
+
+#include <algorithm>
+
+#ifdef PLATFORM_X64
+# ifdef PLATFORM_LINUX
+# define _INTTYPES_H	1
+
+# endif
+#include "PseudoAddrManager.h"
+
+#endif
 
 Handle_t g_MemoryBlock;
 MemoryBlockHandler g_MemoryBlockHandler;
@@ -41,6 +54,18 @@ MemoryBlockHandler g_MemoryBlockHandler;
 Handle_t g_MemoryPatch;
 MemoryPatchHandler g_MemoryPatchHandler;
 
+Handle_t g_MemoryPatchGroup;
+MemoryPatchGroupHandler g_MemoryPatchGroupHandler;
+
+Handle_t g_MemorySnapshot;
+MemorySnapshotHandler g_MemorySnapshotHandler;
+
+Handle_t g_MemoryScan;
+MemoryScanHandler g_MemoryScanHandler;
+
+Handle_t g_MemoryProgram;
+MemoryProgramHandler g_MemoryProgramHandler;
+
 SrcScramble g_SrcScramble;
 SMEXT_LINK(&g_SrcScramble);
 
@@ -66,6 +91,44 @@ bool SrcScramble::SDK_OnLoad( char* error, size_t maxlength, bool late ) {
         myself->GetIdentity(), 
         nullptr);
 
+    g_MemoryPatchGroup = handlesys->CreateType("MemoryPatchGroup", 
+        &g_MemoryPatchGroupHandler, 
+        0, 
+        nullptr, 
+        nullptr, 
+        myself->GetIdentity(), 
+        nullptr);
+
+    g_MemorySnapshot = handlesys->CreateType("MemorySnapshot", 
+        &g_MemorySnapshotHandler, 
+        0, 
+        nullptr, 
+        nullptr, 
+        myself->GetIdentity(), 
+        nullptr);
+
+    g_MemoryScan = handlesys->CreateType("MemoryScan", 
+        &g_MemoryScanHandler, 
+        0, 
+        nullptr, 
+        nullptr, 
+        myself->GetIdentity(), 
+        nullptr);
+
+    g_MemoryProgram = handlesys->CreateType("MemoryProgram", 
+        &g_MemoryProgramHandler, 
+        0, 
+        nullptr, 
+        nullptr, 
+        myself->GetIdentity(), 
+        nullptr);
+
+    smutils->AddGameFrameHook(&MemoryScan::ProcessFinished);
+    smutils->AddGameFrameHook(&PatchQueue::OnGameFrame);
+    smutils->AddGameFrameHook(&PatchWatchdog::OnGameFrame);
+
+    rootconsole->AddRootConsoleCommand3("srcscramble", "Source Scramble diagnostics", this);
+
     rootconsole->ConsolePrint("[" SMEXT_CONF_LOGTAG "] Loaded successfully!");
     return true;
 }
@@ -73,10 +136,65 @@ bool SrcScramble::SDK_OnLoad( char* error, size_t maxlength, bool late ) {
 void SrcScramble::SDK_OnUnload() {
     rootconsole->ConsolePrint("[" SMEXT_CONF_LOGTAG "] Unloading...");
 
+    rootconsole->RemoveRootConsoleCommand("srcscramble", this);
+
+    smutils->RemoveGameFrameHook(&PatchWatchdog::OnGameFrame);
+    smutils->RemoveGameFrameHook(&PatchQueue::OnGameFrame);
+    smutils->RemoveGameFrameHook(&MemoryScan::ProcessFinished);
+
+    handlesys->RemoveType(g_MemoryProgram, myself->GetIdentity());
+    handlesys->RemoveType(g_MemoryScan, myself->GetIdentity());
+    handlesys->RemoveType(g_MemorySnapshot, myself->GetIdentity());
+    handlesys->RemoveType(g_MemoryPatchGroup, myself->GetIdentity());
     handlesys->RemoveType(g_MemoryPatch, myself->GetIdentity());
     handlesys->RemoveType(g_MemoryBlock, myself->GetIdentity());
 
     gameconfs->RemoveUserConfigHook("Patches", &g_Patches);
+
+    // Every patch has been restored by now, so no thread can still be waiting on an int3
+    LiveWriteShutdown();
+    CodeCaveShutdown();
+}
+
+void SrcScramble::OnRootConsoleCommand( const char* cmdname, const ICommandArgs* args ) {
+    const char* sub = args->ArgC() >= 3 ? args->Arg(2) : "";
+
+    if( !strcmp( sub, "pseudo" ) ) {
+#ifdef PLATFORM_X64
+        PseudoAddressManager::Usage usage;
+        pseudoAddr.GetUsage( usage );
+
+        rootconsole->ConsolePrint("[" SMEXT_CONF_LOGTAG "] Pseudo-address table:");
+        rootconsole->ConsolePrint("  Allocation bases:   %u/%u", usage.primaryUsed, usage.primaryCapacity);
+        rootconsole->ConsolePrint("  256KB chunks:       %u/%u", usage.chunksUsed, usage.chunksCapacity);
+        rootconsole->ConsolePrint("  Pinned by handles:  %u", usage.pinned);
+        rootconsole->ConsolePrint("  Retired:            %u (%u evictions)", usage.retired, usage.evictions);
+        rootconsole->ConsolePrint("  Failed lookups:     %u", usage.failures);
+#else
+        rootconsole->ConsolePrint("[" SMEXT_CONF_LOGTAG "] Pseudo addresses are only used on x86_64");
+#endif
+        return;
+    } else if( !strcmp( sub, "patches" ) ) {
+        std::vector< MemoryPatch* > patches;
+        g_ActivePatches.GetAll( patches );
+
+        rootconsole->ConsolePrint("[" SMEXT_CONF_LOGTAG "] %u enabled patch(es), %u queued for the next frame:", static_cast< unsigned int >( patches.size() ),
+            static_cast< unsigned int >( g_PatchQueue.Count() ));
+
+        // Sorted by address, so an overlap can only be with a patch listed before
+        uintptr_t reach = 0;
+        for( MemoryPatch* patch : patches ) {
+            rootconsole->ConsolePrint("  %p  %4u bytes  #%-6u %s%s", patch->pAddr, static_cast< unsigned int >( patch->node.upper - patch->node.lower ),
+                static_cast< unsigned int >( patch->node.sequence ), patch->owner.c_str(), patch->node.lower < reach ? "  (overlaps)" : "");
+
+            reach = std::max( reach, patch->node.upper );
+        }
+        return;
+    }
+
+    rootconsole->ConsolePrint("SourceMod Source Scramble Menu:");
+    rootconsole->DrawGenericOption("patches", "List every enabled patch and the plug-in that owns it");
+    rootconsole->DrawGenericOption("pseudo", "Show how much of the pseudo-address table is in use");
 }
 
 void MemoryBlockHandler::OnHandleDestroy(HandleType_t type, void *object)
@@ -93,4 +211,31 @@ bool MemoryBlockHandler::GetHandleApproxSize(HandleType_t type, void *object, un
 void MemoryPatchHandler::OnHandleDestroy(HandleType_t type, void *object)
 {
     delete static_cast< MemoryPatch* >( object );
+}
+
+void MemoryPatchGroupHandler::OnHandleDestroy(HandleType_t type, void *object)
+{
+    delete static_cast< MemoryPatchGroup* >( object );
+}
+
+void MemorySnapshotHandler::OnHandleDestroy(HandleType_t type, void *object)
+{
+    delete static_cast< MemorySnapshot* >( object );
+}
+
+bool MemorySnapshotHandler::GetHandleApproxSize(HandleType_t type, void *object, unsigned int *pSize)
+{
+    // The bytes and the scratch copy Update() reads into
+    *pSize = static_cast< unsigned int >( ( static_cast< MemorySnapshot* >( object ) )->data.size() * 2 );
+    return true;
+}
+
+void MemoryScanHandler::OnHandleDestroy(HandleType_t type, void *object)
+{
+    delete static_cast< MemoryScan* >( object );
+}
+
+void MemoryProgramHandler::OnHandleDestroy(HandleType_t type, void *object)
+{
+    delete static_cast< MemoryProgram* >( object );
 }
\ No newline at end of file
@@ -40,8 +40,12 @@
 
 #include "memoryblock.h"
 #include "memorypatch.h"
+#include "memorypatchgroup.h"
+#include "memoryprogram.h"
+#include "memoryscan.h"
+#include "memorysnapshot.h"
 
-class SrcScramble : public SDKExtension {
+class SrcScramble : public SDKExtension, public IRootConsoleCommand {
 public:
 # ifdef SMEXT_CONF_METAMOD
     /**
@@ -108,6 +112,11 @@ public:
      */
     //virtual bool SDK_OnMetamodUnload( char* error, size_t maxlen );
 # endif
+
+    /**
+     * @brief Handles "sm srcscramble" in the server console.
+     */
+    void OnRootConsoleCommand( const char* cmdname, const ICommandArgs* args );
 };
 
 class MemoryBlockHandler : public IHandleTypeDispatch {
@@ -121,8 +130,33 @@ public:
     void OnHandleDestroy(HandleType_t type, void *object);
 };
 
+class MemoryPatchGroupHandler : public IHandleTypeDispatch {
+public:
+    void OnHandleDestroy(HandleType_t type, void *object);
+};
+
+class MemorySnapshotHandler : public IHandleTypeDispatch {
+public:
+    void OnHandleDestroy(HandleType_t type, void *object);
+    bool GetHandleApproxSize(HandleType_t type, void *object, unsigned int *pSize);
+};
+
+class MemoryScanHandler : public IHandleTypeDispatch {
+public:
+    void OnHandleDestroy(HandleType_t type, void *object);
+};
+
+class MemoryProgramHandler : public IHandleTypeDispatch {
+public:
+    void OnHandleDestroy(HandleType_t type, void *object);
+};
+
 extern Handle_t g_MemoryBlock;
 extern Handle_t g_MemoryPatch;
+extern Handle_t g_MemoryPatchGroup;
+extern Handle_t g_MemorySnapshot;
+extern Handle_t g_MemoryScan;
+extern Handle_t g_MemoryProgram;
 
 extern sp_nativeinfo_t g_SrcScrambleNatives[];
 
@@ -0,0 +1,384 @@
+/**
+ * vim: set ts=4 sw=4 tw=99 noet :
+ * =============================================================================
+ * SourceMod Source Scramble Extension
+ * 
+ * Copyright (C) 2019 nosoop
+ * Copyright (C) 2023 cravenge
+ *
+ * All rights reserved
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2", the
+ * "Source Engine", the "SourcePawn JIT" and any Game MODs that run on software
+ * by the Valve Corporation. You must obey the GNU General Public License in
+ * all respects for all other code used. Additionally, AlliedModders LLC grants
+ * this exception to all derivative works. AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>
+ *
+ * Version: $Id$
+ */
+
+#include <sm_platform.h>
+
+#include "livewrite.h"
+#include "x86insn.h"
+
+#include "string.h"
+
+#include <atomic>
+#include <mutex>
+
+#if defined PLATFORM_WINDOWS
+#include <windows.h>
+#include <intrin.h>
+
+#elif defined PLATFORM_POSIX
+#include <signal.h>
+#include <sched.h>
+#include <ucontext.h>
+
+# ifdef PLATFORM_LINUX
+# include <unistd.h>
+# include <sys/syscall.h>
+
+# endif
+# if defined __x86_64__
+# include <cpuid.h>
+
+# endif
+#endif
+
+static constexpr uint8_t LIVE_INT3 = 0xCC;
+
+// Writers go one at a time; the trap handler never takes this
+static std::mutex s_WriteLock;
+
+// Address whose first byte is a temporary int3 right now, or 0
+static std::atomic< uintptr_t > s_Pending( 0 );
+
+// A thread can execute the int3 just before it is replaced and only reach the handler
+// any time afterwards, so the handler recognizes every address that ever carried one.
+// Blocks are only ever appended and never freed, which keeps lookups from the handler
+// free of locks and allocations
+static constexpr size_t LIVE_TRAP_BLOCK = 64;
+
+struct TrapBlock {
+    std::atomic< uintptr_t > addrs[LIVE_TRAP_BLOCK];
+    std::atomic< TrapBlock* > next;
+};
+
+static TrapBlock s_Traps;
+static size_t s_TrapCount = 0;
+
+static bool s_TrapInstalled = false;
+
+static void YieldThread() {
+#if defined PLATFORM_WINDOWS
+    SwitchToThread();
+#else
+    sched_yield();
+#endif
+}
+
+// Returns whether the int3 at "at" was one of ours, after waiting for its write to finish.
+// Execution then restarts at "at", where the new first byte is in place
+static bool OwnsTrap( uintptr_t at ) {
+    while( s_Pending.load( std::memory_order_acquire ) == at ) {
+        YieldThread();
+    }
+
+    // Slots are filled in order, so the first empty one ends the search
+    for( TrapBlock* block = &s_Traps; block != nullptr; block = block->next.load( std::memory_order_acquire ) ) {
+        for( size_t i = 0; i < LIVE_TRAP_BLOCK; i++ ) {
+            uintptr_t addr = block->addrs[i].load( std::memory_order_acquire );
+            if( addr == at ) {
+                return true;
+            } else if( !addr ) {
+                return false;
+            }
+        }
+    }
+    return false;
+}
+
+// Only called by writers, which hold s_WriteLock
+static void RememberTrap( uintptr_t at ) {
+    TrapBlock* block = &s_Traps;
+    for( size_t i = 0; i < s_TrapCount; i++ ) {
+        if( i && !( i % LIVE_TRAP_BLOCK ) ) {
+            block = block->next.load( std::memory_order_relaxed );
+        }
+
+        if( block->addrs[i % LIVE_TRAP_BLOCK].load( std::memory_order_relaxed ) == at ) {
+            return;
+        }
+    }
+
+    size_t slot = s_TrapCount % LIVE_TRAP_BLOCK;
+    if( s_TrapCount && !slot ) {
+        TrapBlock* next = new TrapBlock();
+        block->next.store( next, std::memory_order_release );
+        block = next;
+    }
+
+    block->addrs[slot].store( at, std::memory_order_release );
+    s_TrapCount++;
+}
+
+#if defined PLATFORM_WINDOWS
+static PVOID s_TrapHandler = nullptr;
+
+// Breakpoint exceptions already report the address of the int3 itself
+static LONG CALLBACK TrapHandler( PEXCEPTION_POINTERS info ) {
+    if( info->ExceptionRecord->ExceptionCode != EXCEPTION_BREAKPOINT ) {
+        return EXCEPTION_CONTINUE_SEARCH;
+    }
+
+    uintptr_t at = reinterpret_cast< uintptr_t >( info->ExceptionRecord->ExceptionAddress );
+    if( !OwnsTrap( at ) ) {
+        return EXCEPTION_CONTINUE_SEARCH;
+    }
+
+# ifdef _M_X64
+    info->ContextRecord->Rip = at;
+# else
+    info->ContextRecord->Eip = at;
+# endif
+    return EXCEPTION_CONTINUE_EXECUTION;
+}
+
+static void InstallTrapHandler() {
+    s_TrapHandler = AddVectoredExceptionHandler( 1, TrapHandler );
+}
+
+static void RemoveTrapHandler() {
+    RemoveVectoredExceptionHandler( s_TrapHandler );
+    s_TrapHandler = nullptr;
+}
+
+// Interrupts every processor running this process, which serializes their instruction streams
+static void SyncCores() {
+    FlushProcessWriteBuffers();
+}
+
+#else
+static struct sigaction s_PrevTrap;
+
+// SIGTRAP reports the instruction pointer just past the int3
+static void TrapHandler( int sig, siginfo_t* info, void* context ) {
+    ucontext_t* uc = static_cast< ucontext_t* >( context );
+# if defined PLATFORM_LINUX && defined __x86_64__
+    greg_t &ip = uc->uc_mcontext.gregs[REG_RIP];
+# elif defined PLATFORM_LINUX
+    greg_t &ip = uc->uc_mcontext.gregs[REG_EIP];
+# elif defined __x86_64__
+    __uint64_t &ip = uc->uc_mcontext->__ss.__rip;
+# else
+    unsigned int &ip = uc->uc_mcontext->__ss.__eip;
+# endif
+
+    if( OwnsTrap( static_cast< uintptr_t >( ip ) - 1 ) ) {
+        ip -= 1;
+        return;
+    }
+
+    if( s_PrevTrap.sa_flags & SA_SIGINFO ) {
+        if( s_PrevTrap.sa_sigaction ) {
+            s_PrevTrap.sa_sigaction( sig, info, context );
+        }
+    } else if( s_PrevTrap.sa_handler == SIG_DFL ) {
+        signal( sig, SIG_DFL );
+        raise( sig );
+    } else if( s_PrevTrap.sa_handler != SIG_IGN ) {
+        s_PrevTrap.sa_handler( sig );
+    }
+}
+
+# if defined PLATFORM_LINUX && defined __NR_membarrier
+// From linux/membarrier.h, which older toolchains lack
+static constexpr int LIVE_MEMBARRIER_SYNC_CORE = 1 << 5;
+static constexpr int LIVE_MEMBARRIER_REGISTER_SYNC_CORE = 1 << 6;
+
+static bool s_SyncCore = false;
+
+# endif
+static void InstallTrapHandler() {
+    struct sigaction action;
+    memset( &action, 0, sizeof( action ) );
+    action.sa_sigaction = TrapHandler;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset( &action.sa_mask );
+
+    sigaction( SIGTRAP, &action, &s_PrevTrap );
+
+# if defined PLATFORM_LINUX && defined __NR_membarrier
+    // Needs Linux 4.16; without it, the fences below are all there is
+    s_SyncCore = syscall( __NR_membarrier, LIVE_MEMBARRIER_REGISTER_SYNC_CORE, 0 ) == 0;
+# endif
+}
+
+static void RemoveTrapHandler() {
+    sigaction( SIGTRAP, &s_PrevTrap, nullptr );
+}
+
+static void SyncCores() {
+    std::atomic_thread_fence( std::memory_order_seq_cst );
+
+# if defined PLATFORM_LINUX && defined __NR_membarrier
+    if( s_SyncCore ) {
+        syscall( __NR_membarrier, LIVE_MEMBARRIER_SYNC_CORE, 0 );
+    }
+# endif
+}
+
+#endif
+static bool CompareExchange8( volatile uint64_t* window, uint64_t &expected, uint64_t desired ) {
+#ifdef _MSC_VER
+    uint64_t found = _InterlockedCompareExchange64( reinterpret_cast< volatile long long* >( window ), desired, expected );
+#else
+    uint64_t found = __sync_val_compare_and_swap( window, expected, desired );
+#endif
+    bool swapped = found == expected;
+    expected = found;
+    return swapped;
+}
+
+static bool WriteWindow8( uint8_t* addr, const uint8_t* bytes, size_t size ) {
+    uintptr_t offset = reinterpret_cast< uintptr_t >( addr ) & 7;
+    if( offset + size > 8 ) {
+        return false;
+    }
+
+    auto window = reinterpret_cast< volatile uint64_t* >( addr - offset );
+
+    // A torn first read just costs another round
+    uint64_t expected = *window, desired;
+    do {
+        desired = expected;
+        memcpy( reinterpret_cast< uint8_t* >( &desired ) + offset, bytes, size );
+    } while( !CompareExchange8( window, expected, desired ) );
+    return true;
+}
+
+#if defined _M_X64 || defined __x86_64__
+static bool SupportsCX16() {
+# ifdef _MSC_VER
+    int info[4];
+    __cpuid( info, 1 );
+    return ( info[2] & ( 1 << 13 ) ) != 0;
+# else
+    unsigned int eax, ebx, ecx, edx;
+    return __get_cpuid( 1, &eax, &ebx, &ecx, &edx ) && ( ecx & bit_CMPXCHG16B ) != 0;
+# endif
+}
+
+static bool CompareExchange16( volatile uint64_t* window, uint64_t expected[2], const uint64_t desired[2] ) {
+# ifdef _MSC_VER
+    return _InterlockedCompareExchange128( reinterpret_cast< volatile long long* >( window ), desired[1], desired[0], reinterpret_cast< long long* >( expected ) ) != 0;
+# else
+    // Spelled out because __sync on 16 bytes becomes a libatomic call without -mcx16
+    unsigned char swapped;
+    __asm__ __volatile__( "lock cmpxchg16b %1\n\tsetz %0"
+        : "=q"( swapped ), "+m"( *reinterpret_cast< volatile unsigned __int128* >( window ) ), "+a"( expected[0] ), "+d"( expected[1] )
+        : "b"( desired[0] ), "c"( desired[1] )
+        : "memory", "cc" );
+    return swapped != 0;
+# endif
+}
+
+static bool WriteWindow16( uint8_t* addr, const uint8_t* bytes, size_t size ) {
+    static const bool supported = SupportsCX16();
+
+    uintptr_t offset = reinterpret_cast< uintptr_t >( addr ) & 15;
+    if( !supported || offset + size > 16 ) {
+        return false;
+    }
+
+    auto window = reinterpret_cast< volatile uint64_t* >( addr - offset );
+
+    uint64_t expected[2] = { window[0], window[1] }, desired[2];
+    do {
+        memcpy( desired, expected, sizeof( desired ) );
+        memcpy( reinterpret_cast< uint8_t* >( desired ) + offset, bytes, size );
+    } while( !CompareExchange16( window, expected, desired ) );
+    return true;
+}
+#endif
+
+bool LiveWrite( void* addr, const uint8_t* bytes, size_t size ) {
+    if( !size ) {
+        return true;
+    }
+
+    // Threads can only be stopped before the instruction at "addr" or past it, never inside.
+    // Even one atomic store over several instructions leaves a thread stopped between two of
+    // them resuming in the middle of the new bytes
+    if( GetInstructionLengthAt( addr ) < size ) {
+        return false;
+    }
+
+    auto mem = reinterpret_cast< uint8_t* >( addr );
+    if( WriteWindow8( mem, bytes, size ) ) {
+        return true;
+    }
+
+#if defined _M_X64 || defined __x86_64__
+    if( WriteWindow16( mem, bytes, size ) ) {
+        return true;
+    }
+#endif
+
+    std::lock_guard< std::mutex > lock( s_WriteLock );
+
+    if( !s_TrapInstalled ) {
+        InstallTrapHandler();
+        s_TrapInstalled = true;
+    }
+
+    uintptr_t at = reinterpret_cast< uintptr_t >( addr );
+    RememberTrap( at );
+    s_Pending.store( at, std::memory_order_seq_cst );
+
+    // Threads entering from here on stop at the int3; the body can then be written freely
+    *reinterpret_cast< volatile uint8_t* >( mem ) = LIVE_INT3;
+    SyncCores();
+
+    memcpy( mem + 1, bytes + 1, size - 1 );
+    SyncCores();
+
+    *reinterpret_cast< volatile uint8_t* >( mem ) = bytes[0];
+    SyncCores();
+
+    s_Pending.store( 0, std::memory_order_release );
+    return true;
+}
+
+void WriteCode( void* addr, const uint8_t* bytes, size_t size ) {
+    if( !LiveWrite( addr, bytes, size ) ) {
+        memcpy( addr, bytes, size );
+    }
+}
+
+void LiveWriteShutdown() {
+    std::lock_guard< std::mutex > lock( s_WriteLock );
+
+    if( s_TrapInstalled ) {
+        RemoveTrapHandler();
+        s_TrapInstalled = false;
+    }
+}
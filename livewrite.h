@@ -0,0 +1,71 @@
+/**
+ * vim: set ts=4 sw=4 tw=99 noet :
+ * =============================================================================
+ * SourceMod Source Scramble Extension
+ * 
+ * Copyright (C) 2019 nosoop
+ * Copyright (C) 2023 cravenge
+ *
+ * All rights reserved
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2", the
+ * "Source Engine", the "SourcePawn JIT" and any Game MODs that run on software
+ * by the Valve Corporation. You must obey the GNU General Public License in
+ * all respects for all other code used. Additionally, AlliedModders LLC grants
+ * this exception to all derivative works. AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>
+ *
+ * Version: $Id$
+ */
+
+#ifndef _INCLUDE_SOURCEMOD_SRCSCRMBL_LIVEWRITE_H_
+#define _INCLUDE_SOURCEMOD_SRCSCRMBL_LIVEWRITE_H_
+
+# ifndef _STDLIB_H_
+# include <stdlib.h>
+
+# endif
+# ifndef _STDINT_H
+# include "stdint.h"
+
+# endif
+// Writes code that other threads may be executing at the same time, so none of them ever
+// fetches a half-written instruction. The range has to be writable already and start at
+// an instruction boundary
+//
+// Only writes that stay within the instruction currently at "addr" are done. Those that
+// fit inside one aligned 8-byte window (16 bytes with cmpxchg16b on x86_64) are a single
+// atomic compare-and-swap. Longer ones first turn its first byte into an int3; threads
+// that run into it wait in a trap handler until the rest is written, then restart at the
+// first byte, which is swapped in last
+//
+// Anything else covers several instructions, and a thread stopped between two of them
+// would resume in the middle of the new bytes however they are written, even all at once.
+// Nothing is written then and false is returned; the caller has to write the range some
+// other way at a moment no other thread runs it
+bool LiveWrite( void* addr, const uint8_t* bytes, size_t size );
+
+// Goes through LiveWrite where it can and otherwise copies the bytes in plainly, which is
+// only safe while no other thread runs the range, such as at the start of a frame when the
+// patch queue is flushed
+void WriteCode( void* addr, const uint8_t* bytes, size_t size );
+
+// Puts back the trap handler that was there before the first int3 write
+void LiveWriteShutdown();
+
+#endif // _INCLUDE_SOURCEMOD_SRCSCRMBL_LIVEWRITE_H_
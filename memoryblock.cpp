@@ -33,13 +33,28 @@
  * Version: $Id$
  */
 
+#include <sm_platform.h>
+
 #include "memoryblock.h"
 
-MemoryBlock::MemoryBlock( size_t sz, bool store ) : size( sz ), stored( store ) {
+#ifdef PLATFORM_X64
+#include "PseudoAddrManager.h"
+
+#endif
+MemoryBlock::MemoryBlock( size_t sz, bool store ) : size( sz ), stored( store ), paddr( 0 ) {
     this->pBlock = calloc( sz, 1 );
+#ifdef PLATFORM_X64
+    if( this->pBlock )
+        this->paddr = pseudoAddr.Pin( this->pBlock );
+#endif
 }
 
 MemoryBlock::~MemoryBlock() {
-    if( !this->stored )
+    if( !this->stored ) {
+#ifdef PLATFORM_X64
+        if( this->paddr )
+            pseudoAddr.Unpin( this->paddr );
+#endif
         free( this->pBlock );
+    }
 }
\ No newline at end of file
@@ -39,6 +39,10 @@
 # ifndef _STDLIB_H_
 # include <stdlib.h>
 
+# endif
+# ifndef _STDINT_H
+# include "stdint.h"
+
 # endif
 struct MemoryBlock {
     MemoryBlock( size_t sz, bool store );
@@ -47,6 +51,9 @@ struct MemoryBlock {
     size_t size;
     void* pBlock;
     bool stored;
+
+    // Pseudo address of the block on x86_64, pinned for as long as the block exists
+    uint32_t paddr;
 };
 
 #endif // _INCLUDE_SOURCEMOD_SRCSCRMBL_MEMBLOCK_H_
\ No newline at end of file
@@ -33,109 +33,396 @@
  * Version: $Id$
  */
 
+#include "codecave.h"
+#include "livewrite.h"
 #include "memorypatch.h"
+#include "pageprotect.h"
+#include "patchkernels.h"
+#include "util.h"
+#include "x86insn.h"
 
-#include <sourcehook.h>
-#include <sh_memory.h>
+#include "string.h"
 
-MemoryPatch::MemoryPatch( void* addr, std::vector< uint8_t > &&mtch, std::vector< uint8_t > &&presv, std::vector< uint8_t > &&ovr, bool ot ) {
+#include <algorithm>
+
+MemoryPatch::MemoryPatch( void* addr, const std::vector< uint8_t > &mtch, const std::vector< uint8_t > &mask, const std::vector< uint8_t > &presv, const std::vector< uint8_t > &ovr, bool ot )
+    : bytes( mtch, mask, presv, ovr ) {
     this->pAddr = addr;
-    this->match = std::move( mtch );
-    this->preserve = std::move( presv );
-    this->overwrite = std::move( ovr );
     this->onetime = ot;
+    this->boundary = false;
+    this->variant = -1;
+    this->caveOriginal = PatchCaveOriginal_After;
+    this->cave = nullptr;
+    this->overlap = PatchOverlap_Stack;
+    this->node.patch = this;
+    this->node.sequence = 0;
+    this->queued = PatchQueued_None;
+    this->queueSlot = 0;
+    this->watch = PatchWatch_None;
+    this->watchCallback = nullptr;
+    this->watchData = 0;
+    this->watchCursor = 0;
+    this->lastVerified = 0.0f;
+    this->hndl = BAD_HANDLE;
+
+    // Enable() only resizes within these, so toggling a patch never allocates
+    this->original.reserve( this->bytes.Size( PatchField_Overwrite ) );
+    this->staged.reserve( this->bytes.Size( PatchField_Overwrite ) );
 }
 
-MemoryPatch::MemoryPatch( void* addr, const PatchGameConfig::PatchConf &info ) {
-    this->pAddr = reinterpret_cast< void* >( reinterpret_cast< uint8_t* >( addr ) + info.offset );
-    for( auto mtch : info.match ) {
-        this->match.emplace_back( mtch );
-    }
+MemoryPatch::MemoryPatch( void* addr, const PatchGameConfig::PatchConf &info, int variant ) {
+    if( info.variants.empty() ) {
+        this->pAddr = reinterpret_cast< void* >( reinterpret_cast< uint8_t* >( addr ) + info.offset );
+        this->bytes = info.bytes;
+        this->params = info.params;
+        this->variant = -1;
+    } else {
+        const PatchGameConfig::PatchVariant &chosen = info.variants[variant >= 0 ? variant : 0];
 
-    for( auto presv : info.preserve ) {
-        this->preserve.emplace_back( presv );
+        this->pAddr = reinterpret_cast< void* >( reinterpret_cast< uint8_t* >( addr ) + chosen.offset );
+        this->bytes = chosen.bytes;
+        this->params = chosen.params;
+        this->variant = variant;
+        if( variant >= 0 )
+            this->variantName = chosen.name;
     }
 
-    for( auto ovr : info.overwrite ) {
-        this->overwrite.emplace_back( ovr );
-    }
     this->onetime = info.onetime;
+    this->boundary = info.boundary;
+    this->caveCode = info.cave;
+    this->caveOriginal = info.caveOriginal;
+    this->cave = nullptr;
+    this->overlap = PatchOverlap_Stack;
+    this->node.patch = this;
+    this->node.sequence = 0;
+    this->queued = PatchQueued_None;
+    this->queueSlot = 0;
+    this->watch = PatchWatch_None;
+    this->watchCallback = nullptr;
+    this->watchData = 0;
+    this->watchCursor = 0;
+    this->lastVerified = 0.0f;
+    this->hndl = BAD_HANDLE;
+
+    this->original.reserve( this->bytes.Size( PatchField_Overwrite ) );
+    this->staged.reserve( this->bytes.Size( PatchField_Overwrite ) );
 }
 
 MemoryPatch::~MemoryPatch() {
+    g_PatchQueue.Cancel( this );
+    g_PatchWatchdog.Unwatch( this );
+
+    if( !this->IsEnabled() ) {
+        return;
+    }
+
     if( !this->onetime ) {
-        if( this->original.size() ) {
-            size_t i = 0;
-            while( i < this->original.size() ) {
-                *( reinterpret_cast< uint8_t* >( this->pAddr ) + i ) = this->original[i];
+        WritableScope scope( this->pAddr, this->original.size() );
+        this->Restore();
+    }
 
-                i++;
-            }
+    g_ActivePatches.Remove( &this->node );
+}
+
+// Patches sharing bytes with a write take what is now in memory as what they should find
+static void RefreshExpected( const std::vector< MemoryPatch* > &overlaps ) {
+    for( MemoryPatch* other : overlaps ) {
+        auto addr = reinterpret_cast< const uint8_t* >( other->pAddr );
+        other->staged.assign( addr, addr + other->original.size() );
+        other->watchCursor = 0;
+    }
+}
+
+bool MemoryPatch::Validate( bool boundary ) {
+    if( !this->Matches() ) {
+        return false;
+    }
+
+    return !( boundary || this->boundary ) || this->EndsOnBoundary();
+}
+
+bool MemoryPatch::Matches() const {
+    size_t size = this->bytes.Size( PatchField_Match );
+    return !size || GetPatchKernels().Match( reinterpret_cast< const uint8_t* >( this->pAddr ), this->bytes.Data( PatchField_Match ), this->bytes.Data( PatchField_Mask ), size );
+}
+
+size_t MemoryPatch::Relocate( const void* base, size_t window ) {
+    size_t length = this->bytes.Size( PatchField_Match );
+    if( !length || this->IsEnabled() ) {
+        return 0;
+    }
+
+    uintptr_t expected = reinterpret_cast< uintptr_t >( this->pAddr );
+    uintptr_t lower = std::max( reinterpret_cast< uintptr_t >( base ), expected > window ? expected - window : 0 );
+    uintptr_t upper = expected + window + length;
+    if( lower >= upper ) {
+        return 0;
+    }
+
+    // The window may run past the end of the module, so only what could be read is searched
+    std::vector< uint8_t > code( upper - lower );
+    size_t read = ReadMemorySafe( code.data(), reinterpret_cast< const void* >( lower ), code.size() );
+
+    size_t found[2];
+    size_t count = GetPatchKernels().Find( code.data(), read, this->bytes.Data( PatchField_Match ), this->bytes.Data( PatchField_Mask ), length, found, 2 );
+    if( count == 1 ) {
+        this->pAddr = reinterpret_cast< void* >( lower + found[0] );
+    }
+    return count;
+}
+
+bool MemoryPatch::PadWithNops( size_t instructions ) {
+    if( this->IsEnabled() ) {
+        return false;
+    }
+
+    size_t size = this->bytes.Size( PatchField_Overwrite );
+    size_t span = GetInstructionsLengthAt( this->pAddr, instructions );
+    if( !span || span < size ) {
+        return false;
+    }
+
+    this->bytes.Resize( PatchField_Overwrite, span, 0x90 );
+    FillNops( this->bytes.MutableData( PatchField_Overwrite ) + size, span - size );
 
-            this->original.clear();
+    this->original.reserve( span );
+    this->staged.reserve( span );
+    return true;
+}
+
+bool MemoryPatch::PrepareCave() {
+    if( this->IsEnabled() ) {
+        return false;
+    }
+
+    // Whole instructions are moved out to the cave to make room for the jump
+    auto code = reinterpret_cast< const uint8_t* >( this->pAddr );
+
+    size_t span = 0;
+    while( span < 5 ) {
+        size_t length = GetInstructionLengthAt( code + span );
+        if( !length ) {
+            return false;
         }
+        span += length;
     }
+
+    this->bytes.Resize( PatchField_Overwrite, span, 0x90 );
+    this->bytes.Resize( PatchField_Preserve, 0, 0x00 );
+    this->params.clear();
+
+    uint8_t* overwrite = this->bytes.MutableData( PatchField_Overwrite );
+    overwrite[0] = 0xE9;
+    memset( overwrite + 1, 0, 4 );
+    FillNops( overwrite + 5, span - 5 );
+
+    this->original.reserve( span );
+    this->staged.reserve( span );
+    return true;
 }
 
-bool MemoryPatch::Validate() {
-    if( !this->match.size() ) {
-        return true;
+// Lays out the cave code, the instructions "overwrite" replaces and a jump back past them,
+// then aims the jump at the start of "overwrite" at the cave
+bool MemoryPatch::BuildCave() {
+    uintptr_t from = reinterpret_cast< uintptr_t >( this->pAddr );
+    size_t span = this->bytes.Size( PatchField_Overwrite );
+    if( span < 5 ) {
+        return false;
     }
 
-    size_t i = 0;
+    std::vector< uint8_t > replaced( reinterpret_cast< const uint8_t* >( from ), reinterpret_cast< const uint8_t* >( from ) + span );
 
-    auto addr = reinterpret_cast< uint8_t* >( this->pAddr );
-    while( i < this->match.size() ) {
-        if( this->match[i] != '*' && this->match[i] != addr[i] ) {
+    // Relocated code is as long wherever it goes, so it can be measured before there is a cave
+    size_t moved = 0;
+    if( this->caveOriginal != PatchCaveOriginal_None ) {
+        moved = RelocateInstructions( replaced.data(), span, from, from, nullptr, SIZE_MAX );
+        if( !moved ) {
             return false;
         }
+    }
+
+    size_t codeSize = this->caveCode.size();
+    auto cave = reinterpret_cast< uint8_t* >( AllocateCodeCave( this->pAddr, codeSize + moved + 5 ) );
+    if( cave == nullptr ) {
+        return false;
+    }
+
+    uint8_t* movedTo = this->caveOriginal == PatchCaveOriginal_Before ? cave : cave + codeSize;
+    if( moved && RelocateInstructions( replaced.data(), span, from, reinterpret_cast< uintptr_t >( movedTo ), movedTo, moved ) != moved ) {
+        FreeCodeCave( cave );
+        return false;
+    }
 
-        i++;
+    memcpy( this->caveOriginal == PatchCaveOriginal_Before ? cave + moved : cave, this->caveCode.data(), codeSize );
+
+    // Both jumps are within reach, which is what the cave was placed for
+    uint8_t* back = cave + codeSize + moved;
+    int32_t disp = static_cast< int32_t >( static_cast< intptr_t >( from + span - reinterpret_cast< uintptr_t >( back + 5 ) ) );
+    back[0] = 0xE9;
+    memcpy( back + 1, &disp, sizeof( disp ) );
+
+    if( !FinishCodeCave( cave ) ) {
+        FreeCodeCave( cave );
+        return false;
     }
+
+    disp = static_cast< int32_t >( static_cast< intptr_t >( reinterpret_cast< uintptr_t >( cave ) - ( from + 5 ) ) );
+    uint8_t* overwrite = this->bytes.MutableData( PatchField_Overwrite );
+    overwrite[0] = 0xE9;
+    memcpy( overwrite + 1, &disp, sizeof( disp ) );
+
+    this->cave = cave;
     return true;
 }
 
-bool MemoryPatch::Enable() {
-    if( this->original.size() ) {
+bool MemoryPatch::EndsOnBoundary() const {
+    // Once enabled, decoding would only look at the patch itself
+    if( this->IsEnabled() ) {
+        return true;
+    }
+
+    auto code = reinterpret_cast< const uint8_t* >( this->pAddr );
+
+    size_t size = this->bytes.Size( PatchField_Overwrite ), offset = 0;
+    while( offset < size ) {
+        size_t length = GetInstructionLengthAt( code + offset );
+        if( !length ) {
+            return false;
+        }
+        offset += length;
+    }
+    return offset == size;
+}
+
+bool MemoryPatch::Enable( bool unprotect ) {
+    if( this->IsEnabled() ) {
         return false;
     }
 
-    size_t i = 0;
-    while( i < this->overwrite.size() ) {
-        this->original.emplace_back( *( reinterpret_cast< uint8_t* >( this->pAddr ) + i ) );
+    size_t size = this->bytes.Size( PatchField_Overwrite );
+    if( !size ) {
+        return true;
+    }
+
+    uintptr_t lower = reinterpret_cast< uintptr_t >( this->pAddr );
+
+    std::vector< MemoryPatch* > overlaps;
+    g_ActivePatches.FindOverlaps( lower, lower + size, overlaps );
+
+    for( MemoryPatch* other : overlaps ) {
+        if( this->overlap == PatchOverlap_Reject || other->overlap == PatchOverlap_Reject ) {
+            return false;
+        }
+    }
+
+    // The cave is only built now, as it has to sit within reach of the code
+    if( !this->caveCode.empty() && !this->BuildCave() ) {
+        return false;
+    }
 
-        i++;
+    for( MemoryPatch* other : overlaps ) {
+        if( other->owner != this->owner ) {
+            smutils->LogMessage(myself, "Patch at %p (%s) is stacked on top of the one at %p (%s)", this->pAddr, this->owner.c_str(), other->pAddr, other->owner.c_str());
+            break;
+        }
     }
 
-    SourceHook::SetMemAccess(this->pAddr, this->overwrite.size() * sizeof( uint8_t ), SH_MEM_READ | SH_MEM_WRITE | SH_MEM_EXEC);
+    this->original.resize( size );
 
-    i = 0;
+    // The patched bytes are put together on the side, so that other threads running this
+    // code only ever see them go live all at once
+    auto addr = reinterpret_cast< uint8_t* >( this->pAddr );
+    this->staged.assign( addr, addr + size );
 
-    uint8_t presvBit;
-    while( i < this->overwrite.size() ) {
-        presvBit = 0;
-        if( this->preserve.size() > i )
-            presvBit = this->preserve[i];
+    // Bytes past the end of "preserve" are overwritten as a whole
+    const uint8_t* overwrite = this->bytes.Data( PatchField_Overwrite );
+    size_t merged = std::min( this->bytes.Size( PatchField_Preserve ), size );
+    GetPatchKernels().Apply( this->staged.data(), this->original.data(), overwrite, this->bytes.Data( PatchField_Preserve ), merged );
 
-        *( reinterpret_cast< uint8_t* >( this->pAddr ) + i ) = ( this->overwrite[i] & ~presvBit ) | ( this->original[i] & presvBit );
+    memcpy( this->original.data() + merged, addr + merged, size - merged );
+    memcpy( this->staged.data() + merged, overwrite + merged, size - merged );
 
-        i++;
+    // The original protection is put back once the scope ends
+    WritableScope scope;
+    if( unprotect ) {
+        scope.Add( this->pAddr, size * sizeof( uint8_t ) );
     }
+
+    WriteCode( addr, this->staged.data(), size );
+    RefreshExpected( overlaps );
+
+    g_ActivePatches.Insert( &this->node, lower, lower + size );
     return true;
 }
 
-bool MemoryPatch::Disable() {
-    if( !this->original.size() ) {
+bool MemoryPatch::Disable( bool unprotect ) {
+    if( !this->IsEnabled() ) {
         return false;
     }
 
-    size_t i = 0;
-    while( i < this->original.size() ) {
-        *( reinterpret_cast< uint8_t* >( this->pAddr ) + i ) = this->original[i];
+    WritableScope scope;
+    if( unprotect ) {
+        scope.Add( this->pAddr, this->original.size() );
+    }
+
+    this->Restore();
+
+    g_ActivePatches.Remove( &this->node );
+    return true;
+}
+
+bool MemoryPatch::IsEnabled() const {
+    return this->node.sequence != 0;
+}
+
+// Bytes that a patch enabled later still covers are not written back; instead, the lowest
+// such patch inherits them as its own original bytes, so whichever of the two is disabled
+// last puts back what was there before either
+void MemoryPatch::Restore() {
+    size_t size = this->original.size();
+    uintptr_t lower = reinterpret_cast< uintptr_t >( this->pAddr );
 
-        i++;
+    std::vector< MemoryPatch* > overlaps;
+    g_ActivePatches.FindOverlaps( lower, lower + size, overlaps );
+
+    overlaps.erase( std::remove( overlaps.begin(), overlaps.end(), this ), overlaps.end() );
+
+    bool covered = std::any_of( overlaps.begin(), overlaps.end(), [this]( const MemoryPatch* other ) {
+        return other->node.sequence > this->node.sequence;
+    } );
+
+    if( !covered ) {
+        WriteCode( this->pAddr, this->original.data(), size );
+    } else {
+        auto addr = reinterpret_cast< uint8_t* >( this->pAddr );
+        this->staged.assign( addr, addr + size );
+
+        for( size_t i = 0; i < size; i++ ) {
+            MemoryPatch* above = nullptr;
+            for( MemoryPatch* other : overlaps ) {
+                uintptr_t offset = lower + i - other->node.lower;
+                if( other->node.sequence > this->node.sequence && lower + i >= other->node.lower && offset < other->original.size()
+                    && ( above == nullptr || other->node.sequence < above->node.sequence ) ) {
+                    above = other;
+                }
+            }
+
+            if( above != nullptr ) {
+                above->original[lower + i - above->node.lower] = this->original[i];
+            } else {
+                this->staged[i] = this->original[i];
+            }
+        }
+
+        WriteCode( addr, this->staged.data(), size );
     }
 
+    RefreshExpected( overlaps );
+
     this->original.clear();
-    return true;
+
+    if( this->cave != nullptr ) {
+        FreeCodeCave( this->cave );
+        this->cave = nullptr;
+    }
 }
\ No newline at end of file
@@ -37,24 +37,93 @@
 #define _INCLUDE_SOURCEMOD_SRCSCRMBL_MEMPATCH_H_
 
 #include "patches.h"
+#include "patchindex.h"
+#include "patchqueue.h"
+#include "patchwatchdog.h"
+#include "pinnedaddress.h"
+
+// Mirrors the PatchOverlap enumeration in srcscramble.inc
+enum PatchOverlap {
+    PatchOverlap_Stack,     // Sit on top of overlapping patches; restores stay consistent in any order
+    PatchOverlap_Reject     // Refuse to be enabled alongside an overlapping patch, and keep others out
+};
 
 struct MemoryPatch {
-    MemoryPatch( void* addr, std::vector< uint8_t > &&mtch, std::vector< uint8_t > &&presv, std::vector< uint8_t > &&ovr, bool ot );
-    MemoryPatch( void* addr, const PatchGameConfig::PatchConf &info );
+    MemoryPatch( void* addr, const std::vector< uint8_t > &mtch, const std::vector< uint8_t > &mask, const std::vector< uint8_t > &presv, const std::vector< uint8_t > &ovr, bool ot );
+    // "variant" picks one of info.variants; FromConf only creates patches from a variant that matched
+    MemoryPatch( void* addr, const PatchGameConfig::PatchConf &info, int variant = -1 );
     ~MemoryPatch();
 
-    bool Validate();
-    bool Enable();
-    bool Disable();
+    // "boundary" also requires the patch to end on an instruction boundary, as does a
+    // "boundary" key in the game config
+    bool Validate( bool boundary = false );
+    bool Matches() const;
+
+    // Looks for "match" within "window" bytes either side of the patch, but never before
+    // "base", and moves the patch there if it turns up exactly once. Returns how many places
+    // matched, stopping at 2
+    size_t Relocate( const void* base, size_t window );
+
+    // Extends "overwrite" with NOPs up to the end of the given number of instructions
+    bool PadWithNops( size_t instructions );
+    bool EndsOnBoundary() const;
+
+    // Turns "overwrite" into a jump to the cave, followed by NOPs up to the end of the last
+    // instruction it cuts into. The cave itself is only built when the patch is enabled
+    bool PrepareCave();
+
+    // Callers that already made the whole range writable (e.g. a MemoryPatchGroup) pass false
+    bool Enable( bool unprotect = true );
+    bool Disable( bool unprotect = true );
+
+    bool IsEnabled() const;
 
     void* pAddr;
 
-    std::vector< uint8_t > match;
-    std::vector< uint8_t > preserve;
-    std::vector< uint8_t > overwrite;
+    // "match", its mask, "preserve" and "overwrite"; copied only once they are changed
+    PatchBytes bytes;
+    std::vector< PatchParam > params;   // Placeholders in "overwrite", filled in by BindMemoryPatchParams
     std::vector< uint8_t > original;
+    // Bytes expected at the address while enabled. Refreshed whenever an overlapping patch is
+    // written, so that PatchWatchdog can tell when anything else overwrote them
+    std::vector< uint8_t > staged;
 
     bool onetime;
+    bool boundary;
+
+    // Variant of the config entry that matched, or -1
+    int variant;
+    std::string variantName;
+
+    // Code jumped out to from the start of the patch, and where it lives while enabled
+    std::vector< uint8_t > caveCode;
+    int caveOriginal;
+    void* cave;
+
+    // Who to blame in the list of enabled patches
+    std::string owner;
+    int overlap;
+
+    PatchIndexNode node;
+
+    // Pending PatchQueue request, and where it sits in the queue
+    int queued;
+    size_t queueSlot;
+
+    // PatchWatchdog settings and progress
+    int watch;
+    IPluginFunction* watchCallback;
+    cell_t watchData;
+    size_t watchCursor;     // Bytes already compared in the current pass
+    float lastVerified;
+
+    Handle_t hndl;
+
+    // What GetMemoryPatchAddress gave out, which follows the patch when it is relocated
+    PinnedAddress pinned;
+private:
+    bool BuildCave();
+    void Restore();
 };
 
 #endif // _INCLUDE_SOURCEMOD_SRCSCRMBL_MEMPATCH_H_
\ No newline at end of file
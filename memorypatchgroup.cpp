@@ -0,0 +1,129 @@
+/**
+ * vim: set ts=4 sw=4 tw=99 noet :
+ * =============================================================================
+ * SourceMod Source Scramble Extension
+ * 
+ * Copyright (C) 2019 nosoop
+ * Copyright (C) 2023 cravenge
+ *
+ * All rights reserved
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2", the
+ * "Source Engine", the "SourcePawn JIT" and any Game MODs that run on software
+ * by the Valve Corporation. You must obey the GNU General Public License in
+ * all respects for all other code used. Additionally, AlliedModders LLC grants
+ * this exception to all derivative works. AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>
+ *
+ * Version: $Id$
+ */
+
+#include "memorypatchgroup.h"
+#include "pageprotect.h"
+
+#include <algorithm>
+
+static constexpr uintptr_t PATCH_PAGE_SIZE = 0x1000;
+
+// One protection change per run of adjacent pages instead of one per member
+void AddPatchPages( const std::vector< MemoryPatch* > &patches, WritableScope &scope ) {
+    std::vector< std::pair< uintptr_t, uintptr_t > > pages;
+    pages.reserve( patches.size() );
+
+    for( MemoryPatch* patch : patches ) {
+        if( patch == nullptr ) {
+            continue;
+        }
+
+        // Disable() writes back "original", which "overwrite" may have outgrown since
+        size_t size = std::max( patch->bytes.Size( PatchField_Overwrite ), patch->original.size() );
+        if( !size ) {
+            continue;
+        }
+
+        uintptr_t start = reinterpret_cast< uintptr_t >( patch->pAddr );
+        uintptr_t end = start + size;
+        pages.emplace_back( start & ~( PATCH_PAGE_SIZE - 1 ), ( end + PATCH_PAGE_SIZE - 1 ) & ~( PATCH_PAGE_SIZE - 1 ) );
+    }
+
+    std::sort( pages.begin(), pages.end() );
+
+    for( size_t i = 0; i < pages.size(); ) {
+        uintptr_t start = pages[i].first, end = pages[i].second;
+        for( i++; i < pages.size() && pages[i].first <= end; i++ ) {
+            end = std::max( end, pages[i].second );
+        }
+
+        scope.Add( reinterpret_cast< void* >( start ), end - start );
+    }
+}
+
+MemoryPatchGroup::MemoryPatchGroup() {
+    this->enabled = false;
+}
+
+bool MemoryPatchGroup::Enable( const std::vector< MemoryPatch* > &patches, size_t &failed ) {
+    if( this->enabled ) {
+        return false;
+    }
+
+    // Nothing is touched unless every member is still in place and not applied on its own
+    for( size_t i = 0; i < patches.size(); i++ ) {
+        MemoryPatch* patch = patches[i];
+        if( patch == nullptr || patch->IsEnabled() || !patch->Validate() ) {
+            failed = i;
+            return false;
+        }
+    }
+
+    WritableScope scope;
+    AddPatchPages( patches, scope );
+
+    for( size_t i = 0; i < patches.size(); i++ ) {
+        if( !patches[i]->Enable( false ) ) {
+            failed = i;
+
+            while( i-- ) {
+                patches[i]->Disable( false );
+            }
+            return false;
+        }
+    }
+
+    this->enabled = true;
+    return true;
+}
+
+bool MemoryPatchGroup::Disable( const std::vector< MemoryPatch* > &patches ) {
+    if( !this->enabled ) {
+        return false;
+    }
+
+    WritableScope scope;
+    AddPatchPages( patches, scope );
+
+    // Members freed in the meantime have already restored their bytes on destruction
+    for( size_t i = patches.size(); i--; ) {
+        if( patches[i] != nullptr ) {
+            patches[i]->Disable( false );
+        }
+    }
+
+    this->enabled = false;
+    return true;
+}
\ No newline at end of file
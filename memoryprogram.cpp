@@ -0,0 +1,203 @@
+/**
+ * vim: set ts=4 sw=4 tw=99 noet :
+ * =============================================================================
+ * SourceMod Source Scramble Extension
+ * 
+ * Copyright (C) 2019 nosoop
+ * Copyright (C) 2023 cravenge
+ *
+ * All rights reserved
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2", the
+ * "Source Engine", the "SourcePawn JIT" and any Game MODs that run on software
+ * by the Valve Corporation. You must obey the GNU General Public License in
+ * all respects for all other code used. Additionally, AlliedModders LLC grants
+ * this exception to all derivative works. AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>
+ *
+ * Version: $Id$
+ */
+
+#include <sm_platform.h>
+
+#include "memoryprogram.h"
+#include "util.h"
+
+#include "string.h"
+
+#ifdef PLATFORM_X64
+# ifdef PLATFORM_LINUX
+# define _INTTYPES_H	1
+
+# endif
+#include "PseudoAddrManager.h"
+
+#endif
+// Anything below this is either null or reserved, as with EnableMemoryPatch
+static inline bool IsBadPointer( intptr_t addr ) {
+    return static_cast< uintptr_t >( addr ) < 0x10000;
+}
+
+// Runs the program over a set of MAX_REGISTERS registers. On failure, the index of the op
+// that failed and the reason are handed back so the native can report them.
+bool MemoryProgram::Execute( intptr_t* regs, intptr_t &result, size_t &failedOp, const char* &error ) const {
+    size_t pc = 0;
+    size_t steps = 0;
+    size_t copied = 0;
+
+    std::vector< uint8_t > copyBuffer;
+
+    result = 0;
+    while( pc < this->ops.size() ) {
+        if( ++steps > MAX_STEPS ) {
+            failedOp = pc;
+            error = "Too many steps taken, the program may be stuck in a loop";
+            return false;
+        }
+
+        const Op &op = this->ops[pc];
+        intptr_t &ra = regs[op.a];
+        intptr_t &rb = regs[op.b];
+
+        size_t next = pc + 1;
+        switch( op.code ) {
+            case MemoryOp_Set: {
+                ra = op.imm;
+                break;
+            }
+            case MemoryOp_Move: {
+                ra = rb;
+                break;
+            }
+            case MemoryOp_Add: {
+                ra = ra + rb + op.imm;
+                break;
+            }
+            case MemoryOp_Load:
+            case MemoryOp_LoadPointer:
+            case MemoryOp_Store: {
+                if( IsBadPointer( rb ) ) {
+                    failedOp = pc;
+                    error = "Null pointer dereferenced";
+                    return false;
+                }
+
+                // Past the null check, pointers can still be stale or point at code, so
+                // a fault fails the op instead of taking the server down
+                void* addr = reinterpret_cast< void* >( rb + op.imm );
+                if( op.code == MemoryOp_Store ) {
+                    if( WriteMemorySafe( addr, &ra, op.width ) != op.width ) {
+                        failedOp = pc;
+                        error = "Memory is not writable";
+                        return false;
+                    }
+                } else if( op.code == MemoryOp_LoadPointer ) {
+                    if( ReadMemorySafe( &ra, addr, sizeof( void* ) ) != sizeof( void* ) ) {
+                        failedOp = pc;
+                        error = "Memory is not readable";
+                        return false;
+                    }
+                } else {
+                    uint32_t val = 0;
+                    if( ReadMemorySafe( &val, addr, op.width ) != op.width ) {
+                        failedOp = pc;
+                        error = "Memory is not readable";
+                        return false;
+                    }
+                    ra = static_cast< intptr_t >( val );
+                }
+                break;
+            }
+            case MemoryOp_Copy: {
+                if( IsBadPointer( ra ) || IsBadPointer( rb ) ) {
+                    failedOp = pc;
+                    error = "Null pointer dereferenced";
+                    return false;
+                }
+
+                size_t size = static_cast< size_t >( op.imm );
+                copied += size;
+                if( copied > MAX_COPY_TOTAL ) {
+                    failedOp = pc;
+                    error = "Too many bytes copied";
+                    return false;
+                }
+
+                // Read in full before writing, which also keeps overlapping ranges intact
+                if( copyBuffer.size() < size )
+                    copyBuffer.resize( size );
+
+                if( ReadMemorySafe( copyBuffer.data(), reinterpret_cast< const void* >( rb ), size ) != size ) {
+                    failedOp = pc;
+                    error = "Memory is not readable";
+                    return false;
+                }
+
+                if( WriteMemorySafe( reinterpret_cast< void* >( ra ), copyBuffer.data(), size ) != size ) {
+                    failedOp = pc;
+                    error = "Memory is not writable";
+                    return false;
+                }
+                break;
+            }
+            case MemoryOp_Compare: {
+                ra = ( ra < rb ) ? -1 : ( ( ra > rb ) ? 1 : 0 );
+                break;
+            }
+            case MemoryOp_Jump: {
+                next = static_cast< size_t >( op.imm );
+                break;
+            }
+            case MemoryOp_JumpIfZero: {
+                if( !ra )
+                    next = static_cast< size_t >( op.imm );
+                break;
+            }
+            case MemoryOp_JumpIfNotZero: {
+                if( ra )
+                    next = static_cast< size_t >( op.imm );
+                break;
+            }
+            case MemoryOp_Return: {
+                result = op.imm;
+                return true;
+            }
+            case MemoryOp_ToAddress: {
+#ifdef PLATFORM_X64
+                ra = static_cast< intptr_t >( pseudoAddr.ToPseudoAddress( reinterpret_cast< void* >( ra ) ) );
+#endif
+                break;
+            }
+            case MemoryOp_FromAddress: {
+#ifdef PLATFORM_X64
+                ra = reinterpret_cast< intptr_t >( pseudoAddr.FromPseudoAddress( static_cast< uint32_t >( ra ) ) );
+#endif
+                break;
+            }
+        }
+
+        if( next > this->ops.size() ) {
+            failedOp = pc;
+            error = "Jump target is out of range";
+            return false;
+        }
+
+        pc = next;
+    }
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+/**
+ * vim: set ts=4 sw=4 tw=99 noet :
+ * =============================================================================
+ * SourceMod Source Scramble Extension
+ * 
+ * Copyright (C) 2019 nosoop
+ * Copyright (C) 2023 cravenge
+ *
+ * All rights reserved
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2", the
+ * "Source Engine", the "SourcePawn JIT" and any Game MODs that run on software
+ * by the Valve Corporation. You must obey the GNU General Public License in
+ * all respects for all other code used. Additionally, AlliedModders LLC grants
+ * this exception to all derivative works. AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>
+ *
+ * Version: $Id$
+ */
+
+#ifndef _INCLUDE_SOURCEMOD_SRCSCRMBL_MEMPROGRAM_H_
+#define _INCLUDE_SOURCEMOD_SRCSCRMBL_MEMPROGRAM_H_
+
+# ifndef _STDLIB_H_
+# include <stdlib.h>
+
+# endif
+# ifndef _STDINT_H
+# include "stdint.h"
+
+# endif
+#include <vector>
+
+// Mirrors the MemoryOp enumeration in srcscramble.inc
+enum MemoryOp {
+    MemoryOp_Set,           // r[a] = imm
+    MemoryOp_Move,          // r[a] = r[b]
+    MemoryOp_Add,           // r[a] = r[a] + r[b] + imm
+    MemoryOp_Load,          // r[a] = *(size*)( r[b] + imm )
+    MemoryOp_LoadPointer,   // r[a] = *(void**)( r[b] + imm )
+    MemoryOp_Store,         // *(size*)( r[b] + imm ) = r[a]
+    MemoryOp_Copy,          // memcpy( r[a], r[b], imm )
+    MemoryOp_Compare,       // r[a] = r[a] < r[b] ? -1 : ( r[a] > r[b] ? 1 : 0 )
+    MemoryOp_Jump,          // continue at op imm
+    MemoryOp_JumpIfZero,    // continue at op imm if r[a] is 0 (or null)
+    MemoryOp_JumpIfNotZero, // continue at op imm if r[a] is not 0
+    MemoryOp_Return,        // stop and return imm
+    MemoryOp_ToAddress,     // r[a] = address usable by plug-ins for r[a]
+    MemoryOp_FromAddress,   // r[a] = real address for the plug-in address in r[a]
+
+    MemoryOp_Count
+};
+
+struct MemoryProgram {
+    static constexpr size_t MAX_REGISTERS = 16;
+    static constexpr size_t MAX_COPY_SIZE = 0x10000;
+
+    // Guards against programs that loop forever
+    static constexpr size_t MAX_STEPS = 0x100000;
+
+    // Bytes all MemoryOp_Copy ops of one run may copy together, which would otherwise be
+    // bounded only by MAX_STEPS * MAX_COPY_SIZE
+    static constexpr size_t MAX_COPY_TOTAL = 0x1000000;
+
+    struct Op {
+        uint8_t code;
+        uint8_t width;
+        uint8_t a;
+        uint8_t b;
+        intptr_t imm;
+    };
+
+    bool Execute( intptr_t* regs, intptr_t &result, size_t &failedOp, const char* &error ) const;
+
+    std::vector< Op > ops;
+};
+
+#endif // _INCLUDE_SOURCEMOD_SRCSCRMBL_MEMPROGRAM_H_
\ No newline at end of file
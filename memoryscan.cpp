@@ -0,0 +1,481 @@
+/**
+ * vim: set ts=4 sw=4 tw=99 noet :
+ * =============================================================================
+ * SourceMod Source Scramble Extension
+ * 
+ * Copyright (C) 2019 nosoop
+ * Copyright (C) 2023 cravenge
+ *
+ * All rights reserved
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2", the
+ * "Source Engine", the "SourcePawn JIT" and any Game MODs that run on software
+ * by the Valve Corporation. You must obey the GNU General Public License in
+ * all respects for all other code used. Additionally, AlliedModders LLC grants
+ * this exception to all derivative works. AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>
+ *
+ * Version: $Id$
+ */
+
+#include "memoryscan.h"
+#include "moduleinfo.h"
+#include "util.h"
+
+#include <algorithm>
+
+#include <math.h>
+
+#if defined PLATFORM_LINUX
+#include <inttypes.h>
+#include <stdio.h>
+
+#elif defined PLATFORM_APPLE
+#include <dlfcn.h>
+#include <mach/mach.h>
+
+#endif
+#if defined __SSE2__ || defined _M_X64 || ( defined _M_IX86_FP && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+
+#define SCAN_USE_SSE2
+
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+
+#endif
+// Regions are read in chunks of this size so that the work spreads evenly across workers
+static constexpr size_t SCAN_CHUNK_SIZE = 1 << 20;
+static constexpr size_t SCAN_PAGE_SIZE = 0x1000;
+
+// Number of previous results a worker re-checks per job during a refining pass
+static constexpr size_t SCAN_REFINE_BATCH = 0x4000;
+
+static constexpr unsigned int SCAN_MAX_WORKERS = 8;
+
+static std::vector< MemoryScan* > s_PendingScans;
+
+static inline unsigned int LowestBitIndex( unsigned int mask ) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward( &index, mask );
+    return static_cast< unsigned int >( index );
+#else
+    return static_cast< unsigned int >( __builtin_ctz( mask ) );
+#endif
+}
+
+MemoryScan::MemoryScan( int typ ) : type( typ ), hndl( BAD_HANDLE ), m_NumJobs( 0 ), m_NextJob( 0 ), m_Scanned( false ), m_MaxResults( 0 ),
+    m_Running( 0 ), m_Stop( false ), m_Callback( nullptr ), m_Data( 0 ) {
+    this->width = ( typ == ScanType_Float ) ? sizeof( float ) : GetNumberTypeByteCount( typ );
+}
+
+MemoryScan::~MemoryScan() {
+    this->Cancel();
+}
+
+bool MemoryScan::Start( cell_t value, cell_t tolerance, size_t maxResults, const char* module, bool writableOnly, IPluginFunction* callback, cell_t data ) {
+    if( this->IsBusy() )
+        return false;
+
+    this->SetBounds( value, tolerance );
+
+    this->m_MaxResults = maxResults;
+    this->m_Callback = callback;
+    this->m_Data = data;
+
+    this->m_Found.clear();
+    this->m_Chunks.clear();
+    if( this->m_Scanned ) {
+        this->m_NumJobs = ( this->results.size() + SCAN_REFINE_BATCH - 1 ) / SCAN_REFINE_BATCH;
+    } else {
+        this->CollectRanges( module, writableOnly );
+        this->m_NumJobs = this->m_Chunks.size();
+    }
+
+    this->m_NextJob = 0;
+    this->m_Stop = false;
+
+    // Leave a core to the game itself
+    unsigned int numWorkers = std::thread::hardware_concurrency();
+    if( numWorkers > 1 )
+        numWorkers--;
+
+    numWorkers = std::min( { std::max( numWorkers, 1u ), SCAN_MAX_WORKERS, static_cast< unsigned int >( std::max( this->m_NumJobs, static_cast< size_t >( 1 ) ) ) } );
+
+    this->m_Running = numWorkers;
+    s_PendingScans.emplace_back( this );
+
+    bool refine = this->m_Scanned;
+    for( unsigned int i = 0; i < numWorkers; i++ ) {
+        this->m_Workers.emplace_back( [this, refine]() {
+            if( refine ) {
+                this->Refine();
+            } else {
+                this->Search();
+            }
+
+            this->m_Running--;
+        } );
+    }
+    return true;
+}
+
+void MemoryScan::Cancel() {
+    this->m_Stop = true;
+    for( auto &worker : this->m_Workers ) {
+        worker.join();
+    }
+    this->m_Workers.clear();
+
+    auto it = std::find( s_PendingScans.begin(), s_PendingScans.end(), this );
+    if( it != s_PendingScans.end() )
+        s_PendingScans.erase( it );
+
+    this->m_Found.clear();
+    this->m_Chunks.clear();
+}
+
+void MemoryScan::Reset() {
+    this->Cancel();
+
+    this->results.clear();
+    this->m_Scanned = false;
+}
+
+bool MemoryScan::IsBusy() const {
+    return !this->m_Workers.empty();
+}
+
+// Runs on the main thread every frame; hands over the results of every pass whose workers
+// are all done and lets the owning plug-in know about them.
+void MemoryScan::ProcessFinished( bool simulating ) {
+    size_t i = 0;
+    while( i < s_PendingScans.size() ) {
+        MemoryScan* pScan = s_PendingScans[i];
+        if( pScan->m_Running ) {
+            i++;
+            continue;
+        }
+
+        s_PendingScans.erase( s_PendingScans.begin() + i );
+        for( auto &worker : pScan->m_Workers ) {
+            worker.join();
+        }
+        pScan->m_Workers.clear();
+
+        std::sort( pScan->m_Found.begin(), pScan->m_Found.end() );
+
+        pScan->results.swap( pScan->m_Found );
+        pScan->m_Found.clear();
+        pScan->m_Chunks.clear();
+        pScan->m_Scanned = true;
+
+        // The callback is free to delete the scan, so nothing is touched afterwards
+        IPluginFunction* callback = pScan->m_Callback;
+        if( callback != nullptr && callback->IsRunnable() ) {
+            callback->PushCell( static_cast< cell_t >( pScan->hndl ) );
+            callback->PushCell( static_cast< cell_t >( pScan->results.size() ) );
+            callback->PushCell( pScan->m_Data );
+            callback->Execute( nullptr );
+        }
+    }
+}
+
+void MemoryScan::SetBounds( cell_t value, cell_t tolerance ) {
+    if( this->type == ScanType_Float ) {
+        float val = sp_ctof( value );
+        float tol = fabsf( sp_ctof( tolerance ) );
+
+        this->m_LowerFloat = val - tol;
+        this->m_UpperFloat = val + tol;
+        return;
+    }
+
+    // Smaller types are unsigned, as they are with LoadFromAddress
+    int64_t minVal = INT32_MIN, maxVal = INT32_MAX;
+    int64_t val = value;
+    if( this->width < sizeof( uint32_t ) ) {
+        maxVal = ( static_cast< int64_t >( 1 ) << ( this->width * 8 ) ) - 1;
+        minVal = 0;
+
+        val &= maxVal;
+    }
+
+    int64_t tol = tolerance < 0 ? -static_cast< int64_t >( tolerance ) : tolerance;
+    this->m_Lower = std::max( val - tol, minVal );
+    this->m_Upper = std::min( val + tol, maxVal );
+}
+
+bool MemoryScan::Matches( const uint8_t* ptr ) const {
+    switch( this->type ) {
+        case ScanType_Int8: {
+            return *ptr >= this->m_Lower && *ptr <= this->m_Upper;
+        }
+        case ScanType_Int16: {
+            uint16_t val;
+            memcpy( &val, ptr, sizeof( val ) );
+            return val >= this->m_Lower && val <= this->m_Upper;
+        }
+        case ScanType_Int32: {
+            int32_t val;
+            memcpy( &val, ptr, sizeof( val ) );
+            return val >= this->m_Lower && val <= this->m_Upper;
+        }
+        case ScanType_Float: {
+            float val;
+            memcpy( &val, ptr, sizeof( val ) );
+            return val >= this->m_LowerFloat && val <= this->m_UpperFloat;
+        }
+    }
+    return false;
+}
+
+#ifdef SCAN_USE_SSE2
+// Every lane that lies outside of [lo, hi] ends up with all of its bits set
+static inline __m128i OutOfRange( __m128i v, __m128i lo, __m128i hi, size_t width ) {
+    switch( width ) {
+        case 1:
+            return _mm_or_si128( _mm_cmplt_epi8( v, lo ), _mm_cmpgt_epi8( v, hi ) );
+        case 2:
+            return _mm_or_si128( _mm_cmplt_epi16( v, lo ), _mm_cmpgt_epi16( v, hi ) );
+    }
+    return _mm_or_si128( _mm_cmplt_epi32( v, lo ), _mm_cmpgt_epi32( v, hi ) );
+}
+#endif
+
+// Checks every properly aligned value within a buffer holding a copy of the memory at "base"
+size_t MemoryScan::ScanBuffer( const uint8_t* buf, size_t size, uintptr_t base, std::vector< uintptr_t > &out ) const {
+    size_t numFound = out.size();
+    size_t i = 0;
+#ifdef SCAN_USE_SSE2
+    // Keeps a single movemask bit per lane
+    unsigned int lanes = ( this->width == 1 ) ? 0xFFFF : ( ( this->width == 2 ) ? 0x5555 : 0x1111 );
+
+    unsigned int mask;
+    if( this->type == ScanType_Float ) {
+        __m128 lo = _mm_set1_ps( this->m_LowerFloat );
+        __m128 hi = _mm_set1_ps( this->m_UpperFloat );
+        for( ; i + 16 <= size; i += 16 ) {
+            __m128 v = _mm_loadu_ps( reinterpret_cast< const float* >( buf + i ) );
+
+            mask = static_cast< unsigned int >( _mm_movemask_ps( _mm_and_ps( _mm_cmpge_ps( v, lo ), _mm_cmple_ps( v, hi ) ) ) );
+            while( mask ) {
+                out.emplace_back( base + i + LowestBitIndex( mask ) * sizeof( float ) );
+
+                mask &= mask - 1;
+            }
+        }
+    } else {
+        // Unsigned lanes get biased so that signed comparisons order them correctly
+        __m128i bias, lo, hi;
+        switch( this->width ) {
+            case 1:
+                bias = _mm_set1_epi8( static_cast< char >( 0x80 ) );
+                lo = _mm_set1_epi8( static_cast< char >( this->m_Lower - 0x80 ) );
+                hi = _mm_set1_epi8( static_cast< char >( this->m_Upper - 0x80 ) );
+                break;
+            case 2:
+                bias = _mm_set1_epi16( static_cast< short >( 0x8000 ) );
+                lo = _mm_set1_epi16( static_cast< short >( this->m_Lower - 0x8000 ) );
+                hi = _mm_set1_epi16( static_cast< short >( this->m_Upper - 0x8000 ) );
+                break;
+            default:
+                bias = _mm_setzero_si128();
+                lo = _mm_set1_epi32( static_cast< int >( this->m_Lower ) );
+                hi = _mm_set1_epi32( static_cast< int >( this->m_Upper ) );
+                break;
+        }
+
+        for( ; i + 16 <= size; i += 16 ) {
+            __m128i v = _mm_xor_si128( _mm_loadu_si128( reinterpret_cast< const __m128i* >( buf + i ) ), bias );
+
+            mask = ~static_cast< unsigned int >( _mm_movemask_epi8( OutOfRange( v, lo, hi, this->width ) ) ) & lanes;
+            while( mask ) {
+                out.emplace_back( base + i + LowestBitIndex( mask ) );
+
+                mask &= mask - 1;
+            }
+        }
+    }
+#endif
+    for( ; i + this->width <= size; i += this->width ) {
+        if( this->Matches( buf + i ) )
+            out.emplace_back( base + i );
+    }
+    return out.size() - numFound;
+}
+
+void MemoryScan::AddRange( uintptr_t start, size_t size ) {
+    while( size ) {
+        size_t chunk = std::min( size, SCAN_CHUNK_SIZE );
+        this->m_Chunks.push_back( { start, chunk } );
+
+        start += chunk;
+        size -= chunk;
+    }
+}
+
+// Gathers the readable regions of the process, or only the writable ones, which is where
+// values that change live. Given a module name, only the regions belonging to it are kept.
+void MemoryScan::CollectRanges( const char* module, bool writableOnly ) {
+#if defined PLATFORM_WINDOWS
+    HMODULE hModule = nullptr;
+    if( *module ) {
+        hModule = GetModuleHandleA( module );
+        if( hModule == nullptr )
+            return;
+    }
+
+    const DWORD writable = PAGE_READWRITE | PAGE_WRITECOPY | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE_WRITECOPY;
+    const DWORD wanted = writableOnly ? writable : ( writable | PAGE_READONLY | PAGE_EXECUTE_READ );
+
+    MEMORY_BASIC_INFORMATION info;
+    uintptr_t addr = 0x10000;
+    while( VirtualQuery( reinterpret_cast< void* >( addr ), &info, sizeof( MEMORY_BASIC_INFORMATION ) ) ) {
+        if( info.State == MEM_COMMIT && ( info.Protect & wanted ) && !( info.Protect & ( PAGE_GUARD | PAGE_NOACCESS ) ) ) {
+            if( hModule == nullptr || info.AllocationBase == hModule )
+                this->AddRange( reinterpret_cast< uintptr_t >( info.BaseAddress ), info.RegionSize );
+        }
+
+        uintptr_t next = reinterpret_cast< uintptr_t >( info.BaseAddress ) + info.RegionSize;
+        if( next <= addr )
+            break;
+
+        addr = next;
+    }
+#elif defined PLATFORM_LINUX
+    FILE *fp = fopen( "/proc/self/maps", "r" );
+    if( !fp )
+        return;
+
+    char line[1024];
+    char perms[8];
+    int pathPos;
+
+    uintptr_t lower, upper, lastUpper = 0;
+    bool lastMatched = false;
+
+    // Format:
+    // lower    upper    prot     stuff                 path
+    // 08048000-0804c000 rw-p 00000000 03:03 1010107    /bin/cat
+    while( fgets( line, sizeof( line ), fp ) ) {
+        pathPos = 0;
+        if( sscanf( line, "%" SCNxPTR "-%" SCNxPTR " %7s %*s %*s %*s %n", &lower, &upper, perms, &pathPos ) < 3 )
+            continue;
+
+        line[strcspn( line, "\n" )] = '\0';
+
+        bool matched = true;
+        if( *module ) {
+            const char* path = pathPos ? line + pathPos : "";
+
+            // .bss follows the file-backed data segment as an anonymous mapping
+            matched = *path ? ModuleNameMatches( path, module ) : ( lastMatched && lower == lastUpper );
+        }
+
+        lastMatched = matched;
+        lastUpper = upper;
+        if( matched && perms[0] == 'r' && ( !writableOnly || perms[1] == 'w' ) )
+            this->AddRange( lower, upper - lower );
+    }
+    fclose( fp );
+#elif defined PLATFORM_APPLE
+    vm_address_t addr = 0;
+    vm_size_t size;
+
+    vm_region_basic_info_data_64_t info;
+    mach_msg_type_number_t count;
+    memory_object_name_t obj;
+
+    Dl_info dlInfo;
+    while( true ) {
+        count = VM_REGION_BASIC_INFO_COUNT_64;
+        if( vm_region_64( mach_task_self(), &addr, &size, VM_REGION_BASIC_INFO_64, reinterpret_cast< vm_region_info_64_t >( &info ), &count, &obj ) != KERN_SUCCESS )
+            break;
+
+        vm_prot_t wanted = writableOnly ? ( VM_PROT_READ | VM_PROT_WRITE ) : VM_PROT_READ;
+        if( ( info.protection & wanted ) == wanted ) {
+            if( !*module || ( dladdr( reinterpret_cast< void* >( addr ), &dlInfo ) && dlInfo.dli_fname && ModuleNameMatches( dlInfo.dli_fname, module ) ) )
+                this->AddRange( addr, size );
+        }
+
+        addr += size;
+    }
+#endif
+}
+
+void MemoryScan::Search() {
+    std::vector< uint8_t > buf( SCAN_CHUNK_SIZE );
+    std::vector< uintptr_t > found;
+
+    size_t idx;
+    while( !this->m_Stop && ( idx = this->m_NextJob++ ) < this->m_NumJobs ) {
+        const Range &chunk = this->m_Chunks[idx];
+
+        size_t numRead = ReadMemorySafe( buf.data(), reinterpret_cast< const void* >( chunk.start ), chunk.size );
+        if( this->ScanBuffer( buf.data(), numRead, chunk.start, found ) )
+            this->Commit( found );
+    }
+}
+
+void MemoryScan::Refine() {
+    uint8_t page[SCAN_PAGE_SIZE];
+    uintptr_t pageBase = 0;
+    bool pageLoaded = false, pageValid = false;
+
+    std::vector< uintptr_t > found;
+
+    size_t idx;
+    while( !this->m_Stop && ( idx = this->m_NextJob++ ) < this->m_NumJobs ) {
+        size_t i = idx * SCAN_REFINE_BATCH;
+        size_t last = std::min( i + SCAN_REFINE_BATCH, this->results.size() );
+
+        // Results are sorted, so neighbours mostly share a page
+        for( ; i < last; i++ ) {
+            uintptr_t addr = this->results[i];
+            uintptr_t base = addr & ~( SCAN_PAGE_SIZE - 1 );
+            if( !pageLoaded || base != pageBase ) {
+                pageBase = base;
+                pageValid = ReadMemorySafe( page, reinterpret_cast< const void* >( base ), SCAN_PAGE_SIZE ) == SCAN_PAGE_SIZE;
+                pageLoaded = true;
+            }
+
+            if( pageValid && this->Matches( page + ( addr - base ) ) )
+                found.emplace_back( addr );
+        }
+
+        if( !found.empty() )
+            this->Commit( found );
+    }
+}
+
+void MemoryScan::Commit( std::vector< uintptr_t > &found ) {
+    std::lock_guard< std::mutex > lock( this->m_FoundLock );
+
+    size_t room = this->m_MaxResults - this->m_Found.size();
+    if( found.size() >= room ) {
+        found.resize( room );
+
+        this->m_Stop = true;
+    }
+
+    this->m_Found.insert( this->m_Found.end(), found.begin(), found.end() );
+    found.clear();
+}
\ No newline at end of file
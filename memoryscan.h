@@ -0,0 +1,115 @@
+/**
+ * vim: set ts=4 sw=4 tw=99 noet :
+ * =============================================================================
+ * SourceMod Source Scramble Extension
+ * 
+ * Copyright (C) 2019 nosoop
+ * Copyright (C) 2023 cravenge
+ *
+ * All rights reserved
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2", the
+ * "Source Engine", the "SourcePawn JIT" and any Game MODs that run on software
+ * by the Valve Corporation. You must obey the GNU General Public License in
+ * all respects for all other code used. Additionally, AlliedModders LLC grants
+ * this exception to all derivative works. AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>
+ *
+ * Version: $Id$
+ */
+
+#ifndef _INCLUDE_SOURCEMOD_SRCSCRMBL_MEMSCAN_H_
+#define _INCLUDE_SOURCEMOD_SRCSCRMBL_MEMSCAN_H_
+
+#include "smsdk_ext.h"
+#include "pinnedaddress.h"
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Mirrors the ScanType enumeration in srcscramble.inc
+enum ScanType {
+    ScanType_Int8,
+    ScanType_Int16,
+    ScanType_Int32,
+    ScanType_Float
+};
+
+struct MemoryScan {
+    MemoryScan( int typ );
+    ~MemoryScan();
+
+    bool Start( cell_t value, cell_t tolerance, size_t maxResults, const char* module, bool writableOnly, IPluginFunction* callback, cell_t data );
+    void Cancel();
+    void Reset();
+    bool IsBusy() const;
+
+    static void ProcessFinished( bool simulating );
+
+    int type;
+    size_t width;
+
+    Handle_t hndl;
+
+    // Sorted addresses of every match from the last finished pass. A new pass only
+    // re-checks these once it is non-empty
+    std::vector< uintptr_t > results;
+
+    // Every result address handed out so far, kept decodable until the scan is deleted
+    std::map< uintptr_t, PinnedAddress > pinned;
+private:
+    struct Range {
+        uintptr_t start;
+        size_t size;
+    };
+
+    void SetBounds( cell_t value, cell_t tolerance );
+    bool Matches( const uint8_t* ptr ) const;
+    size_t ScanBuffer( const uint8_t* buf, size_t size, uintptr_t base, std::vector< uintptr_t > &out ) const;
+
+    void AddRange( uintptr_t start, size_t size );
+    void CollectRanges( const char* module, bool writableOnly );
+    void Search();
+    void Refine();
+    void Commit( std::vector< uintptr_t > &found );
+
+    int64_t m_Lower, m_Upper;
+    float m_LowerFloat, m_UpperFloat;
+
+    std::vector< Range > m_Chunks;
+    size_t m_NumJobs;
+    std::atomic< size_t > m_NextJob;
+    bool m_Scanned;
+
+    std::vector< uintptr_t > m_Found;
+    std::mutex m_FoundLock;
+    size_t m_MaxResults;
+
+    std::vector< std::thread > m_Workers;
+    std::atomic< unsigned int > m_Running;
+    std::atomic< bool > m_Stop;
+
+    IPluginFunction* m_Callback;
+    cell_t m_Data;
+};
+
+#endif // _INCLUDE_SOURCEMOD_SRCSCRMBL_MEMSCAN_H_
\ No newline at end of file
@@ -0,0 +1,137 @@
+/**
+ * vim: set ts=4 sw=4 tw=99 noet :
+ * =============================================================================
+ * SourceMod Source Scramble Extension
+ * 
+ * Copyright (C) 2019 nosoop
+ * Copyright (C) 2023 cravenge
+ *
+ * All rights reserved
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2", the
+ * "Source Engine", the "SourcePawn JIT" and any Game MODs that run on software
+ * by the Valve Corporation. You must obey the GNU General Public License in
+ * all respects for all other code used. Additionally, AlliedModders LLC grants
+ * this exception to all derivative works. AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>
+ *
+ * Version: $Id$
+ */
+
+#include "memorysnapshot.h"
+#include "util.h"
+
+#include "string.h"
+
+#if defined __SSE2__ || defined _M_X64 || ( defined _M_IX86_FP && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+
+#define SNAPSHOT_USE_SSE2
+
+# ifdef _MSC_VER
+# include <intrin.h>
+
+# endif
+static inline unsigned int LowestBitIndex( unsigned int mask ) {
+# ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward( &index, mask );
+    return static_cast< unsigned int >( index );
+# else
+    return static_cast< unsigned int >( __builtin_ctz( mask ) );
+# endif
+}
+#endif
+
+MemorySnapshot::MemorySnapshot( void* addr, size_t sz ) : pAddr( addr ), data( sz ), m_Scratch( sz ) {
+}
+
+bool MemorySnapshot::Update() {
+    if( ReadMemorySafe( this->m_Scratch.data(), this->pAddr, this->m_Scratch.size() ) != this->m_Scratch.size() )
+        return false;
+
+    this->data.swap( this->m_Scratch );
+    return true;
+}
+
+// Collects the runs of consecutive bytes that differ between the snapshot and the live
+// memory. Only the first maxRuns runs are written out but all of them are counted.
+bool MemorySnapshot::Diff( uint32_t* offsets, uint32_t* lengths, size_t maxRuns, size_t &numRuns ) const {
+    auto prev = this->data.data();
+    auto live = reinterpret_cast< const uint8_t* >( this->pAddr );
+    size_t sz = this->data.size();
+
+    // The live memory is read a chunk at a time so a range that went away fails instead of faulting
+    uint8_t chunk[4096];
+
+    size_t runStart = 0;
+    bool inRun = false;
+
+    numRuns = 0;
+
+    auto toggle = [&]( size_t pos ) {
+        if( !inRun ) {
+            runStart = pos;
+            inRun = true;
+            return;
+        }
+
+        if( numRuns < maxRuns ) {
+            offsets[numRuns] = static_cast< uint32_t >( runStart );
+            lengths[numRuns] = static_cast< uint32_t >( pos - runStart );
+        }
+
+        numRuns++;
+        inRun = false;
+    };
+
+    for( size_t base = 0; base < sz; base += sizeof( chunk ) ) {
+        size_t len = sz - base < sizeof( chunk ) ? sz - base : sizeof( chunk );
+        if( ReadMemorySafe( chunk, live + base, len ) != len )
+            return false;
+
+        size_t i = base, end = base + len;
+#ifdef SNAPSHOT_USE_SSE2
+        while( i + 16 <= end ) {
+            __m128i eq = _mm_cmpeq_epi8( _mm_loadu_si128( reinterpret_cast< const __m128i* >( prev + i ) ),
+                                         _mm_loadu_si128( reinterpret_cast< const __m128i* >( chunk + i - base ) ) );
+
+            // One bit per changed byte; a set bit in "edges" marks where a run starts or ends
+            unsigned int changed = ~static_cast< unsigned int >( _mm_movemask_epi8( eq ) ) & 0xFFFF;
+            unsigned int edges = ( changed ^ ( ( changed << 1 ) | ( inRun ? 1 : 0 ) ) ) & 0xFFFF;
+            while( edges ) {
+                toggle( i + LowestBitIndex( edges ) );
+
+                edges &= edges - 1;
+            }
+
+            i += 16;
+        }
+#endif
+        while( i < end ) {
+            if( ( prev[i] != chunk[i - base] ) != inRun )
+                toggle( i );
+
+            i++;
+        }
+    }
+
+    if( inRun )
+        toggle( sz );
+    return true;
+}
\ No newline at end of file
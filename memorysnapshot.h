@@ -0,0 +1,69 @@
+/**
+ * vim: set ts=4 sw=4 tw=99 noet :
+ * =============================================================================
+ * SourceMod Source Scramble Extension
+ * 
+ * Copyright (C) 2019 nosoop
+ * Copyright (C) 2023 cravenge
+ *
+ * All rights reserved
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2", the
+ * "Source Engine", the "SourcePawn JIT" and any Game MODs that run on software
+ * by the Valve Corporation. You must obey the GNU General Public License in
+ * all respects for all other code used. Additionally, AlliedModders LLC grants
+ * this exception to all derivative works. AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>
+ *
+ * Version: $Id$
+ */
+
+#ifndef _INCLUDE_SOURCEMOD_SRCSCRMBL_MEMSNAPSHOT_H_
+#define _INCLUDE_SOURCEMOD_SRCSCRMBL_MEMSNAPSHOT_H_
+
+# ifndef _STDLIB_H_
+# include <stdlib.h>
+
+# endif
+# ifndef _STDINT_H
+# include "stdint.h"
+
+# endif
+#include "pinnedaddress.h"
+
+#include <vector>
+
+struct MemorySnapshot {
+    MemorySnapshot( void* addr, size_t sz );
+
+    // Both return false, leaving the snapshot as it was, if part of the range cannot be read
+    bool Update();
+    bool Diff( uint32_t* offsets, uint32_t* lengths, size_t maxRuns, size_t &numRuns ) const;
+
+    void* pAddr;
+    PinnedAddress pinned;
+
+    // Bytes of the range as they were when Update() was last called
+    std::vector< uint8_t > data;
+private:
+    // Update() reads into this and swaps it with "data", so a failed read leaves "data" alone
+    // without allocating on every call
+    std::vector< uint8_t > m_Scratch;
+};
+
+#endif // _INCLUDE_SOURCEMOD_SRCSCRMBL_MEMSNAPSHOT_H_
\ No newline at end of file
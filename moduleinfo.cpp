@@ -0,0 +1,391 @@
+/**
+ * vim: set ts=4 sw=4 tw=99 noet :
+ * =============================================================================
+ * SourceMod Source Scramble Extension
+ * 
+ * Copyright (C) 2019 nosoop
+ * Copyright (C) 2023 cravenge
+ *
+ * All rights reserved
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2", the
+ * "Source Engine", the "SourcePawn JIT" and any Game MODs that run on software
+ * by the Valve Corporation. You must obey the GNU General Public License in
+ * all respects for all other code used. Additionally, AlliedModders LLC grants
+ * this exception to all derivative works. AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>
+ *
+ * Version: $Id$
+ */
+
+#include <sm_platform.h>
+
+#include "moduleinfo.h"
+
+#include "stddef.h"
+#include "string.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#if defined PLATFORM_WINDOWS
+#include <windows.h>
+
+#elif defined PLATFORM_LINUX
+#include <dlfcn.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <link.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#elif defined PLATFORM_APPLE
+#include <dlfcn.h>
+#include <mach-o/dyld.h>
+
+#endif
+
+bool ModuleNameMatches( const char* path, const char* name ) {
+    const char* file = strrchr( path, '/' );
+    file = file ? file + 1 : path;
+
+    size_t len = strlen( name );
+    return !strncmp( file, name, len ) && ( file[len] == '\0' || file[len] == '.' );
+}
+
+#if defined PLATFORM_LINUX
+struct ModuleSearch {
+    const char* name;
+
+    std::string path;
+    uintptr_t bias;
+    uintptr_t lower;
+    uintptr_t upper;
+};
+
+static int FindModuleCallback( struct dl_phdr_info* info, size_t size, void* data ) {
+    ModuleSearch* search = static_cast< ModuleSearch* >( data );
+
+    // The main executable is reported without a name
+    std::string path;
+    if( info->dlpi_name && *info->dlpi_name ) {
+        path = info->dlpi_name;
+    } else {
+        static std::string exePath;
+        if( exePath.empty() ) {
+            char exe[PATH_MAX];
+            ssize_t len = readlink( "/proc/self/exe", exe, sizeof( exe ) - 1 );
+            if( len <= 0 )
+                return 0;
+
+            exePath.assign( exe, len );
+        }
+        path = exePath;
+    }
+
+    if( !ModuleNameMatches( path.c_str(), search->name ) )
+        return 0;
+
+    uintptr_t lower = UINTPTR_MAX, upper = 0;
+    for( ElfW(Half) i = 0; i < info->dlpi_phnum; i++ ) {
+        const ElfW(Phdr) &phdr = info->dlpi_phdr[i];
+        if( phdr.p_type != PT_LOAD )
+            continue;
+
+        if( phdr.p_vaddr < lower )
+            lower = phdr.p_vaddr;
+        if( phdr.p_vaddr + phdr.p_memsz > upper )
+            upper = phdr.p_vaddr + phdr.p_memsz;
+    }
+
+    if( upper <= lower )
+        return 0;
+
+    search->path = std::move( path );
+    search->bias = info->dlpi_addr;
+    search->lower = info->dlpi_addr + lower;
+    search->upper = info->dlpi_addr + upper;
+    return 1;
+}
+
+// Only looks at the first object, which is enough to read how many objects have been
+// unloaded so far
+static int GetUnloadCountCallback( struct dl_phdr_info* info, size_t size, void* data ) {
+    unsigned long long* subs = static_cast< unsigned long long* >( data );
+    if( size >= offsetof( struct dl_phdr_info, dlpi_subs ) + sizeof( info->dlpi_subs ) )
+        *subs = info->dlpi_subs;
+    return 1;
+}
+
+// Modules found by name are remembered until any object is unloaded, since that is the
+// only way their load address could change
+static bool FindModuleCached( const char* name, ModuleSearch &search ) {
+    static std::unordered_map< std::string, ModuleSearch > s_Modules;
+    static unsigned long long s_Unloads = 0;
+
+    unsigned long long subs = ~0ULL;
+    dl_iterate_phdr( GetUnloadCountCallback, &subs );
+    if( subs != s_Unloads || subs == ~0ULL ) {
+        s_Modules.clear();
+        s_Unloads = subs;
+    }
+
+    auto it = s_Modules.find( name );
+    if( it != s_Modules.end() ) {
+        search = it->second;
+        return true;
+    }
+
+    search.name = name;
+    if( !dl_iterate_phdr( FindModuleCallback, &search ) )
+        return false;
+
+    search.name = nullptr;
+    s_Modules[name] = search;
+    return true;
+}
+
+// Symbol tables are keyed by path and hold unrelocated values, so they stay valid even
+// if a module is loaded again somewhere else
+static std::unordered_map< std::string, std::unique_ptr< SymbolTable > > s_SymbolTables;
+
+#endif
+bool ModuleInfo::Find( const char* name, uintptr_t &base, size_t &size ) {
+#if defined PLATFORM_WINDOWS
+    HMODULE hModule = GetModuleHandleA( name );
+    if( hModule == nullptr )
+        return false;
+
+    const IMAGE_DOS_HEADER* dos = reinterpret_cast< const IMAGE_DOS_HEADER* >( hModule );
+    const IMAGE_NT_HEADERS* nt = reinterpret_cast< const IMAGE_NT_HEADERS* >( reinterpret_cast< const uint8_t* >( hModule ) + dos->e_lfanew );
+
+    base = reinterpret_cast< uintptr_t >( hModule );
+    size = nt->OptionalHeader.SizeOfImage;
+    return true;
+#elif defined PLATFORM_LINUX
+    ModuleSearch search;
+    if( !FindModuleCached( name, search ) )
+        return false;
+
+    base = search.lower;
+    size = search.upper - search.lower;
+    return true;
+#elif defined PLATFORM_APPLE
+    for( uint32_t i = 0; i < _dyld_image_count(); i++ ) {
+        const char* path = _dyld_get_image_name( i );
+        if( path == nullptr || !ModuleNameMatches( path, name ) )
+            continue;
+
+        const struct mach_header* header = _dyld_get_image_header( i );
+        const uint8_t* cmd = reinterpret_cast< const uint8_t* >( header ) + ( header->magic == MH_MAGIC_64 ? sizeof( struct mach_header_64 ) : sizeof( struct mach_header ) );
+
+        uint64_t lower = UINT64_MAX, upper = 0;
+        for( uint32_t j = 0; j < header->ncmds; j++ ) {
+            const struct load_command* lc = reinterpret_cast< const struct load_command* >( cmd );
+            if( lc->cmd == LC_SEGMENT_64 ) {
+                const struct segment_command_64* seg = reinterpret_cast< const struct segment_command_64* >( lc );
+                if( seg->vmsize && strcmp( seg->segname, SEG_PAGEZERO ) ) {
+                    lower = std::min< uint64_t >( lower, seg->vmaddr );
+                    upper = std::max< uint64_t >( upper, seg->vmaddr + seg->vmsize );
+                }
+            } else if( lc->cmd == LC_SEGMENT ) {
+                const struct segment_command* seg = reinterpret_cast< const struct segment_command* >( lc );
+                if( seg->vmsize && strcmp( seg->segname, SEG_PAGEZERO ) ) {
+                    lower = std::min< uint64_t >( lower, seg->vmaddr );
+                    upper = std::max< uint64_t >( upper, seg->vmaddr + seg->vmsize );
+                }
+            }
+            cmd += lc->cmdsize;
+        }
+
+        if( upper <= lower )
+            return false;
+
+        base = static_cast< uintptr_t >( lower + _dyld_get_image_vmaddr_slide( i ) );
+        size = static_cast< size_t >( upper - lower );
+        return true;
+    }
+    return false;
+#else
+    return false;
+#endif
+}
+
+void* ModuleInfo::FindSymbol( const char* module, const char* symbol ) {
+#if defined PLATFORM_WINDOWS
+    HMODULE hModule = GetModuleHandleA( module );
+    if( hModule == nullptr )
+        return nullptr;
+
+    return reinterpret_cast< void* >( GetProcAddress( hModule, symbol ) );
+#elif defined PLATFORM_LINUX
+    ModuleSearch search;
+    if( !FindModuleCached( module, search ) )
+        return nullptr;
+
+    // Files that cannot be read are remembered as empty tables
+    std::unique_ptr< SymbolTable > &table = s_SymbolTables[search.path];
+    if( !table ) {
+        table.reset( new SymbolTable );
+        table->Load( search.path.c_str() );
+    }
+
+    uintptr_t value;
+    if( !table->Lookup( symbol, value ) )
+        return nullptr;
+
+    return reinterpret_cast< void* >( search.bias + value );
+#elif defined PLATFORM_APPLE
+    for( uint32_t i = 0; i < _dyld_image_count(); i++ ) {
+        const char* path = _dyld_get_image_name( i );
+        if( path == nullptr || !ModuleNameMatches( path, module ) )
+            continue;
+
+        void* handle = dlopen( path, RTLD_LAZY | RTLD_NOLOAD );
+        if( handle == nullptr )
+            return nullptr;
+
+        // dlsym expects the name without the leading underscore of Mach-O symbols
+        void* addr = dlsym( handle, *symbol == '_' ? symbol + 1 : symbol );
+        dlclose( handle );
+        return addr;
+    }
+    return nullptr;
+#else
+    return nullptr;
+#endif
+}
+
+// Same function as the one used by .gnu.hash sections
+uint32_t SymbolTable::Hash( const char* name ) {
+    uint32_t h = 5381;
+    for( const uint8_t* c = reinterpret_cast< const uint8_t* >( name ); *c; c++ ) {
+        h = h * 33 + *c;
+    }
+    return h;
+}
+
+bool SymbolTable::Load( const char* path ) {
+#if defined PLATFORM_LINUX
+    int fd = open( path, O_RDONLY );
+    if( fd == -1 )
+        return false;
+
+    struct stat st;
+    if( fstat( fd, &st ) == -1 || static_cast< size_t >( st.st_size ) < sizeof( ElfW(Ehdr) ) ) {
+        close( fd );
+        return false;
+    }
+
+    size_t fileSize = static_cast< size_t >( st.st_size );
+    void* map = mmap( nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if( map == MAP_FAILED )
+        return false;
+
+    const uint8_t* file = static_cast< const uint8_t* >( map );
+    const ElfW(Ehdr)* ehdr = reinterpret_cast< const ElfW(Ehdr)* >( file );
+
+    bool valid = !memcmp( ehdr->e_ident, ELFMAG, SELFMAG ) && ehdr->e_ident[EI_CLASS] == ( sizeof( void* ) == 8 ? ELFCLASS64 : ELFCLASS32 )
+                 && ehdr->e_shentsize == sizeof( ElfW(Shdr) ) && ehdr->e_shoff && ehdr->e_shoff <= fileSize
+                 && ehdr->e_shnum <= ( fileSize - ehdr->e_shoff ) / sizeof( ElfW(Shdr) );
+    if( !valid ) {
+        munmap( map, fileSize );
+        return false;
+    }
+
+    const ElfW(Shdr)* shdrs = reinterpret_cast< const ElfW(Shdr)* >( file + ehdr->e_shoff );
+
+    std::vector< Symbol > symbols;
+    for( ElfW(Half) i = 0; i < ehdr->e_shnum; i++ ) {
+        const ElfW(Shdr) &symSec = shdrs[i];
+        if( ( symSec.sh_type != SHT_SYMTAB && symSec.sh_type != SHT_DYNSYM ) || symSec.sh_entsize != sizeof( ElfW(Sym) ) || symSec.sh_link >= ehdr->e_shnum )
+            continue;
+
+        const ElfW(Shdr) &strSec = shdrs[symSec.sh_link];
+        if( symSec.sh_offset > fileSize || symSec.sh_size > fileSize - symSec.sh_offset
+            || strSec.sh_offset > fileSize || strSec.sh_size > fileSize - strSec.sh_offset )
+            continue;
+
+        const ElfW(Sym)* syms = reinterpret_cast< const ElfW(Sym)* >( file + symSec.sh_offset );
+        const char* strs = reinterpret_cast< const char* >( file + strSec.sh_offset );
+
+        size_t count = symSec.sh_size / sizeof( ElfW(Sym) );
+        for( size_t j = 0; j < count; j++ ) {
+            const ElfW(Sym) &sym = syms[j];
+
+            int type = ELF64_ST_TYPE( sym.st_info );
+            if( ( type != STT_FUNC && type != STT_OBJECT ) || sym.st_shndx == SHN_UNDEF || !sym.st_name || sym.st_name >= strSec.sh_size )
+                continue;
+
+            const char* name = strs + sym.st_name;
+            size_t len = strnlen( name, strSec.sh_size - sym.st_name );
+            if( len == strSec.sh_size - sym.st_name )
+                continue;
+
+            symbols.push_back( { Hash( name ), static_cast< uint32_t >( this->m_Names.size() ), static_cast< uintptr_t >( sym.st_value ) } );
+            this->m_Names.insert( this->m_Names.end(), name, name + len + 1 );
+        }
+    }
+
+    munmap( map, fileSize );
+
+    size_t numBuckets = 1;
+    while( numBuckets < symbols.size() ) {
+        numBuckets <<= 1;
+    }
+
+    // Counting sort by bucket; m_Buckets[b] to m_Buckets[b + 1] is the range of bucket b
+    this->m_Buckets.assign( numBuckets + 1, 0 );
+    for( const Symbol &sym : symbols ) {
+        this->m_Buckets[( sym.hash & ( numBuckets - 1 ) ) + 1]++;
+    }
+    for( size_t b = 0; b < numBuckets; b++ ) {
+        this->m_Buckets[b + 1] += this->m_Buckets[b];
+    }
+
+    std::vector< uint32_t > next( this->m_Buckets.begin(), this->m_Buckets.end() - 1 );
+    this->m_Symbols.resize( symbols.size() );
+    for( const Symbol &sym : symbols ) {
+        this->m_Symbols[next[sym.hash & ( numBuckets - 1 )]++] = sym;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool SymbolTable::Lookup( const char* name, uintptr_t &value ) const {
+    if( this->m_Buckets.empty() )
+        return false;
+
+    uint32_t hash = Hash( name );
+    size_t bucket = hash & ( this->m_Buckets.size() - 2 );
+    for( uint32_t i = this->m_Buckets[bucket]; i < this->m_Buckets[bucket + 1]; i++ ) {
+        const Symbol &sym = this->m_Symbols[i];
+        if( sym.hash == hash && !strcmp( &this->m_Names[sym.name], name ) ) {
+            value = sym.value;
+            return true;
+        }
+    }
+    return false;
+}
\ No newline at end of file
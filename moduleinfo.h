@@ -0,0 +1,85 @@
+/**
+ * vim: set ts=4 sw=4 tw=99 noet :
+ * =============================================================================
+ * SourceMod Source Scramble Extension
+ * 
+ * Copyright (C) 2019 nosoop
+ * Copyright (C) 2023 cravenge
+ *
+ * All rights reserved
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2", the
+ * "Source Engine", the "SourcePawn JIT" and any Game MODs that run on software
+ * by the Valve Corporation. You must obey the GNU General Public License in
+ * all respects for all other code used. Additionally, AlliedModders LLC grants
+ * this exception to all derivative works. AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>
+ *
+ * Version: $Id$
+ */
+
+#ifndef _INCLUDE_SOURCEMOD_SRCSCRMBL_MODULEINFO_H_
+#define _INCLUDE_SOURCEMOD_SRCSCRMBL_MODULEINFO_H_
+
+# ifndef _STDLIB_H_
+# include <stdlib.h>
+
+# endif
+# ifndef _STDINT_H
+# include "stdint.h"
+
+# endif
+#include <vector>
+
+// Compares against the whole file name, with or without its extension, so "server" finds
+// "server.so" but neither "server_srv.so" nor "libserver.so". This is the same rule
+// GetModuleHandleA() follows on Windows, where ".dll" is assumed if no extension is given
+bool ModuleNameMatches( const char* path, const char* name );
+
+struct ModuleInfo {
+    // Finds a loaded module by its exact file name or the name before its extension
+    // (i.e "server" for "server.so"), following ModuleNameMatches()
+    static bool Find( const char* name, uintptr_t &base, size_t &size );
+
+    // Resolves a mangled symbol name in a module. On Linux, the symbol tables of the
+    // file on disk are read once and indexed, so non-exported symbols are found too;
+    // elsewhere only exported symbols can be resolved
+    static void* FindSymbol( const char* module, const char* symbol );
+};
+
+// Symbols of an ELF file, grouped by GNU hash bucket like .gnu.hash so that a lookup only
+// compares the names of symbols whose full hash matches
+class SymbolTable {
+public:
+    bool Load( const char* path );
+    bool Lookup( const char* name, uintptr_t &value ) const;
+
+    static uint32_t Hash( const char* name );
+private:
+    struct Symbol {
+        uint32_t hash;
+        uint32_t name;
+        uintptr_t value;
+    };
+
+    std::vector< uint32_t > m_Buckets;
+    std::vector< Symbol > m_Symbols;
+    std::vector< char > m_Names;
+};
+
+#endif // _INCLUDE_SOURCEMOD_SRCSCRMBL_MODULEINFO_H_
\ No newline at end of file
@@ -34,7 +34,12 @@
  */
 
 #include "extension.h"
+#include "moduleinfo.h"
+#include "patchparams.h"
 #include "util.h"
+#include "x86insn.h"
+
+#include <algorithm>
 
 #ifdef PLATFORM_X64
 # ifdef PLATFORM_LINUX
@@ -105,26 +110,30 @@ cell_t GetMemoryBlockAddress(IPluginContext* pContext, const cell_t* params)
         return pContext->ThrowNativeError("Invalid Handle %x (error %d)", hndl, err);
 
 #ifdef PLATFORM_X64
-    return static_cast< cell_t >( pseudoAddr.ToPseudoAddress( pMemoryBlock->pBlock ) );
+    return static_cast< cell_t >( pMemoryBlock->paddr );
 #else
     return static_cast< cell_t >( reinterpret_cast< uintptr_t >( pMemoryBlock->pBlock ) );
 #endif
 }
 
-cell_t CreateMemoryPatch(IPluginContext* pContext, const cell_t* params)
+// Shared by CreateMemoryPatch and CreateMemoryPatch64, which only differ in how the
+// address in params[1] is passed
+static const char* GetPluginName( IPluginContext* pContext ) {
+    IPlugin* pPlugin = plsys->FindPluginByContext(pContext->GetContext());
+    return pPlugin != nullptr ? pPlugin->GetFilename() : "unknown";
+}
+
+static cell_t CreateMemoryPatchAt( IPluginContext* pContext, const cell_t* params, void* addr )
 {
-#ifdef PLATFORM_X64
-    void* addr = pseudoAddr.FromPseudoAddress( static_cast< uintptr_t >( params[1] ) );
-#else
-    void* addr = reinterpret_cast< void* >( params[1] );
-#endif
     if( addr == nullptr )
         return pContext->ThrowNativeError("Address cannot be null");
 
     char* bytes;
     pContext->LocalToString(params[2], &bytes);
 
-    std::vector mtchVec = EscapedHexToByteVector( bytes );
+    std::vector< uint8_t > mtchVec, maskVec;
+    if( !ParseMatchPattern( bytes, mtchVec, maskVec ) )
+        return pContext->ThrowNativeError("Invalid match pattern \"%s\"", bytes);
 
     pContext->LocalToString(params[3], &bytes);
 
@@ -132,22 +141,43 @@ cell_t CreateMemoryPatch(IPluginContext* pContext, const cell_t* params)
 
     pContext->LocalToString(params[4], &bytes);
 
-    std::vector ovrVec = EscapedHexToByteVector( bytes );
+    std::vector< uint8_t > ovrVec;
+    std::vector< PatchParam > paramVec;
+    if( !CompileOverwriteTemplate( bytes, ovrVec, paramVec ) )
+        return pContext->ThrowNativeError("Invalid overwrite template \"%s\"", bytes);
 
     bool once = false;
     if( params[0] == 5 )
         once = static_cast< bool >( params[5] );
 
-    MemoryPatch* pMemoryPatch = new MemoryPatch( addr, std::move( mtchVec ), std::move( presvVec ), std::move( ovrVec ), once );
+    MemoryPatch* pMemoryPatch = new MemoryPatch( addr, mtchVec, maskVec, presvVec, ovrVec, once );
     if( pMemoryPatch == nullptr )
         return 0;
 
+    pMemoryPatch->params = std::move( paramVec );
+
+    pMemoryPatch->owner = GetPluginName( pContext );
+
     Handle_t hndl = handlesys->CreateHandle(g_MemoryPatch, pMemoryPatch, pContext->GetIdentity(), myself->GetIdentity(), nullptr);
-    if( !hndl )
+    if( !hndl ) {
         delete pMemoryPatch;
+        return 0;
+    }
+
+    pMemoryPatch->hndl = hndl;
     return static_cast< cell_t >( hndl );
 }
 
+cell_t CreateMemoryPatch(IPluginContext* pContext, const cell_t* params)
+{
+#ifdef PLATFORM_X64
+    void* addr = pseudoAddr.FromPseudoAddress( static_cast< uintptr_t >( params[1] ) );
+#else
+    void* addr = reinterpret_cast< void* >( params[1] );
+#endif
+    return CreateMemoryPatchAt( pContext, params, addr );
+}
+
 cell_t CreateMemoryPatchFromConf(IPluginContext* pContext, const cell_t* params)
 {
     Handle_t hndl = static_cast< Handle_t >( params[1] );
@@ -173,13 +203,72 @@ cell_t CreateMemoryPatchFromConf(IPluginContext* pContext, const cell_t* params)
     else if( !gc->GetMemSig(patConf.signatureName.c_str(), reinterpret_cast< void** >( &addr )) || addr == nullptr )
         return pContext->ThrowNativeError("Sigscan for \"%s\" from \"%s\" failed", patConf.signatureName.c_str(), key);
 
-    MemoryPatch* pMemoryPatch = new MemoryPatch( addr, patConf );
-    if( pMemoryPatch == nullptr )
-        return 0;
+    MemoryPatch* pMemoryPatch = nullptr;
+
+    int variant = patConf.SelectVariant( addr );
+    if( variant < 0 && !patConf.variants.empty() ) {
+        std::string tried;
+        for( const PatchGameConfig::PatchVariant &other : patConf.variants ) {
+            if( !tried.empty() )
+                tried += ", ";
+            tried += "\"" + other.name + "\"";
+        }
+
+        if( !patConf.search )
+            return pContext->ThrowNativeError("None of the variants of \"%s\" match at their offset (tried %s)", key, tried.c_str());
+
+        // Each variant is looked for around its own offset in turn, and the first one found exactly once is taken
+        for( size_t i = 0; i < patConf.variants.size() && pMemoryPatch == nullptr; i++ ) {
+            MemoryPatch* pCandidate = new MemoryPatch( addr, patConf, static_cast< int >( i ) );
+
+            intptr_t expected = reinterpret_cast< intptr_t >( pCandidate->pAddr );
+            if( pCandidate->Relocate( addr, patConf.search ) != 1 ) {
+                delete pCandidate;
+                continue;
+            }
+
+            intptr_t ofst = reinterpret_cast< intptr_t >( pCandidate->pAddr ) - reinterpret_cast< intptr_t >( addr );
+            smutils->LogMessage(myself, "\"%s\" matches none of its variants at their offset (tried %s); variant \"%s\" matched %d byte(s) away from its offset, update it to %d (0x%X)", key, tried.c_str(), pCandidate->variantName.c_str(), static_cast< int >( reinterpret_cast< intptr_t >( pCandidate->pAddr ) - expected ), static_cast< int >( ofst ), static_cast< unsigned int >( ofst ));
+            pMemoryPatch = pCandidate;
+        }
+
+        if( pMemoryPatch == nullptr )
+            return pContext->ThrowNativeError("None of the variants of \"%s\" match exactly once within %d byte(s) of their offset (tried %s)", key, patConf.search, tried.c_str());
+    } else {
+        pMemoryPatch = new MemoryPatch( addr, patConf, variant );
+    }
+
+    // A build that shifted the code a little is still patched, and the new offset logged so the gamedata can catch up
+    if( patConf.search && !pMemoryPatch->Matches() ) {
+        intptr_t expected = reinterpret_cast< intptr_t >( pMemoryPatch->pAddr );
+        size_t found = pMemoryPatch->Relocate( addr, patConf.search );
+        if( found == 1 ) {
+            intptr_t ofst = reinterpret_cast< intptr_t >( pMemoryPatch->pAddr ) - reinterpret_cast< intptr_t >( addr );
+            smutils->LogMessage(myself, "\"%s\" matched %d byte(s) away from its offset, update it to %d (0x%X)", key, static_cast< int >( reinterpret_cast< intptr_t >( pMemoryPatch->pAddr ) - expected ), static_cast< int >( ofst ), static_cast< unsigned int >( ofst ));
+        } else {
+            smutils->LogError(myself, "\"%s\" matches %s within %d byte(s) of its offset", key, found ? "more than once" : "nowhere", patConf.search);
+        }
+    }
+
+    if( !patConf.cave.empty() && !pMemoryPatch->PrepareCave() ) {
+        delete pMemoryPatch;
+        return pContext->ThrowNativeError("Unable to decode the instructions a jump to the cave of \"%s\" would replace", key);
+    }
+
+    if( patConf.nopFill && !pMemoryPatch->PadWithNops( patConf.nopFill ) ) {
+        delete pMemoryPatch;
+        return pContext->ThrowNativeError("Unable to pad \"%s\" with NOPs through %d instruction(s)", key, patConf.nopFill);
+    }
+
+    pMemoryPatch->owner = GetPluginName( pContext );
 
     hndl = handlesys->CreateHandle(g_MemoryPatch, pMemoryPatch, pContext->GetIdentity(), myself->GetIdentity(), nullptr);
-    if( !hndl )
+    if( !hndl ) {
         delete pMemoryPatch;
+        return 0;
+    }
+
+    pMemoryPatch->hndl = hndl;
     return static_cast< cell_t >( hndl );
 }
 
@@ -199,7 +288,11 @@ cell_t ValidateMemoryPatch(IPluginContext* pContext, const cell_t* params)
           != HandleError_None )
         return pContext->ThrowNativeError("Invalid Handle %x (error %d)", hndl, err);
 
-    bool ret = pMemoryPatch->Validate();
+    bool boundary = false;
+    if( params[0] >= 2 )
+        boundary = static_cast< bool >( params[2] );
+
+    bool ret = pMemoryPatch->Validate( boundary );
     if( !ret )
         handlesys->FreeHandle(hndl, &sec);
     return static_cast< cell_t >( ret );
@@ -224,6 +317,49 @@ cell_t IsOneTimeMemoryPatch(IPluginContext* pContext, const cell_t* params)
     return static_cast< cell_t >( pMemoryPatch->onetime );
 }
 
+cell_t GetMemoryPatchOverlap(IPluginContext* pContext, const cell_t* params)
+{
+    Handle_t hndl = static_cast< Handle_t >( params[1] );
+
+    HandleError err;
+    HandleSecurity sec;
+
+    sec.pOwner = pContext->GetIdentity();
+    sec.pIdentity = myself->GetIdentity();
+
+    MemoryPatch* pMemoryPatch;
+
+    if( ( err = handlesys->ReadHandle(hndl, g_MemoryPatch, &sec, reinterpret_cast< void** >( &pMemoryPatch )) )
+          != HandleError_None )
+        return pContext->ThrowNativeError("Invalid Handle %x (error %d)", hndl, err);
+
+    return static_cast< cell_t >( pMemoryPatch->overlap );
+}
+
+cell_t SetMemoryPatchOverlap(IPluginContext* pContext, const cell_t* params)
+{
+    Handle_t hndl = static_cast< Handle_t >( params[1] );
+
+    HandleError err;
+    HandleSecurity sec;
+
+    sec.pOwner = pContext->GetIdentity();
+    sec.pIdentity = myself->GetIdentity();
+
+    MemoryPatch* pMemoryPatch;
+
+    if( ( err = handlesys->ReadHandle(hndl, g_MemoryPatch, &sec, reinterpret_cast< void** >( &pMemoryPatch )) )
+          != HandleError_None )
+        return pContext->ThrowNativeError("Invalid Handle %x (error %d)", hndl, err);
+
+    cell_t policy = params[2];
+    if( policy != PatchOverlap_Stack && policy != PatchOverlap_Reject )
+        return pContext->ThrowNativeError("Invalid overlap policy %d", policy);
+
+    pMemoryPatch->overlap = policy;
+    return 0;
+}
+
 cell_t EnableMemoryPatch(IPluginContext* pContext, const cell_t* params)
 {
     Handle_t hndl = static_cast< Handle_t >( params[1] );
@@ -241,10 +377,13 @@ cell_t EnableMemoryPatch(IPluginContext* pContext, const cell_t* params)
         return pContext->ThrowNativeError("Invalid Handle %x (error %d)", hndl, err);
     } else if( reinterpret_cast< uintptr_t >( pMemoryPatch->pAddr ) < 0x10000 ) {
         return pContext->ThrowNativeError("Invalid address 0x%x is pointing to reserved memory", pMemoryPatch->pAddr);
-    } else if( !pMemoryPatch->overwrite.size() ) {
+    } else if( !pMemoryPatch->bytes.Size( PatchField_Overwrite ) ) {
         return pContext->ThrowNativeError("Not even a single byte is provided for patching");
     }
 
+    // An immediate call overrides whatever was queued before it
+    g_PatchQueue.Cancel( pMemoryPatch );
+
     bool ret = pMemoryPatch->Enable();
 
     if( pMemoryPatch->onetime )
@@ -268,9 +407,48 @@ cell_t DisableMemoryPatch(IPluginContext* pContext, const cell_t* params)
           != HandleError_None )
         return pContext->ThrowNativeError("Invalid Handle %x (error %d)", hndl, err);
 
+    g_PatchQueue.Cancel( pMemoryPatch );
+
     return static_cast< cell_t >( pMemoryPatch->Disable() );
 }
 
+cell_t QueueMemoryPatch(IPluginContext* pContext, const cell_t* params)
+{
+    Handle_t hndl = static_cast< Handle_t >( params[1] );
+
+    HandleError err;
+    HandleSecurity sec;
+
+    sec.pOwner = pContext->GetIdentity();
+    sec.pIdentity = myself->GetIdentity();
+
+    MemoryPatch* pMemoryPatch;
+
+    if( ( err = handlesys->ReadHandle(hndl, g_MemoryPatch, &sec, reinterpret_cast< void** >( &pMemoryPatch )) )
+          != HandleError_None ) {
+        return pContext->ThrowNativeError("Invalid Handle %x (error %d)", hndl, err);
+    } else if( pMemoryPatch->onetime ) {
+        // Nothing would be left to free the handle once the queue applies it
+        return pContext->ThrowNativeError("One-time patches cannot be queued");
+    }
+
+    bool enable = params[2] != 0;
+    if( enable ) {
+        if( reinterpret_cast< uintptr_t >( pMemoryPatch->pAddr ) < 0x10000 )
+            return pContext->ThrowNativeError("Invalid address 0x%x is pointing to reserved memory", pMemoryPatch->pAddr);
+        else if( !pMemoryPatch->bytes.Size( PatchField_Overwrite ) )
+            return pContext->ThrowNativeError("Not even a single byte is provided for patching");
+    }
+
+    g_PatchQueue.Request( pMemoryPatch, enable );
+    return 0;
+}
+
+cell_t FlushMemoryPatchQueue(IPluginContext* pContext, const cell_t* params)
+{
+    return static_cast< cell_t >( g_PatchQueue.Flush() );
+}
+
 cell_t GetMemoryPatchSize(IPluginContext* pContext, const cell_t* params)
 {
     Handle_t hndl = static_cast< Handle_t >( params[1] );
@@ -289,12 +467,12 @@ cell_t GetMemoryPatchSize(IPluginContext* pContext, const cell_t* params)
 
     char* key;
     pContext->LocalToString(params[2], &key);
-    if( !strcmp( key, "match" ) ) {
-        return static_cast< cell_t >( pMemoryPatch->match.size() );
+    if( !strcmp( key, "match" ) || !strcmp( key, "mask" ) ) {
+        return static_cast< cell_t >( pMemoryPatch->bytes.Size( PatchField_Match ) );
     } else if( !strcmp( key, "preserve" ) ) {
-        return static_cast< cell_t >( pMemoryPatch->preserve.size() );
+        return static_cast< cell_t >( pMemoryPatch->bytes.Size( PatchField_Preserve ) );
     } else if( !strcmp( key, "overwrite" ) ) {
-        return static_cast< cell_t >( pMemoryPatch->overwrite.size() );
+        return static_cast< cell_t >( pMemoryPatch->bytes.Size( PatchField_Overwrite ) );
     } else if( !strcmp( key, "original" ) ) {
         return static_cast< cell_t >( pMemoryPatch->original.size() );
     }
@@ -322,14 +500,15 @@ cell_t SetMemoryPatchSize(IPluginContext* pContext, const cell_t* params)
 
     char* key;
     pContext->LocalToString(params[2], &key);
-    if( !strcmp( key, "match" ) ) {
-        pMemoryPatch->match.resize( params[3], static_cast< uint8_t >( 0x00 ) );
+    if( !strcmp( key, "match" ) || !strcmp( key, "mask" ) ) {
+        pMemoryPatch->bytes.Resize( PatchField_Match, params[3], 0x00 );
+        pMemoryPatch->bytes.Resize( PatchField_Mask, params[3], 0xFF );
         return 0;
     } else if( !strcmp( key, "preserve" ) ) {
-        pMemoryPatch->preserve.resize( params[3], static_cast< uint8_t >( 0x00 ) );
+        pMemoryPatch->bytes.Resize( PatchField_Preserve, params[3], 0x00 );
         return 0;
     } else if( !strcmp( key, "overwrite" ) ) {
-        pMemoryPatch->overwrite.resize( params[3], static_cast< uint8_t >( 0x00 ) );
+        pMemoryPatch->bytes.Resize( PatchField_Overwrite, params[3], 0x00 );
         return 0;
     } else if( !strcmp( key, "original" ) ) {
         pMemoryPatch->original.resize( params[3], static_cast< uint8_t >( 0x00 ) );
@@ -359,12 +538,12 @@ cell_t GetMemoryPatchData(IPluginContext* pContext, const cell_t* params)
     pContext->LocalToString(params[2], &key);
 
     size_t sz;
-    if( !strcmp( key, "match" ) ) {
-        sz = pMemoryPatch->match.size();
+    if( !strcmp( key, "match" ) || !strcmp( key, "mask" ) ) {
+        sz = pMemoryPatch->bytes.Size( PatchField_Match );
     } else if( !strcmp( key, "preserve" ) ) {
-        sz = pMemoryPatch->preserve.size();
+        sz = pMemoryPatch->bytes.Size( PatchField_Preserve );
     } else if( !strcmp( key, "overwrite" ) ) {
-        sz = pMemoryPatch->overwrite.size();
+        sz = pMemoryPatch->bytes.Size( PatchField_Overwrite );
     } else if( !strcmp( key, "original" ) ) {
         sz = pMemoryPatch->original.size();
     } else {
@@ -382,11 +561,13 @@ cell_t GetMemoryPatchData(IPluginContext* pContext, const cell_t* params)
     }
 
     if( !strcmp( key, "match" ) ) {
-        return static_cast< cell_t >( pMemoryPatch->match[idx] );
+        return static_cast< cell_t >( pMemoryPatch->bytes.Data( PatchField_Match )[idx] );
+    } else if( !strcmp( key, "mask" ) ) {
+        return static_cast< cell_t >( pMemoryPatch->bytes.Data( PatchField_Mask )[idx] );
     } else if( !strcmp( key, "preserve" ) ) {
-        return static_cast< cell_t >( pMemoryPatch->preserve[idx] );
+        return static_cast< cell_t >( pMemoryPatch->bytes.Data( PatchField_Preserve )[idx] );
     } else if( !strcmp( key, "overwrite" ) ) {
-        return static_cast< cell_t >( pMemoryPatch->overwrite[idx] );
+        return static_cast< cell_t >( pMemoryPatch->bytes.Data( PatchField_Overwrite )[idx] );
     }
     return static_cast< cell_t >( pMemoryPatch->original[idx] );
 }
@@ -411,12 +592,12 @@ cell_t SetMemoryPatchData(IPluginContext* pContext, const cell_t* params)
     pContext->LocalToString(params[2], &key);
 
     size_t sz;
-    if( !strcmp( key, "match" ) ) {
-        sz = pMemoryPatch->match.size();
+    if( !strcmp( key, "match" ) || !strcmp( key, "mask" ) ) {
+        sz = pMemoryPatch->bytes.Size( PatchField_Match );
     } else if( !strcmp( key, "preserve" ) ) {
-        sz = pMemoryPatch->preserve.size();
+        sz = pMemoryPatch->bytes.Size( PatchField_Preserve );
     } else if( !strcmp( key, "overwrite" ) ) {
-        sz = pMemoryPatch->overwrite.size();
+        sz = pMemoryPatch->bytes.Size( PatchField_Overwrite );
     } else if( !strcmp( key, "original" ) ) {
         sz = pMemoryPatch->original.size();
     } else {
@@ -440,23 +621,30 @@ cell_t SetMemoryPatchData(IPluginContext* pContext, const cell_t* params)
     if( val <= -129 )
         val *= ( -1 );
 
+    // Writing a "match" byte resets its mask, with \x2A still matching any byte
+    if( !strcmp( key, "match" ) ) {
+        uint8_t* match = pMemoryPatch->bytes.MutableData( PatchField_Match );
+        match[idx] = static_cast< uint8_t >( val );
+        pMemoryPatch->bytes.MutableData( PatchField_Mask )[idx] = match[idx] == 0x2A ? 0x00 : 0xFF;
+        return 0;
+    } else if( !strcmp( key, "mask" ) ) {
+        pMemoryPatch->bytes.MutableData( PatchField_Mask )[idx] = static_cast< uint8_t >( val );
+        return 0;
+    }
+
     if( val >= 128 )
-        if( !strcmp( key, "match" ) ) {
-            pMemoryPatch->match[idx] = val;
-        } else if( !strcmp( key, "preserve" ) ) {
-            pMemoryPatch->preserve[idx] = val;
+        if( !strcmp( key, "preserve" ) ) {
+            pMemoryPatch->bytes.MutableData( PatchField_Preserve )[idx] = val;
         } else if( !strcmp( key, "overwrite" ) ) {
-            pMemoryPatch->overwrite[idx] = val;
+            pMemoryPatch->bytes.MutableData( PatchField_Overwrite )[idx] = val;
         } else {
             pMemoryPatch->original[idx] = val;
         }
     else
-        if( !strcmp( key, "match" ) ) {
-            pMemoryPatch->match[idx] = static_cast< uint8_t >( val );
-        } else if( !strcmp( key, "preserve" ) ) {
-            pMemoryPatch->preserve[idx] = static_cast< uint8_t >( val );
+        if( !strcmp( key, "preserve" ) ) {
+            pMemoryPatch->bytes.MutableData( PatchField_Preserve )[idx] = static_cast< uint8_t >( val );
         } else if( !strcmp( key, "overwrite" ) ) {
-            pMemoryPatch->overwrite[idx] = static_cast< uint8_t >( val );
+            pMemoryPatch->bytes.MutableData( PatchField_Overwrite )[idx] = static_cast< uint8_t >( val );
         } else {
             pMemoryPatch->original[idx] = static_cast< uint8_t >( val );
         }
@@ -480,12 +668,1378 @@ cell_t GetMemoryPatchAddress(IPluginContext* pContext, const cell_t* params)
         return pContext->ThrowNativeError("Invalid Handle %x (error %d)", hndl, err);
 
 #ifdef PLATFORM_X64
-    return static_cast< cell_t >( pseudoAddr.ToPseudoAddress( pMemoryPatch->pAddr ) );
+    return static_cast< cell_t >( pMemoryPatch->pinned.Get( pMemoryPatch->pAddr ) );
 #else
     return static_cast< cell_t >( reinterpret_cast< uintptr_t >( pMemoryPatch->pAddr ) );
 #endif
 }
 
+cell_t GetMemoryPatchVariant(IPluginContext* pContext, const cell_t* params)
+{
+    Handle_t hndl = static_cast< Handle_t >( params[1] );
+
+    HandleError err;
+    HandleSecurity sec;
+
+    sec.pOwner = pContext->GetIdentity();
+    sec.pIdentity = myself->GetIdentity();
+
+    MemoryPatch* pMemoryPatch;
+
+    if( ( err = handlesys->ReadHandle(hndl, g_MemoryPatch, &sec, reinterpret_cast< void** >( &pMemoryPatch )) )
+          != HandleError_None )
+        return pContext->ThrowNativeError("Invalid Handle %x (error %d)", hndl, err);
+
+    cell_t maxlength = params[3];
+    if( maxlength > 0 ) {
+        size_t len = std::min( pMemoryPatch->variantName.size(), static_cast< size_t >( maxlength - 1 ) );
+
+        char* buffer;
+        pContext->LocalToString(params[2], &buffer);
+
+        memcpy( buffer, pMemoryPatch->variantName.c_str(), len );
+        buffer[len] = '\0';
+    }
+    return static_cast< cell_t >( pMemoryPatch->variant );
+}
+
+cell_t PadMemoryPatchWithNops(IPluginContext* pContext, const cell_t* params)
+{
+    Handle_t hndl = static_cast< Handle_t >( params[1] );
+
+    HandleError err;
+    HandleSecurity sec;
+
+    sec.pOwner = pContext->GetIdentity();
+    sec.pIdentity = myself->GetIdentity();
+
+    MemoryPatch* pMemoryPatch;
+
+    if( ( err = handlesys->ReadHandle(hndl, g_MemoryPatch, &sec, reinterpret_cast< void** >( &pMemoryPatch )) )
+          != HandleError_None ) {
+        return pContext->ThrowNativeError("Invalid Handle %x (error %d)", hndl, err);
+    } else if( params[2] <= 0 ) {
+        return pContext->ThrowNativeError("Invalid instruction count %d", params[2]);
+    } else if( pMemoryPatch->IsEnabled() ) {
+        return pContext->ThrowNativeError("Cannot pad a patch that is enabled");
+    }
+
+    return static_cast< cell_t >( pMemoryPatch->PadWithNops( static_cast< size_t >( params[2] ) ) );
+}
+
+// Name and value pairs follow the handle. Every pair is checked before anything is written,
+// so a bad one leaves the patch as it was
+cell_t BindMemoryPatchParams(IPluginContext* pContext, const cell_t* params)
+{
+    Handle_t hndl = static_cast< Handle_t >( params[1] );
+
+    HandleError err;
+    HandleSecurity sec;
+
+    sec.pOwner = pContext->GetIdentity();
+    sec.pIdentity = myself->GetIdentity();
+
+    MemoryPatch* pMemoryPatch;
+
+    if( ( err = handlesys->ReadHandle(hndl, g_MemoryPatch, &sec, reinterpret_cast< void** >( &pMemoryPatch )) )
+          != HandleError_None ) {
+        return pContext->ThrowNativeError("Invalid Handle %x (error %d)", hndl, err);
+    } else if( !( params[0] & 1 ) ) {
+        return pContext->ThrowNativeError("Parameters must be passed as name and value pairs");
+    } else if( pMemoryPatch->IsEnabled() ) {
+        return pContext->ThrowNativeError("Cannot bind parameters of a patch that is enabled");
+    }
+
+    struct Field {
+        size_t offset;
+        size_t size;
+        uint8_t bytes[8];
+    };
+
+    std::vector< Field > fields;
+    size_t size = pMemoryPatch->bytes.Size( PatchField_Overwrite );
+    uintptr_t base = reinterpret_cast< uintptr_t >( pMemoryPatch->pAddr );
+
+    for( cell_t i = 2; i < params[0]; i += 2 ) {
+        char* name;
+        pContext->LocalToString(params[i], &name);
+
+        cell_t* value;
+        pContext->LocalToPhysAddr(params[i + 1], &value);
+
+        bool found = false;
+        for( const PatchParam &param : pMemoryPatch->params ) {
+            if( param.name != name )
+                continue;
+
+            found = true;
+
+            Field field;
+            field.offset = param.offset;
+            field.size = GetPatchParamSize( param.type );
+            if( field.offset + field.size > size )
+                return pContext->ThrowNativeError("Parameter \"%s\" lies past the end of \"overwrite\"", name);
+
+            uint64_t encoded;
+            switch( param.type ) {
+                case PatchParamType_Float32:
+                    encoded = static_cast< uint32_t >( *value );
+                    break;
+                case PatchParamType_Abs32:
+                case PatchParamType_Abs64:
+                case PatchParamType_Pointer:
+                case PatchParamType_Rel32:
+#ifdef PLATFORM_X64
+                    encoded = reinterpret_cast< uintptr_t >( pseudoAddr.FromPseudoAddress( static_cast< uintptr_t >( *value ) ) );
+#else
+                    encoded = static_cast< uint32_t >( *value );
+#endif
+                    break;
+                default:
+                    encoded = static_cast< uint64_t >( static_cast< int64_t >( *value ) );
+                    break;
+            }
+
+            if( !EncodePatchParam( param, encoded, base, field.bytes ) )
+                return pContext->ThrowNativeError("Value %d does not fit in parameter \"%s\"", *value, name);
+
+            fields.push_back( field );
+        }
+
+        if( !found )
+            return pContext->ThrowNativeError("Unable to find parameter \"%s\"", name);
+    }
+
+    if( fields.empty() )
+        return 0;
+
+    uint8_t* overwrite = pMemoryPatch->bytes.MutableData( PatchField_Overwrite );
+    for( const Field &field : fields ) {
+        memcpy( overwrite + field.offset, field.bytes, field.size );
+    }
+    return static_cast< cell_t >( fields.size() );
+}
+
+cell_t WatchMemoryPatch(IPluginContext* pContext, const cell_t* params)
+{
+    Handle_t hndl = static_cast< Handle_t >( params[1] );
+
+    HandleError err;
+    HandleSecurity sec;
+
+    sec.pOwner = pContext->GetIdentity();
+    sec.pIdentity = myself->GetIdentity();
+
+    MemoryPatch* pMemoryPatch;
+
+    if( ( err = handlesys->ReadHandle(hndl, g_MemoryPatch, &sec, reinterpret_cast< void** >( &pMemoryPatch )) )
+          != HandleError_None )
+        return pContext->ThrowNativeError("Invalid Handle %x (error %d)", hndl, err);
+
+    cell_t mode = params[2];
+    if( mode < PatchWatch_None || mode > PatchWatch_Reapply )
+        return pContext->ThrowNativeError("Invalid watch mode %d", mode);
+
+    // INVALID_FUNCTION resolves to null, which just leaves drift to the error log
+    pMemoryPatch->watch = mode;
+    pMemoryPatch->watchCallback = pContext->GetFunctionById(params[3]);
+    pMemoryPatch->watchData = params[4];
+
+    if( mode == PatchWatch_None )
+        g_PatchWatchdog.Unwatch( pMemoryPatch );
+    else
+        g_PatchWatchdog.Watch( pMemoryPatch );
+    return 0;
+}
+
+cell_t GetMemoryPatchLastVerified(IPluginContext* pContext, const cell_t* params)
+{
+    Handle_t hndl = static_cast< Handle_t >( params[1] );
+
+    HandleError err;
+    HandleSecurity sec;
+
+    sec.pOwner = pContext->GetIdentity();
+    sec.pIdentity = myself->GetIdentity();
+
+    MemoryPatch* pMemoryPatch;
+
+    if( ( err = handlesys->ReadHandle(hndl, g_MemoryPatch, &sec, reinterpret_cast< void** >( &pMemoryPatch )) )
+          != HandleError_None )
+        return pContext->ThrowNativeError("Invalid Handle %x (error %d)", hndl, err);
+
+    return sp_ftoc( pMemoryPatch->lastVerified );
+}
+
+cell_t SetMemoryPatchWatchdogBudget(IPluginContext* pContext, const cell_t* params)
+{
+    if( params[1] < 0 )
+        return pContext->ThrowNativeError("Invalid budget %d", params[1]);
+
+    g_PatchWatchdog.SetBudget( static_cast< unsigned int >( params[1] ) );
+    return 0;
+}
+
+cell_t CreateMemorySnapshot(IPluginContext* pContext, const cell_t* params)
+{
+#ifdef PLATFORM_X64
+    void* addr = pseudoAddr.FromPseudoAddress( static_cast< uintptr_t >( params[1] ) );
+#else
+    void* addr = reinterpret_cast< void* >( params[1] );
+#endif
+    if( addr == nullptr )
+        return pContext->ThrowNativeError("Address cannot be null");
+
+    cell_t size = params[2];
+    if( size <= 0 )
+        return pContext->ThrowNativeError("Invalid size (must be > 0)");
+
+    MemorySnapshot* pMemorySnapshot = new MemorySnapshot( addr, size );
+    if( pMemorySnapshot == nullptr )
+        return 0;
+
+    if( !pMemorySnapshot->Update() ) {
+        delete pMemorySnapshot;
+        return pContext->ThrowNativeError("Unable to read %d byte(s) at %x", size, params[1]);
+    }
+
+    Handle_t hndl = handlesys->CreateHandle(g_MemorySnapshot, pMemorySnapshot, pContext->GetIdentity(), myself->GetIdentity(), nullptr);
+    if( !hndl )
+        delete pMemorySnapshot;
+    return static_cast< cell_t >( hndl );
+}
+
+cell_t UpdateMemorySnapshot(IPluginContext* pContext, const cell_t* params)
+{
+    Handle_t hndl = static_cast< Handle_t >( params[1] );
+
+    HandleError err;
+    HandleSecurity sec;
+
+    sec.pOwner = pContext->GetIdentity();
+    sec.pIdentity = myself->GetIdentity();
+
+    MemorySnapshot* pMemorySnapshot;
+
+    if( ( err = handlesys->ReadHandle(hndl, g_MemorySnapshot, &sec, reinterpret_cast< void** >( &pMemorySnapshot )) )
+          != HandleError_None )
+        return pContext->ThrowNativeError("Invalid Handle %x (error %d)", hndl, err);
+
+    if( !pMemorySnapshot->Update() )
+        return pContext->ThrowNativeError("Unable to read %d byte(s) of the snapshot range", pMemorySnapshot->data.size());
+    return 0;
+}
+
+cell_t DiffMemorySnapshot(IPluginContext* pContext, const cell_t* params)
+{
+    Handle_t hndl = static_cast< Handle_t >( params[1] );
+
+    HandleError err;
+    HandleSecurity sec;
+
+    sec.pOwner = pContext->GetIdentity();
+    sec.pIdentity = myself->GetIdentity();
+
+    MemorySnapshot* pMemorySnapshot;
+
+    if( ( err = handlesys->ReadHandle(hndl, g_MemorySnapshot, &sec, reinterpret_cast< void** >( &pMemorySnapshot )) )
+          != HandleError_None )
+        return pContext->ThrowNativeError("Invalid Handle %x (error %d)", hndl, err);
+
+    cell_t maxRuns = params[4];
+    if( maxRuns < 0 )
+        return pContext->ThrowNativeError("Invalid maximum number of runs %d", maxRuns);
+
+    cell_t *offsets, *lengths;
+    pContext->LocalToPhysAddr(params[2], &offsets);
+    pContext->LocalToPhysAddr(params[3], &lengths);
+
+    size_t numRuns;
+    if( !pMemorySnapshot->Diff( reinterpret_cast< uint32_t* >( offsets ), reinterpret_cast< uint32_t* >( lengths ), maxRuns, numRuns ) )
+        return pContext->ThrowNativeError("Unable to read %d byte(s) of the snapshot range", pMemorySnapshot->data.size());
+    return static_cast< cell_t >( numRuns );
+}
+
+cell_t GetMemorySnapshotData(IPluginContext* pContext, const cell_t* params)
+{
+    Handle_t hndl = static_cast< Handle_t >( params[1] );
+
+    HandleError err;
+    HandleSecurity sec;
+
+    sec.pOwner = pContext->GetIdentity();
+    sec.pIdentity = myself->GetIdentity();
+
+    MemorySnapshot* pMemorySnapshot;
+
+    if( ( err = handlesys->ReadHandle(hndl, g_MemorySnapshot, &sec, reinterpret_cast< void** >( &pMemorySnapshot )) )
+          != HandleError_None )
+        return pContext->ThrowNativeError("Invalid Handle %x (error %d)", hndl, err);
+
+    size_t width = GetNumberTypeByteCount( params[3] );
+    if( !width )
+        return pContext->ThrowNativeError("Invalid number type %d", params[3]);
+
+    cell_t idx = params[2];
+    if( idx < 0 || idx + width > pMemorySnapshot->data.size() )
+        return pContext->ThrowNativeError("Invalid index %d (count: %d)", idx, pMemorySnapshot->data.size());
+
+    uint32_t val = 0;
+    memcpy( &val, &pMemorySnapshot->data[idx], width );
+    return static_cast< cell_t >( val );
+}
+
+cell_t GetMemorySnapshotSize(IPluginContext* pContext, const cell_t* params)
+{
+    Handle_t hndl = static_cast< Handle_t >( params[1] );
+
+    HandleError err;
+    HandleSecurity sec;
+
+    sec.pOwner = pContext->GetIdentity();
+    sec.pIdentity = myself->GetIdentity();
+
+    MemorySnapshot* pMemorySnapshot;
+
+    if( ( err = handlesys->ReadHandle(hndl, g_MemorySnapshot, &sec, reinterpret_cast< void** >( &pMemorySnapshot )) )
+          != HandleError_None )
+        return pContext->ThrowNativeError("Invalid Handle %x (error %d)", hndl, err);
+
+    return static_cast< cell_t >( pMemorySnapshot->data.size() );
+}
+
+cell_t GetMemorySnapshotAddress(IPluginContext* pContext, const cell_t* params)
+{
+    Handle_t hndl = static_cast< Handle_t >( params[1] );
+
+    HandleError err;
+    HandleSecurity sec;
+
+    sec.pOwner = pContext->GetIdentity();
+    sec.pIdentity = myself->GetIdentity();
+
+    MemorySnapshot* pMemorySnapshot;
+
+    if( ( err = handlesys->ReadHandle(hndl, g_MemorySnapshot, &sec, reinterpret_cast< void** >( &pMemorySnapshot )) )
+          != HandleError_None )
+        return pContext->ThrowNativeError("Invalid Handle %x (error %d)", hndl, err);
+
+#ifdef PLATFORM_X64
+    return static_cast< cell_t >( pMemorySnapshot->pinned.Get( pMemorySnapshot->pAddr ) );
+#else
+    return static_cast< cell_t >( reinterpret_cast< uintptr_t >( pMemorySnapshot->pAddr ) );
+#endif
+}
+
+cell_t CreateMemoryScan(IPluginContext* pContext, const cell_t* params)
+{
+    cell_t type = params[1];
+    if( type < ScanType_Int8 || type > ScanType_Float )
+        return pContext->ThrowNativeError("Invalid scan type %d", type);
+
+    MemoryScan* pMemoryScan = new MemoryScan( type );
+    if( pMemoryScan == nullptr )
+        return 0;
+
+    Handle_t hndl = handlesys->CreateHandle(g_MemoryScan, pMemoryScan, pContext->GetIdentity(), myself->GetIdentity(), nullptr);
+    if( !hndl ) {
+        delete pMemoryScan;
+        return 0;
+    }
+
+    pMemoryScan->hndl = hndl;
+    return static_cast< cell_t >( hndl );
+}
+
+cell_t StartMemoryScan(IPluginContext* pContext, const cell_t* params)
+{
+    Handle_t hndl = static_cast< Handle_t >( params[1] );
+
+    HandleError err;
+    HandleSecurity sec;
+
+    sec.pOwner = pContext->GetIdentity();
+    sec.pIdentity = myself->GetIdentity();
+
+    MemoryScan* pMemoryScan;
+
+    if( ( err = handlesys->ReadHandle(hndl, g_MemoryScan, &sec, reinterpret_cast< void** >( &pMemoryScan )) )
+          != HandleError_None )
+        return pContext->ThrowNativeError("Invalid Handle %x (error %d)", hndl, err);
+
+    IPluginFunction* pFunction = pContext->GetFunctionById(params[4]);
+    if( pFunction == nullptr )
+        return pContext->ThrowNativeError("Invalid function id (%x)", params[4]);
+
+    char* module;
+    pContext->LocalToString(params[6], &module);
+
+    cell_t maxResults = params[7];
+    if( maxResults <= 0 )
+        return pContext->ThrowNativeError("Invalid maximum number of results %d", maxResults);
+
+    bool writableOnly = false;
+    if( params[0] >= 8 )
+        writableOnly = static_cast< bool >( params[8] );
+
+    return static_cast< cell_t >( pMemoryScan->Start( params[2], params[3], maxResults, module, writableOnly, pFunction, params[5] ) );
+}
+
+cell_t ResetMemoryScan(IPluginContext* pContext, const cell_t* params)
+{
+    Handle_t hndl = static_cast< Handle_t >( params[1] );
+
+    HandleError err;
+    HandleSecurity sec;
+
+    sec.pOwner = pContext->GetIdentity();
+    sec.pIdentity = myself->GetIdentity();
+
+    MemoryScan* pMemoryScan;
+
+    if( ( err = handlesys->ReadHandle(hndl, g_MemoryScan, &sec, reinterpret_cast< void** >( &pMemoryScan )) )
+          != HandleError_None )
+        return pContext->ThrowNativeError("Invalid Handle %x (error %d)", hndl, err);
+
+    pMemoryScan->Reset();
+    return 0;
+}
+
+cell_t IsMemoryScanBusy(IPluginContext* pContext, const cell_t* params)
+{
+    Handle_t hndl = static_cast< Handle_t >( params[1] );
+
+    HandleError err;
+    HandleSecurity sec;
+
+    sec.pOwner = pContext->GetIdentity();
+    sec.pIdentity = myself->GetIdentity();
+
+    MemoryScan* pMemoryScan;
+
+    if( ( err = handlesys->ReadHandle(hndl, g_MemoryScan, &sec, reinterpret_cast< void** >( &pMemoryScan )) )
+          != HandleError_None )
+        return pContext->ThrowNativeError("Invalid Handle %x (error %d)", hndl, err);
+
+    return static_cast< cell_t >( pMemoryScan->IsBusy() );
+}
+
+cell_t GetMemoryScanCount(IPluginContext* pContext, const cell_t* params)
+{
+    Handle_t hndl = static_cast< Handle_t >( params[1] );
+
+    HandleError err;
+    HandleSecurity sec;
+
+    sec.pOwner = pContext->GetIdentity();
+    sec.pIdentity = myself->GetIdentity();
+
+    MemoryScan* pMemoryScan;
+
+    if( ( err = handlesys->ReadHandle(hndl, g_MemoryScan, &sec, reinterpret_cast< void** >( &pMemoryScan )) )
+          != HandleError_None )
+        return pContext->ThrowNativeError("Invalid Handle %x (error %d)", hndl, err);
+
+    return static_cast< cell_t >( pMemoryScan->results.size() );
+}
+
+cell_t GetMemoryScanResult(IPluginContext* pContext, const cell_t* params)
+{
+    Handle_t hndl = static_cast< Handle_t >( params[1] );
+
+    HandleError err;
+    HandleSecurity sec;
+
+    sec.pOwner = pContext->GetIdentity();
+    sec.pIdentity = myself->GetIdentity();
+
+    MemoryScan* pMemoryScan;
+
+    if( ( err = handlesys->ReadHandle(hndl, g_MemoryScan, &sec, reinterpret_cast< void** >( &pMemoryScan )) )
+          != HandleError_None )
+        return pContext->ThrowNativeError("Invalid Handle %x (error %d)", hndl, err);
+
+    cell_t idx = params[2];
+    if( idx < 0 || static_cast< size_t >( idx ) >= pMemoryScan->results.size() )
+        return pContext->ThrowNativeError("Invalid index %d (count: %d)", idx, pMemoryScan->results.size());
+
+#ifdef PLATFORM_X64
+    uintptr_t result = pMemoryScan->results[idx];
+    return static_cast< cell_t >( pMemoryScan->pinned[result].Get( reinterpret_cast< void* >( result ) ) );
+#else
+    return static_cast< cell_t >( pMemoryScan->results[idx] );
+#endif
+}
+
+cell_t ReadMemoryString(IPluginContext* pContext, const cell_t* params)
+{
+#ifdef PLATFORM_X64
+    void* addr = pseudoAddr.FromPseudoAddress( static_cast< uintptr_t >( params[1] ) );
+#else
+    void* addr = reinterpret_cast< void* >( params[1] );
+#endif
+    if( addr == nullptr )
+        return pContext->ThrowNativeError("Address cannot be null");
+
+    cell_t maxlength = params[3];
+    if( maxlength <= 0 )
+        return pContext->ThrowNativeError("Invalid buffer size %d", maxlength);
+
+    size_t maxChars = maxlength - 1;
+    if( params[4] >= 0 && static_cast< size_t >( params[4] ) < maxChars )
+        maxChars = params[4];
+
+    char* buffer;
+    pContext->LocalToString(params[2], &buffer);
+
+    size_t len;
+    if( !ReadStringSafe( buffer, addr, maxChars, len ) )
+        return pContext->ThrowNativeError("Unable to read a string from address 0x%x after %d bytes", params[1], len);
+
+    return static_cast< cell_t >( len );
+}
+
+cell_t WriteMemoryString(IPluginContext* pContext, const cell_t* params)
+{
+#ifdef PLATFORM_X64
+    void* addr = pseudoAddr.FromPseudoAddress( static_cast< uintptr_t >( params[1] ) );
+#else
+    void* addr = reinterpret_cast< void* >( params[1] );
+#endif
+    if( addr == nullptr )
+        return pContext->ThrowNativeError("Address cannot be null");
+
+    char* str;
+    pContext->LocalToString(params[2], &str);
+
+    size_t len = strlen( str );
+
+    cell_t maxbytes = params[3];
+    if( maxbytes == 0 )
+        return 0;
+
+    // A truncated string still gets a terminator of its own
+    bool truncated = maxbytes > 0 && len >= static_cast< size_t >( maxbytes );
+    if( truncated )
+        len = maxbytes - 1;
+
+    size_t numBytes = truncated ? len : len + 1;
+    if( WriteMemorySafe( addr, str, numBytes ) != numBytes ||
+        ( truncated && WriteMemorySafe( reinterpret_cast< uint8_t* >( addr ) + len, "", 1 ) != 1 ) )
+        return pContext->ThrowNativeError("Unable to write a string to address 0x%x", params[1]);
+
+    return static_cast< cell_t >( len );
+}
+
+cell_t GetInstructionLength(IPluginContext* pContext, const cell_t* params)
+{
+#ifdef PLATFORM_X64
+    void* addr = pseudoAddr.FromPseudoAddress( static_cast< uintptr_t >( params[1] ) );
+#else
+    void* addr = reinterpret_cast< void* >( params[1] );
+#endif
+    if( addr == nullptr )
+        return pContext->ThrowNativeError("Address cannot be null");
+
+    return static_cast< cell_t >( GetInstructionLengthAt( addr ) );
+}
+
+cell_t GetMemoryBlockString(IPluginContext* pContext, const cell_t* params)
+{
+    Handle_t hndl = static_cast< Handle_t >( params[1] );
+
+    HandleError err;
+    HandleSecurity sec;
+
+    sec.pOwner = pContext->GetIdentity();
+    sec.pIdentity = myself->GetIdentity();
+
+    MemoryBlock* pMemoryBlock;
+
+    if( ( err = handlesys->ReadHandle(hndl, g_MemoryBlock, &sec, reinterpret_cast< void** >( &pMemoryBlock )) )
+          != HandleError_None )
+        return pContext->ThrowNativeError("Invalid Handle %x (error %d)", hndl, err);
+
+    cell_t idx = params[2];
+    if( idx < 0 || static_cast< size_t >( idx ) >= pMemoryBlock->size )
+        return pContext->ThrowNativeError("Invalid index %d (count: %d)", idx, pMemoryBlock->size);
+
+    cell_t maxlength = params[4];
+    if( maxlength <= 0 )
+        return pContext->ThrowNativeError("Invalid buffer size %d", maxlength);
+
+    // A string without a terminator ends with the block
+    const char* str = reinterpret_cast< const char* >( pMemoryBlock->pBlock ) + idx;
+    size_t len = strnlen( str, pMemoryBlock->size - idx );
+    if( len >= static_cast< size_t >( maxlength ) )
+        len = maxlength - 1;
+
+    char* buffer;
+    pContext->LocalToString(params[3], &buffer);
+
+    memcpy( buffer, str, len );
+    buffer[len] = '\0';
+    return static_cast< cell_t >( len );
+}
+
+cell_t SetMemoryBlockString(IPluginContext* pContext, const cell_t* params)
+{
+    Handle_t hndl = static_cast< Handle_t >( params[1] );
+
+    HandleError err;
+    HandleSecurity sec;
+
+    sec.pOwner = pContext->GetIdentity();
+    sec.pIdentity = myself->GetIdentity();
+
+    MemoryBlock* pMemoryBlock;
+
+    if( ( err = handlesys->ReadHandle(hndl, g_MemoryBlock, &sec, reinterpret_cast< void** >( &pMemoryBlock )) )
+          != HandleError_None )
+        return pContext->ThrowNativeError("Invalid Handle %x (error %d)", hndl, err);
+
+    cell_t idx = params[2];
+    if( idx < 0 || static_cast< size_t >( idx ) >= pMemoryBlock->size )
+        return pContext->ThrowNativeError("Invalid index %d (count: %d)", idx, pMemoryBlock->size);
+
+    char* str;
+    pContext->LocalToString(params[3], &str);
+
+    // Room left in the block, including the terminator
+    size_t room = pMemoryBlock->size - idx;
+    if( params[4] > 0 && static_cast< size_t >( params[4] ) < room )
+        room = params[4];
+
+    size_t len = strnlen( str, room - 1 );
+
+    char* dest = reinterpret_cast< char* >( pMemoryBlock->pBlock ) + idx;
+    memcpy( dest, str, len );
+    dest[len] = '\0';
+    return static_cast< cell_t >( len );
+}
+
+// Follows a chain of pointers the way a debugger would: every offset except the last one is
+// added to the current address and the pointer stored there is read. The last offset is
+// only added. Returns nullptr if a hop cannot be read or lands on a null (or reserved) pointer.
+static void* ResolvePointerChain( void* base, const cell_t* offsets, cell_t count, cell_t &failedHop ) {
+    uintptr_t addr = reinterpret_cast< uintptr_t >( base );
+    for( cell_t i = 0; i < count - 1; i++ ) {
+        void* src = reinterpret_cast< void* >( addr + static_cast< intptr_t >( offsets[i] ) );
+        if( ReadMemorySafe( &addr, src, sizeof( uintptr_t ) ) != sizeof( uintptr_t ) || addr < 0x10000 ) {
+            failedHop = i;
+            return nullptr;
+        }
+    }
+
+    if( count > 0 )
+        addr += static_cast< intptr_t >( offsets[count - 1] );
+    return reinterpret_cast< void* >( addr );
+}
+
+cell_t ResolveAddressChain(IPluginContext* pContext, const cell_t* params)
+{
+#ifdef PLATFORM_X64
+    void* base = pseudoAddr.FromPseudoAddress( static_cast< uintptr_t >( params[1] ) );
+#else
+    void* base = reinterpret_cast< void* >( params[1] );
+#endif
+    if( base == nullptr )
+        return pContext->ThrowNativeError("Address cannot be null");
+
+    cell_t count = params[3];
+    if( count < 0 )
+        return pContext->ThrowNativeError("Invalid number of offsets %d", count);
+
+    cell_t* offsets;
+    pContext->LocalToPhysAddr(params[2], &offsets);
+
+    cell_t failedHop;
+    void* addr = ResolvePointerChain( base, offsets, count, failedHop );
+    if( addr == nullptr )
+        return 0;
+
+#ifdef PLATFORM_X64
+    return static_cast< cell_t >( pseudoAddr.ToPseudoAddress( addr ) );
+#else
+    return static_cast< cell_t >( reinterpret_cast< uintptr_t >( addr ) );
+#endif
+}
+
+cell_t LoadFromAddressChain(IPluginContext* pContext, const cell_t* params)
+{
+#ifdef PLATFORM_X64
+    void* base = pseudoAddr.FromPseudoAddress( static_cast< uintptr_t >( params[1] ) );
+#else
+    void* base = reinterpret_cast< void* >( params[1] );
+#endif
+    if( base == nullptr )
+        return pContext->ThrowNativeError("Address cannot be null");
+
+    cell_t count = params[3];
+    if( count < 0 )
+        return pContext->ThrowNativeError("Invalid number of offsets %d", count);
+
+    size_t width = GetNumberTypeByteCount( params[4] );
+    if( !width )
+        return pContext->ThrowNativeError("Invalid number type %d", params[4]);
+
+    cell_t* offsets;
+    pContext->LocalToPhysAddr(params[2], &offsets);
+
+    cell_t failedHop;
+    void* addr = ResolvePointerChain( base, offsets, count, failedHop );
+    if( addr == nullptr )
+        return pContext->ThrowNativeError("Unreadable or null pointer found after offset %d (0x%x)", failedHop, offsets[failedHop]);
+
+    uint32_t val = 0;
+    if( ReadMemorySafe( &val, addr, width ) != width )
+        return pContext->ThrowNativeError("Unable to read %d byte(s) at the end of the chain", width);
+    return static_cast< cell_t >( val );
+}
+
+// Address of the i-th element of a gather or scatter; either base + offsets[i] or
+// base + i * stride when no offsets are given
+static inline uint8_t* GetElementAddress( uint8_t* base, const cell_t* offsets, cell_t stride, cell_t i ) {
+    if( offsets != nullptr )
+        return base + static_cast< intptr_t >( offsets[i] );
+
+    return base + static_cast< intptr_t >( i ) * stride;
+}
+
+template< typename T >
+static void GatherValues( uint8_t* base, const cell_t* offsets, cell_t stride, cell_t* values, cell_t count ) {
+    T val;
+    for( cell_t i = 0; i < count; i++ ) {
+        memcpy( &val, GetElementAddress( base, offsets, stride, i ), sizeof( T ) );
+        values[i] = static_cast< cell_t >( val );
+    }
+}
+
+template< typename T >
+static void ScatterValues( uint8_t* base, const cell_t* offsets, cell_t stride, const cell_t* values, cell_t count ) {
+    T val;
+    for( cell_t i = 0; i < count; i++ ) {
+        val = static_cast< T >( values[i] );
+        memcpy( GetElementAddress( base, offsets, stride, i ), &val, sizeof( T ) );
+    }
+}
+
+// Shared by the gather and scatter natives. The parameter layout is always
+// ( base, offsets or stride, values, count, size )
+static cell_t TransferValues( IPluginContext* pContext, const cell_t* params, bool strided, bool store )
+{
+#ifdef PLATFORM_X64
+    void* addr = pseudoAddr.FromPseudoAddress( static_cast< uintptr_t >( params[1] ) );
+#else
+    void* addr = reinterpret_cast< void* >( params[1] );
+#endif
+    if( addr == nullptr )
+        return pContext->ThrowNativeError("Address cannot be null");
+
+    cell_t count = params[4];
+    if( count < 0 )
+        return pContext->ThrowNativeError("Invalid number of values %d", count);
+
+    size_t width = GetNumberTypeByteCount( params[5] );
+    if( !width )
+        return pContext->ThrowNativeError("Invalid number type %d", params[5]);
+
+    cell_t* offsets = nullptr;
+    cell_t stride = 0;
+    if( strided ) {
+        stride = params[2];
+    } else {
+        pContext->LocalToPhysAddr(params[2], &offsets);
+    }
+
+    cell_t* values;
+    pContext->LocalToPhysAddr(params[3], &values);
+
+    uint8_t* base = reinterpret_cast< uint8_t* >( addr );
+    switch( width ) {
+        case 1:
+            store ? ScatterValues< uint8_t >( base, offsets, stride, values, count ) : GatherValues< uint8_t >( base, offsets, stride, values, count );
+            break;
+        case 2:
+            store ? ScatterValues< uint16_t >( base, offsets, stride, values, count ) : GatherValues< uint16_t >( base, offsets, stride, values, count );
+            break;
+        default:
+            store ? ScatterValues< uint32_t >( base, offsets, stride, values, count ) : GatherValues< uint32_t >( base, offsets, stride, values, count );
+            break;
+    }
+    return 0;
+}
+
+cell_t GatherFromAddress(IPluginContext* pContext, const cell_t* params)
+{
+    return TransferValues( pContext, params, false, false );
+}
+
+cell_t GatherFromAddressStrided(IPluginContext* pContext, const cell_t* params)
+{
+    return TransferValues( pContext, params, true, false );
+}
+
+cell_t ScatterToAddress(IPluginContext* pContext, const cell_t* params)
+{
+    return TransferValues( pContext, params, false, true );
+}
+
+cell_t ScatterToAddressStrided(IPluginContext* pContext, const cell_t* params)
+{
+    return TransferValues( pContext, params, true, true );
+}
+
+cell_t CreateMemoryProgram(IPluginContext* pContext, const cell_t* params)
+{
+    MemoryProgram* pMemoryProgram = new MemoryProgram;
+    if( pMemoryProgram == nullptr )
+        return 0;
+
+    Handle_t hndl = handlesys->CreateHandle(g_MemoryProgram, pMemoryProgram, pContext->GetIdentity(), myself->GetIdentity(), nullptr);
+    if( !hndl )
+        delete pMemoryProgram;
+    return static_cast< cell_t >( hndl );
+}
+
+cell_t AddMemoryProgramOp(IPluginContext* pContext, const cell_t* params)
+{
+    Handle_t hndl = static_cast< Handle_t >( params[1] );
+
+    HandleError err;
+    HandleSecurity sec;
+
+    sec.pOwner = pContext->GetIdentity();
+    sec.pIdentity = myself->GetIdentity();
+
+    MemoryProgram* pMemoryProgram;
+
+    if( ( err = handlesys->ReadHandle(hndl, g_MemoryProgram, &sec, reinterpret_cast< void** >( &pMemoryProgram )) )
+          != HandleError_None )
+        return pContext->ThrowNativeError("Invalid Handle %x (error %d)", hndl, err);
+
+    cell_t code = params[2];
+    if( code < 0 || code >= MemoryOp_Count )
+        return pContext->ThrowNativeError("Invalid memory op %d", code);
+
+    cell_t a = params[3], b = params[4];
+    if( a < 0 || static_cast< size_t >( a ) >= MemoryProgram::MAX_REGISTERS ) {
+        return pContext->ThrowNativeError("Invalid register %d (count: %d)", a, MemoryProgram::MAX_REGISTERS);
+    } else if( b < 0 || static_cast< size_t >( b ) >= MemoryProgram::MAX_REGISTERS ) {
+        return pContext->ThrowNativeError("Invalid register %d (count: %d)", b, MemoryProgram::MAX_REGISTERS);
+    }
+
+    cell_t imm = params[5];
+    if( code == MemoryOp_Copy && ( imm < 0 || static_cast< size_t >( imm ) > MemoryProgram::MAX_COPY_SIZE ) ) {
+        return pContext->ThrowNativeError("Invalid copy size %d (maximum: %d)", imm, MemoryProgram::MAX_COPY_SIZE);
+    } else if( ( code == MemoryOp_Jump || code == MemoryOp_JumpIfZero || code == MemoryOp_JumpIfNotZero ) && imm < 0 ) {
+        return pContext->ThrowNativeError("Invalid jump target %d", imm);
+    }
+
+    size_t width = GetNumberTypeByteCount( params[6] );
+    if( !width )
+        return pContext->ThrowNativeError("Invalid number type %d", params[6]);
+
+    MemoryProgram::Op op;
+    op.code = static_cast< uint8_t >( code );
+    op.width = static_cast< uint8_t >( width );
+    op.a = static_cast< uint8_t >( a );
+    op.b = static_cast< uint8_t >( b );
+    op.imm = static_cast< intptr_t >( imm );
+
+    pMemoryProgram->ops.emplace_back( op );
+    return static_cast< cell_t >( pMemoryProgram->ops.size() - 1 );
+}
+
+cell_t ClearMemoryProgram(IPluginContext* pContext, const cell_t* params)
+{
+    Handle_t hndl = static_cast< Handle_t >( params[1] );
+
+    HandleError err;
+    HandleSecurity sec;
+
+    sec.pOwner = pContext->GetIdentity();
+    sec.pIdentity = myself->GetIdentity();
+
+    MemoryProgram* pMemoryProgram;
+
+    if( ( err = handlesys->ReadHandle(hndl, g_MemoryProgram, &sec, reinterpret_cast< void** >( &pMemoryProgram )) )
+          != HandleError_None )
+        return pContext->ThrowNativeError("Invalid Handle %x (error %d)", hndl, err);
+
+    pMemoryProgram->ops.clear();
+    return 0;
+}
+
+cell_t GetMemoryProgramLength(IPluginContext* pContext, const cell_t* params)
+{
+    Handle_t hndl = static_cast< Handle_t >( params[1] );
+
+    HandleError err;
+    HandleSecurity sec;
+
+    sec.pOwner = pContext->GetIdentity();
+    sec.pIdentity = myself->GetIdentity();
+
+    MemoryProgram* pMemoryProgram;
+
+    if( ( err = handlesys->ReadHandle(hndl, g_MemoryProgram, &sec, reinterpret_cast< void** >( &pMemoryProgram )) )
+          != HandleError_None )
+        return pContext->ThrowNativeError("Invalid Handle %x (error %d)", hndl, err);
+
+    return static_cast< cell_t >( pMemoryProgram->ops.size() );
+}
+
+cell_t ExecuteMemoryProgram(IPluginContext* pContext, const cell_t* params)
+{
+    Handle_t hndl = static_cast< Handle_t >( params[1] );
+
+    HandleError err;
+    HandleSecurity sec;
+
+    sec.pOwner = pContext->GetIdentity();
+    sec.pIdentity = myself->GetIdentity();
+
+    MemoryProgram* pMemoryProgram;
+
+    if( ( err = handlesys->ReadHandle(hndl, g_MemoryProgram, &sec, reinterpret_cast< void** >( &pMemoryProgram )) )
+          != HandleError_None )
+        return pContext->ThrowNativeError("Invalid Handle %x (error %d)", hndl, err);
+
+    cell_t numRegs = params[3];
+    if( numRegs < 0 || static_cast< size_t >( numRegs ) > MemoryProgram::MAX_REGISTERS )
+        return pContext->ThrowNativeError("Invalid number of registers %d (maximum: %d)", numRegs, MemoryProgram::MAX_REGISTERS);
+
+    cell_t* values;
+    pContext->LocalToPhysAddr(params[2], &values);
+
+    intptr_t regs[MemoryProgram::MAX_REGISTERS] = {};
+    for( cell_t i = 0; i < numRegs; i++ ) {
+        regs[i] = static_cast< intptr_t >( values[i] );
+    }
+
+    intptr_t result;
+    size_t failedOp;
+    const char* error;
+    if( !pMemoryProgram->Execute( regs, result, failedOp, error ) )
+        return pContext->ThrowNativeError("Op %d failed: %s", failedOp, error);
+
+    for( cell_t i = 0; i < numRegs; i++ ) {
+        values[i] = static_cast< cell_t >( regs[i] );
+    }
+    return static_cast< cell_t >( result );
+}
+
+cell_t CreateMemoryPatchGroup(IPluginContext* pContext, const cell_t* params)
+{
+    MemoryPatchGroup* pMemoryPatchGroup = new MemoryPatchGroup;
+    if( pMemoryPatchGroup == nullptr )
+        return 0;
+
+    Handle_t hndl = handlesys->CreateHandle(g_MemoryPatchGroup, pMemoryPatchGroup, pContext->GetIdentity(), myself->GetIdentity(), nullptr);
+    if( !hndl )
+        delete pMemoryPatchGroup;
+    return static_cast< cell_t >( hndl );
+}
+
+// Members that were freed or point to reserved memory come back as null
+static void ResolveMemoryPatchGroup( const MemoryPatchGroup* pMemoryPatchGroup, HandleSecurity &sec, std::vector< MemoryPatch* > &patches ) {
+    patches.resize( pMemoryPatchGroup->members.size() );
+
+    for( size_t i = 0; i < patches.size(); i++ ) {
+        MemoryPatch* pMemoryPatch;
+        if( handlesys->ReadHandle(pMemoryPatchGroup->members[i], g_MemoryPatch, &sec, reinterpret_cast< void** >( &pMemoryPatch )) != HandleError_None
+            || reinterpret_cast< uintptr_t >( pMemoryPatch->pAddr ) < 0x10000 ) {
+            pMemoryPatch = nullptr;
+        }
+
+        patches[i] = pMemoryPatch;
+    }
+}
+
+cell_t AddToMemoryPatchGroup(IPluginContext* pContext, const cell_t* params)
+{
+    Handle_t hndl = static_cast< Handle_t >( params[1] );
+    Handle_t patchHndl = static_cast< Handle_t >( params[2] );
+
+    HandleError err;
+    HandleSecurity sec;
+
+    sec.pOwner = pContext->GetIdentity();
+    sec.pIdentity = myself->GetIdentity();
+
+    MemoryPatchGroup* pMemoryPatchGroup;
+
+    if( ( err = handlesys->ReadHandle(hndl, g_MemoryPatchGroup, &sec, reinterpret_cast< void** >( &pMemoryPatchGroup )) )
+          != HandleError_None )
+        return pContext->ThrowNativeError("Invalid Handle %x (error %d)", hndl, err);
+
+    MemoryPatch* pMemoryPatch;
+
+    if( ( err = handlesys->ReadHandle(patchHndl, g_MemoryPatch, &sec, reinterpret_cast< void** >( &pMemoryPatch )) )
+          != HandleError_None ) {
+        return pContext->ThrowNativeError("Invalid Handle %x (error %d)", patchHndl, err);
+    } else if( pMemoryPatch->onetime ) {
+        return pContext->ThrowNativeError("One-time patches cannot be grouped");
+    } else if( pMemoryPatchGroup->enabled ) {
+        return pContext->ThrowNativeError("Cannot add to a group that is enabled");
+    }
+
+    auto &members = pMemoryPatchGroup->members;
+    if( std::find( members.begin(), members.end(), patchHndl ) != members.end() )
+        return pContext->ThrowNativeError("Patch %x is already in this group", patchHndl);
+
+    members.push_back( patchHndl );
+    return static_cast< cell_t >( members.size() - 1 );
+}
+
+cell_t EnableMemoryPatchGroup(IPluginContext* pContext, const cell_t* params)
+{
+    Handle_t hndl = static_cast< Handle_t >( params[1] );
+
+    HandleError err;
+    HandleSecurity sec;
+
+    sec.pOwner = pContext->GetIdentity();
+    sec.pIdentity = myself->GetIdentity();
+
+    MemoryPatchGroup* pMemoryPatchGroup;
+
+    if( ( err = handlesys->ReadHandle(hndl, g_MemoryPatchGroup, &sec, reinterpret_cast< void** >( &pMemoryPatchGroup )) )
+          != HandleError_None )
+        return pContext->ThrowNativeError("Invalid Handle %x (error %d)", hndl, err);
+
+    std::vector< MemoryPatch* > patches;
+    ResolveMemoryPatchGroup( pMemoryPatchGroup, sec, patches );
+
+    cell_t* failed;
+    pContext->LocalToPhysAddr(params[2], &failed);
+
+    size_t idx;
+    if( !pMemoryPatchGroup->Enable( patches, idx ) ) {
+        *failed = pMemoryPatchGroup->enabled ? -1 : static_cast< cell_t >( idx );
+        return 0;
+    }
+
+    *failed = -1;
+    return 1;
+}
+
+cell_t DisableMemoryPatchGroup(IPluginContext* pContext, const cell_t* params)
+{
+    Handle_t hndl = static_cast< Handle_t >( params[1] );
+
+    HandleError err;
+    HandleSecurity sec;
+
+    sec.pOwner = pContext->GetIdentity();
+    sec.pIdentity = myself->GetIdentity();
+
+    MemoryPatchGroup* pMemoryPatchGroup;
+
+    if( ( err = handlesys->ReadHandle(hndl, g_MemoryPatchGroup, &sec, reinterpret_cast< void** >( &pMemoryPatchGroup )) )
+          != HandleError_None )
+        return pContext->ThrowNativeError("Invalid Handle %x (error %d)", hndl, err);
+
+    std::vector< MemoryPatch* > patches;
+    ResolveMemoryPatchGroup( pMemoryPatchGroup, sec, patches );
+
+    return static_cast< cell_t >( pMemoryPatchGroup->Disable( patches ) );
+}
+
+cell_t GetMemoryPatchGroupCount(IPluginContext* pContext, const cell_t* params)
+{
+    Handle_t hndl = static_cast< Handle_t >( params[1] );
+
+    HandleError err;
+    HandleSecurity sec;
+
+    sec.pOwner = pContext->GetIdentity();
+    sec.pIdentity = myself->GetIdentity();
+
+    MemoryPatchGroup* pMemoryPatchGroup;
+
+    if( ( err = handlesys->ReadHandle(hndl, g_MemoryPatchGroup, &sec, reinterpret_cast< void** >( &pMemoryPatchGroup )) )
+          != HandleError_None )
+        return pContext->ThrowNativeError("Invalid Handle %x (error %d)", hndl, err);
+
+    return static_cast< cell_t >( pMemoryPatchGroup->members.size() );
+}
+
+// 64-bit addresses are passed around as two cells, low half first, so that they never
+// go through the pseudo-address table
+static inline uint64_t CellsToAddress64( const cell_t* cells ) {
+    return ( static_cast< uint64_t >( static_cast< uint32_t >( cells[1] ) ) << 32 ) | static_cast< uint32_t >( cells[0] );
+}
+
+static inline void Address64ToCells( uint64_t addr, cell_t* cells ) {
+    cells[0] = static_cast< cell_t >( static_cast< uint32_t >( addr ) );
+    cells[1] = static_cast< cell_t >( static_cast< uint32_t >( addr >> 32 ) );
+}
+
+// Returns false if the value does not fit in a pointer, which can only happen on 32-bit
+static bool CellsToPointer( IPluginContext* pContext, cell_t param, void* &ptr ) {
+    cell_t* cells;
+    pContext->LocalToPhysAddr(param, &cells);
+
+    uint64_t addr = CellsToAddress64( cells );
+    if( addr > static_cast< uint64_t >( UINTPTR_MAX ) ) {
+        pContext->ThrowNativeError("Address %x%08x does not fit in a pointer", cells[1], cells[0]);
+        return false;
+    }
+
+    ptr = reinterpret_cast< void* >( static_cast< uintptr_t >( addr ) );
+    if( ptr == nullptr ) {
+        pContext->ThrowNativeError("Address cannot be null");
+        return false;
+    }
+    return true;
+}
+
+static void PointerToCells( IPluginContext* pContext, cell_t param, const void* ptr ) {
+    cell_t* cells;
+    pContext->LocalToPhysAddr(param, &cells);
+
+    Address64ToCells( static_cast< uint64_t >( reinterpret_cast< uintptr_t >( ptr ) ), cells );
+}
+
+cell_t GetMemoryBlockAddress64(IPluginContext* pContext, const cell_t* params)
+{
+    Handle_t hndl = static_cast< Handle_t >( params[1] );
+
+    HandleError err;
+    HandleSecurity sec;
+
+    sec.pOwner = pContext->GetIdentity();
+    sec.pIdentity = myself->GetIdentity();
+
+    MemoryBlock* pMemoryBlock;
+
+    if( ( err = handlesys->ReadHandle(hndl, g_MemoryBlock, &sec, reinterpret_cast< void** >( &pMemoryBlock )) )
+          != HandleError_None )
+        return pContext->ThrowNativeError("Invalid Handle %x (error %d)", hndl, err);
+
+    PointerToCells( pContext, params[2], pMemoryBlock->pBlock );
+    return 0;
+}
+
+cell_t GetMemoryPatchAddress64(IPluginContext* pContext, const cell_t* params)
+{
+    Handle_t hndl = static_cast< Handle_t >( params[1] );
+
+    HandleError err;
+    HandleSecurity sec;
+
+    sec.pOwner = pContext->GetIdentity();
+    sec.pIdentity = myself->GetIdentity();
+
+    MemoryPatch* pMemoryPatch;
+
+    if( ( err = handlesys->ReadHandle(hndl, g_MemoryPatch, &sec, reinterpret_cast< void** >( &pMemoryPatch )) )
+          != HandleError_None )
+        return pContext->ThrowNativeError("Invalid Handle %x (error %d)", hndl, err);
+
+    PointerToCells( pContext, params[2], pMemoryPatch->pAddr );
+    return 0;
+}
+
+cell_t CreateMemoryPatch64(IPluginContext* pContext, const cell_t* params)
+{
+    void* addr;
+    if( !CellsToPointer( pContext, params[1], addr ) )
+        return 0;
+
+    return CreateMemoryPatchAt( pContext, params, addr );
+}
+
+cell_t GetCellAddress64(IPluginContext* pContext, const cell_t* params)
+{
+    cell_t* value;
+    if( pContext->LocalToPhysAddr(params[1], &value) != SP_ERROR_NONE )
+        return pContext->ThrowNativeError("Failed to convert cell reference to a physical address");
+
+    PointerToCells( pContext, params[2], value );
+    return 0;
+}
+
+cell_t GetStringAddress64(IPluginContext* pContext, const cell_t* params)
+{
+    char* buffer;
+    if( pContext->LocalToString(params[1], &buffer) != SP_ERROR_NONE )
+        return pContext->ThrowNativeError("Failed to convert string reference to a physical address");
+
+    PointerToCells( pContext, params[2], buffer );
+    return 0;
+}
+
+cell_t LoadFromAddress64(IPluginContext* pContext, const cell_t* params)
+{
+    void* addr;
+    if( !CellsToPointer( pContext, params[1], addr ) )
+        return 0;
+
+    size_t width = GetNumberTypeByteCount( params[2] );
+    if( !width )
+        return pContext->ThrowNativeError("Invalid number type %d", params[2]);
+
+    uint32_t val = 0;
+    memcpy( &val, addr, width );
+    return static_cast< cell_t >( val );
+}
+
+cell_t StoreToAddress64(IPluginContext* pContext, const cell_t* params)
+{
+    void* addr;
+    if( !CellsToPointer( pContext, params[1], addr ) )
+        return 0;
+
+    size_t width = GetNumberTypeByteCount( params[3] );
+    if( !width )
+        return pContext->ThrowNativeError("Invalid number type %d", params[3]);
+
+    uint32_t val = static_cast< uint32_t >( params[2] );
+    memcpy( addr, &val, width );
+    return 0;
+}
+
+cell_t AddressToAddress64(IPluginContext* pContext, const cell_t* params)
+{
+#ifdef PLATFORM_X64
+    void* addr = pseudoAddr.FromPseudoAddress( static_cast< uintptr_t >( params[1] ) );
+#else
+    void* addr = reinterpret_cast< void* >( params[1] );
+#endif
+    PointerToCells( pContext, params[2], addr );
+    return 0;
+}
+
+cell_t Address64ToAddress(IPluginContext* pContext, const cell_t* params)
+{
+    void* addr;
+    if( !CellsToPointer( pContext, params[1], addr ) )
+        return 0;
+
+#ifdef PLATFORM_X64
+    return static_cast< cell_t >( pseudoAddr.ToPseudoAddress( addr ) );
+#else
+    return static_cast< cell_t >( reinterpret_cast< uintptr_t >( addr ) );
+#endif
+}
+
+cell_t OffsetAddress64(IPluginContext* pContext, const cell_t* params)
+{
+    cell_t* addr;
+    pContext->LocalToPhysAddr(params[1], &addr);
+
+    Address64ToCells( CellsToAddress64( addr ) + static_cast< int64_t >( params[2] ), addr );
+    return 0;
+}
+
+cell_t SubtractAddress64(IPluginContext* pContext, const cell_t* params)
+{
+    cell_t* a;
+    pContext->LocalToPhysAddr(params[1], &a);
+
+    cell_t* b;
+    pContext->LocalToPhysAddr(params[2], &b);
+
+    int64_t diff = static_cast< int64_t >( CellsToAddress64( a ) - CellsToAddress64( b ) );
+    if( diff < INT32_MIN || diff > INT32_MAX )
+        return pContext->ThrowNativeError("Distance between addresses does not fit in a cell");
+
+    return static_cast< cell_t >( diff );
+}
+
+cell_t CompareAddress64(IPluginContext* pContext, const cell_t* params)
+{
+    cell_t* a;
+    pContext->LocalToPhysAddr(params[1], &a);
+
+    cell_t* b;
+    pContext->LocalToPhysAddr(params[2], &b);
+
+    uint64_t addrA = CellsToAddress64( a ), addrB = CellsToAddress64( b );
+    return addrA < addrB ? -1 : ( addrA > addrB ? 1 : 0 );
+}
+
+cell_t GetModuleInfo(IPluginContext* pContext, const cell_t* params)
+{
+    char* name;
+    pContext->LocalToString(params[1], &name);
+
+    uintptr_t base;
+    size_t size;
+    if( !ModuleInfo::Find( name, base, size ) )
+        return 0;
+
+    cell_t* baseRef;
+    pContext->LocalToPhysAddr(params[2], &baseRef);
+
+    cell_t* sizeRef;
+    pContext->LocalToPhysAddr(params[3], &sizeRef);
+
+#ifdef PLATFORM_X64
+    *baseRef = static_cast< cell_t >( pseudoAddr.ToPseudoAddress( reinterpret_cast< void* >( base ) ) );
+#else
+    *baseRef = static_cast< cell_t >( base );
+#endif
+    *sizeRef = static_cast< cell_t >( size );
+    return 1;
+}
+
+cell_t GetModuleInfo64(IPluginContext* pContext, const cell_t* params)
+{
+    char* name;
+    pContext->LocalToString(params[1], &name);
+
+    uintptr_t base;
+    size_t size;
+    if( !ModuleInfo::Find( name, base, size ) )
+        return 0;
+
+    cell_t* sizeRef;
+    pContext->LocalToPhysAddr(params[3], &sizeRef);
+
+    PointerToCells( pContext, params[2], reinterpret_cast< void* >( base ) );
+    *sizeRef = static_cast< cell_t >( size );
+    return 1;
+}
+
+cell_t FindModuleSymbol(IPluginContext* pContext, const cell_t* params)
+{
+    char* module;
+    pContext->LocalToString(params[1], &module);
+
+    char* symbol;
+    pContext->LocalToString(params[2], &symbol);
+
+    void* addr = ModuleInfo::FindSymbol( module, symbol );
+    if( addr == nullptr )
+        return 0;
+
+#ifdef PLATFORM_X64
+    return static_cast< cell_t >( pseudoAddr.ToPseudoAddress( addr ) );
+#else
+    return static_cast< cell_t >( reinterpret_cast< uintptr_t >( addr ) );
+#endif
+}
+
+cell_t FindModuleSymbol64(IPluginContext* pContext, const cell_t* params)
+{
+    char* module;
+    pContext->LocalToString(params[1], &module);
+
+    char* symbol;
+    pContext->LocalToString(params[2], &symbol);
+
+    void* addr = ModuleInfo::FindSymbol( module, symbol );
+    if( addr == nullptr )
+        return 0;
+
+    PointerToCells( pContext, params[3], addr );
+    return 1;
+}
+
 cell_t GetCellAddress(IPluginContext* pContext, const cell_t* params)
 {
     cell_t* value;
@@ -516,35 +2070,131 @@ sp_nativeinfo_t g_SrcScrambleNatives[] = {
     { "CreateMemoryBlock",           CreateMemoryBlock },
     { "GetMemoryBlockSize",          GetMemoryBlockSize },
     { "GetMemoryBlockAddress",       GetMemoryBlockAddress },
+    { "GetMemoryBlockString",        GetMemoryBlockString },
+    { "SetMemoryBlockString",        SetMemoryBlockString },
     { "CreateMemoryPatch",           CreateMemoryPatch },
     { "CreateMemoryPatchFromConf",   CreateMemoryPatchFromConf },
     { "ValidateMemoryPatch",         ValidateMemoryPatch },
     { "IsOneTimeMemoryPatch",        IsOneTimeMemoryPatch },
+    { "GetMemoryPatchOverlap",       GetMemoryPatchOverlap },
+    { "SetMemoryPatchOverlap",       SetMemoryPatchOverlap },
     { "EnableMemoryPatch",           EnableMemoryPatch },
     { "DisableMemoryPatch",          DisableMemoryPatch },
+    { "QueueMemoryPatch",            QueueMemoryPatch },
+    { "FlushMemoryPatchQueue",       FlushMemoryPatchQueue },
     { "GetMemoryPatchSize",          GetMemoryPatchSize },
     { "SetMemoryPatchSize",          SetMemoryPatchSize },
     { "GetMemoryPatchData",          GetMemoryPatchData },
     { "SetMemoryPatchData",          SetMemoryPatchData },
     { "GetMemoryPatchAddress",       GetMemoryPatchAddress },
+    { "GetMemoryPatchVariant",       GetMemoryPatchVariant },
+    { "PadMemoryPatchWithNops",      PadMemoryPatchWithNops },
+    { "BindMemoryPatchParams",       BindMemoryPatchParams },
+    { "WatchMemoryPatch",            WatchMemoryPatch },
+    { "GetMemoryPatchLastVerified",  GetMemoryPatchLastVerified },
+    { "SetMemoryPatchWatchdogBudget", SetMemoryPatchWatchdogBudget },
+    { "CreateMemorySnapshot",        CreateMemorySnapshot },
+    { "UpdateMemorySnapshot",        UpdateMemorySnapshot },
+    { "DiffMemorySnapshot",          DiffMemorySnapshot },
+    { "GetMemorySnapshotData",       GetMemorySnapshotData },
+    { "GetMemorySnapshotSize",       GetMemorySnapshotSize },
+    { "GetMemorySnapshotAddress",    GetMemorySnapshotAddress },
+    { "CreateMemoryScan",            CreateMemoryScan },
+    { "StartMemoryScan",             StartMemoryScan },
+    { "ResetMemoryScan",             ResetMemoryScan },
+    { "IsMemoryScanBusy",            IsMemoryScanBusy },
+    { "GetMemoryScanCount",          GetMemoryScanCount },
+    { "GetMemoryScanResult",         GetMemoryScanResult },
+    { "CreateMemoryProgram",         CreateMemoryProgram },
+    { "AddMemoryProgramOp",          AddMemoryProgramOp },
+    { "ClearMemoryProgram",          ClearMemoryProgram },
+    { "GetMemoryProgramLength",      GetMemoryProgramLength },
+    { "ExecuteMemoryProgram",        ExecuteMemoryProgram },
+    { "CreateMemoryPatchGroup",      CreateMemoryPatchGroup },
+    { "AddToMemoryPatchGroup",       AddToMemoryPatchGroup },
+    { "EnableMemoryPatchGroup",      EnableMemoryPatchGroup },
+    { "DisableMemoryPatchGroup",     DisableMemoryPatchGroup },
+    { "GetMemoryPatchGroupCount",    GetMemoryPatchGroupCount },
 
     { "GetCellAddress",              GetCellAddress },
     { "GetStringAddress",            GetStringAddress },
+    { "ReadMemoryString",            ReadMemoryString },
+    { "WriteMemoryString",           WriteMemoryString },
+    { "GetInstructionLength",        GetInstructionLength },
+    { "ResolveAddressChain",         ResolveAddressChain },
+    { "LoadFromAddressChain",        LoadFromAddressChain },
+    { "GatherFromAddress",           GatherFromAddress },
+    { "GatherFromAddressStrided",    GatherFromAddressStrided },
+    { "ScatterToAddress",            ScatterToAddress },
+    { "ScatterToAddressStrided",     ScatterToAddressStrided },
+    { "GetMemoryBlockAddress64",     GetMemoryBlockAddress64 },
+    { "GetMemoryPatchAddress64",     GetMemoryPatchAddress64 },
+    { "CreateMemoryPatch64",         CreateMemoryPatch64 },
+    { "GetCellAddress64",            GetCellAddress64 },
+    { "GetStringAddress64",          GetStringAddress64 },
+    { "LoadFromAddress64",           LoadFromAddress64 },
+    { "StoreToAddress64",            StoreToAddress64 },
+    { "AddressToAddress64",          AddressToAddress64 },
+    { "Address64ToAddress",          Address64ToAddress },
+    { "OffsetAddress64",             OffsetAddress64 },
+    { "SubtractAddress64",           SubtractAddress64 },
+    { "CompareAddress64",            CompareAddress64 },
+    { "GetModuleInfo",               GetModuleInfo },
+    { "GetModuleInfo64",             GetModuleInfo64 },
+    { "FindModuleSymbol",            FindModuleSymbol },
+    { "FindModuleSymbol64",          FindModuleSymbol64 },
 
     { "MemoryBlock.MemoryBlock",     CreateMemoryBlock },
     { "MemoryBlock.Size.get",        GetMemoryBlockSize },
     { "MemoryBlock.Address.get",     GetMemoryBlockAddress },
+    { "MemoryBlock.GetString",       GetMemoryBlockString },
+    { "MemoryBlock.SetString",       SetMemoryBlockString },
+    { "MemoryBlock.GetAddress64",    GetMemoryBlockAddress64 },
     { "MemoryPatch.MemoryPatch",     CreateMemoryPatch },
     { "MemoryPatch.FromConf",        CreateMemoryPatchFromConf },
     { "MemoryPatch.Validate",        ValidateMemoryPatch },
     { "MemoryPatch.IsOneTime",       IsOneTimeMemoryPatch },
+    { "MemoryPatch.Overlap.get",     GetMemoryPatchOverlap },
+    { "MemoryPatch.Overlap.set",     SetMemoryPatchOverlap },
     { "MemoryPatch.Enable",          EnableMemoryPatch },
     { "MemoryPatch.Disable",         DisableMemoryPatch },
+    { "MemoryPatch.Queue",           QueueMemoryPatch },
+    { "MemoryPatch.FlushQueue",      FlushMemoryPatchQueue },
     { "MemoryPatch.GetSize",         GetMemoryPatchSize },
     { "MemoryPatch.SetSize",         SetMemoryPatchSize },
     { "MemoryPatch.GetData",         GetMemoryPatchData },
     { "MemoryPatch.SetData",         SetMemoryPatchData },
     { "MemoryPatch.Address.get",     GetMemoryPatchAddress },
+    { "MemoryPatch.GetVariant",      GetMemoryPatchVariant },
+    { "MemoryPatch.PadWithNops",     PadMemoryPatchWithNops },
+    { "MemoryPatch.BindParams",      BindMemoryPatchParams },
+    { "MemoryPatch.Watch",           WatchMemoryPatch },
+    { "MemoryPatch.LastVerified.get", GetMemoryPatchLastVerified },
+    { "MemoryPatch.SetWatchdogBudget", SetMemoryPatchWatchdogBudget },
+    { "MemoryPatch.FromAddress64",   CreateMemoryPatch64 },
+    { "MemoryPatch.GetAddress64",    GetMemoryPatchAddress64 },
+    { "MemorySnapshot.MemorySnapshot", CreateMemorySnapshot },
+    { "MemorySnapshot.Update",       UpdateMemorySnapshot },
+    { "MemorySnapshot.Diff",         DiffMemorySnapshot },
+    { "MemorySnapshot.GetData",      GetMemorySnapshotData },
+    { "MemorySnapshot.Size.get",     GetMemorySnapshotSize },
+    { "MemorySnapshot.Address.get",  GetMemorySnapshotAddress },
+    { "MemoryScan.MemoryScan",       CreateMemoryScan },
+    { "MemoryScan.Start",            StartMemoryScan },
+    { "MemoryScan.Reset",            ResetMemoryScan },
+    { "MemoryScan.Busy.get",         IsMemoryScanBusy },
+    { "MemoryScan.Count.get",        GetMemoryScanCount },
+    { "MemoryScan.GetResult",        GetMemoryScanResult },
+    { "MemoryProgram.MemoryProgram", CreateMemoryProgram },
+    { "MemoryProgram.AddOp",         AddMemoryProgramOp },
+    { "MemoryProgram.Clear",         ClearMemoryProgram },
+    { "MemoryProgram.Length.get",    GetMemoryProgramLength },
+    { "MemoryProgram.Execute",       ExecuteMemoryProgram },
+    { "MemoryPatchGroup.MemoryPatchGroup", CreateMemoryPatchGroup },
+    { "MemoryPatchGroup.Add",        AddToMemoryPatchGroup },
+    { "MemoryPatchGroup.Enable",     EnableMemoryPatchGroup },
+    { "MemoryPatchGroup.Disable",    DisableMemoryPatchGroup },
+    { "MemoryPatchGroup.Count.get",  GetMemoryPatchGroupCount },
 
     { nullptr,                       nullptr },
 };
\ No newline at end of file
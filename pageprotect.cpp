@@ -0,0 +1,303 @@
+/**
+ * vim: set ts=4 sw=4 tw=99 noet :
+ * =============================================================================
+ * SourceMod Source Scramble Extension
+ * 
+ * Copyright (C) 2019 nosoop
+ * Copyright (C) 2023 cravenge
+ *
+ * All rights reserved
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2", the
+ * "Source Engine", the "SourcePawn JIT" and any Game MODs that run on software
+ * by the Valve Corporation. You must obey the GNU General Public License in
+ * all respects for all other code used. Additionally, AlliedModders LLC grants
+ * this exception to all derivative works. AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>
+ *
+ * Version: $Id$
+ */
+
+#include <sm_platform.h>
+
+#include "pageprotect.h"
+#include "smsdk_ext.h"
+
+#include "stdio.h"
+#include "string.h"
+
+#include <algorithm>
+#include <mutex>
+
+#include <sourcehook.h>
+#include <sh_memory.h>
+
+#if defined PLATFORM_WINDOWS
+#include <windows.h>
+
+#elif defined PLATFORM_LINUX
+#include <inttypes.h>
+#include <link.h>
+#include <sys/mman.h>
+
+#elif defined PLATFORM_APPLE
+#include <mach/mach.h>
+#include <sys/mman.h>
+
+#endif
+
+static constexpr uintptr_t PROTECT_PAGE_SIZE = 0x1000;
+
+struct ProtectedRegion {
+    uintptr_t lower;
+    uintptr_t upper;
+    unsigned long prot;
+};
+
+#if defined PLATFORM_WINDOWS
+// VirtualQuery is a single cheap call, so there is nothing worth caching here and every
+// lookup is fresh
+static bool FindRegion( uintptr_t addr, ProtectedRegion &region ) {
+    MEMORY_BASIC_INFORMATION mbi;
+    if( !VirtualQuery( reinterpret_cast< void* >( addr ), &mbi, sizeof( mbi ) ) || mbi.State != MEM_COMMIT )
+        return false;
+
+    region.lower = reinterpret_cast< uintptr_t >( mbi.BaseAddress );
+    region.upper = region.lower + mbi.RegionSize;
+    region.prot = mbi.Protect;
+    return true;
+}
+
+static bool IsWritable( unsigned long prot ) {
+    return ( prot & ( PAGE_READWRITE | PAGE_WRITECOPY | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE_WRITECOPY ) ) != 0;
+}
+
+static unsigned long MakeWritable( unsigned long prot ) {
+    return ( prot & ( PAGE_EXECUTE | PAGE_EXECUTE_READ ) ) ? PAGE_EXECUTE_READWRITE : PAGE_READWRITE;
+}
+
+static bool SetProtection( uintptr_t lower, uintptr_t upper, unsigned long prot ) {
+    DWORD old;
+    return VirtualProtect( reinterpret_cast< void* >( lower ), upper - lower, prot, &old ) != 0;
+}
+
+static void UpdateCachedRegions( uintptr_t lower, uintptr_t upper, unsigned long prot ) {
+}
+
+#elif defined PLATFORM_LINUX
+// Reading /proc/self/maps takes several system calls, so the regions are parsed once and
+// kept until a lookup misses or any module is loaded or unloaded. Scopes and MakeExecutable
+// write every change they make into the cache, so entries are trusted as they are while the
+// load counts match. Protections other components change behind its back are only picked up
+// once a module is loaded or unloaded
+static std::vector< ProtectedRegion > s_Regions;
+static unsigned long long s_Adds = 0, s_Subs = 0;
+static std::mutex s_RegionLock;
+
+static int GetLoadCountsCallback( struct dl_phdr_info* info, size_t size, void* data ) {
+    unsigned long long* counts = static_cast< unsigned long long* >( data );
+    if( size >= offsetof( struct dl_phdr_info, dlpi_subs ) + sizeof( info->dlpi_subs ) ) {
+        counts[0] = info->dlpi_adds;
+        counts[1] = info->dlpi_subs;
+    }
+    return 1;
+}
+
+static void RefreshRegions() {
+    s_Regions.clear();
+
+    FILE *fp = fopen( "/proc/self/maps", "r" );
+    if( !fp )
+        return;
+
+    char line[1024];
+    char perms[5];
+    ProtectedRegion region;
+    while( fgets( line, sizeof( line ), fp ) ) {
+        if( sscanf( line, "%" SCNxPTR "-%" SCNxPTR " %4s", &region.lower, &region.upper, perms ) == 3 ) {
+            region.prot = ( perms[0] == 'r' ? PROT_READ : 0 ) | ( perms[1] == 'w' ? PROT_WRITE : 0 ) | ( perms[2] == 'x' ? PROT_EXEC : 0 );
+            s_Regions.push_back( region );
+        }
+
+        // Skip the rest of a line longer than the buffer
+        while( !strchr( line, '\n' ) && fgets( line, sizeof( line ), fp ) ) {}
+    }
+    fclose( fp );
+}
+
+static bool FindCachedRegion( uintptr_t addr, ProtectedRegion &region ) {
+    auto it = std::upper_bound( s_Regions.begin(), s_Regions.end(), addr, []( uintptr_t value, const ProtectedRegion &r ) { return value < r.upper; } );
+    if( it == s_Regions.end() || it->lower > addr )
+        return false;
+
+    region = *it;
+    return true;
+}
+
+static bool FindRegion( uintptr_t addr, ProtectedRegion &region ) {
+    std::lock_guard< std::mutex > lock( s_RegionLock );
+
+    unsigned long long counts[2] = { ~0ULL, ~0ULL };
+    dl_iterate_phdr( GetLoadCountsCallback, counts );
+    if( counts[0] != s_Adds || counts[1] != s_Subs || counts[0] == ~0ULL ) {
+        s_Regions.clear();
+        s_Adds = counts[0];
+        s_Subs = counts[1];
+    }
+
+    if( FindCachedRegion( addr, region ) )
+        return true;
+
+    RefreshRegions();
+    return FindCachedRegion( addr, region );
+}
+
+static bool IsWritable( unsigned long prot ) {
+    return ( prot & PROT_WRITE ) != 0;
+}
+
+static unsigned long MakeWritable( unsigned long prot ) {
+    return prot | PROT_READ | PROT_WRITE;
+}
+
+static bool SetProtection( uintptr_t lower, uintptr_t upper, unsigned long prot ) {
+    return mprotect( reinterpret_cast< void* >( lower ), upper - lower, static_cast< int >( prot ) ) == 0;
+}
+
+// Splits the cached regions overlapping the range so the range itself carries the new
+// protection, which is what the kernel does with its mappings too
+static void UpdateCachedRegions( uintptr_t lower, uintptr_t upper, unsigned long prot ) {
+    std::lock_guard< std::mutex > lock( s_RegionLock );
+
+    auto first = std::upper_bound( s_Regions.begin(), s_Regions.end(), lower, []( uintptr_t value, const ProtectedRegion &r ) { return value < r.upper; } );
+    auto last = first;
+    while( last != s_Regions.end() && last->lower < upper ) {
+        ++last;
+    }
+
+    if( first == last )
+        return;
+
+    ProtectedRegion pieces[3];
+    size_t numPieces = 0;
+    if( first->lower < lower )
+        pieces[numPieces++] = { first->lower, lower, first->prot };
+    pieces[numPieces++] = { std::max( first->lower, lower ), std::min( ( last - 1 )->upper, upper ), prot };
+    if( ( last - 1 )->upper > upper )
+        pieces[numPieces++] = { upper, ( last - 1 )->upper, ( last - 1 )->prot };
+
+    auto it = s_Regions.erase( first, last );
+    s_Regions.insert( it, pieces, pieces + numPieces );
+}
+
+#elif defined PLATFORM_APPLE
+// vm_region_64 asks the kernel directly, so every lookup is fresh
+static bool FindRegion( uintptr_t addr, ProtectedRegion &region ) {
+    vm_address_t vmaddr = addr;
+    vm_size_t size;
+
+    vm_region_basic_info_data_64_t info;
+    mach_msg_type_number_t count = VM_REGION_BASIC_INFO_COUNT_64;
+    memory_object_name_t obj;
+
+    if( vm_region_64( mach_task_self(), &vmaddr, &size, VM_REGION_BASIC_INFO_64,
+                      reinterpret_cast< vm_region_info_64_t >( &info ), &count, &obj ) != KERN_SUCCESS
+        || vmaddr > addr )
+        return false;
+
+    region.lower = vmaddr;
+    region.upper = vmaddr + size;
+    region.prot = info.protection;
+    return true;
+}
+
+static bool IsWritable( unsigned long prot ) {
+    return ( prot & VM_PROT_WRITE ) != 0;
+}
+
+static unsigned long MakeWritable( unsigned long prot ) {
+    return prot | VM_PROT_READ | VM_PROT_WRITE;
+}
+
+static bool SetProtection( uintptr_t lower, uintptr_t upper, unsigned long prot ) {
+    return mprotect( reinterpret_cast< void* >( lower ), upper - lower, static_cast< int >( prot ) ) == 0;
+}
+
+static void UpdateCachedRegions( uintptr_t lower, uintptr_t upper, unsigned long prot ) {
+}
+
+#endif
+WritableScope::WritableScope() {
+}
+
+WritableScope::WritableScope( void* addr, size_t size ) {
+    this->Add( addr, size );
+}
+
+WritableScope::~WritableScope() {
+    for( auto it = this->m_Changes.rbegin(); it != this->m_Changes.rend(); ++it ) {
+        if( SetProtection( it->lower, it->upper, it->prot ) )
+            UpdateCachedRegions( it->lower, it->upper, it->prot );
+    }
+}
+
+void WritableScope::Add( void* addr, size_t size ) {
+    if( !size ) {
+        return;
+    }
+
+    uintptr_t lower = reinterpret_cast< uintptr_t >( addr ) & ~( PROTECT_PAGE_SIZE - 1 );
+    uintptr_t upper = ( reinterpret_cast< uintptr_t >( addr ) + size + PROTECT_PAGE_SIZE - 1 ) & ~( PROTECT_PAGE_SIZE - 1 );
+
+    while( lower < upper ) {
+        ProtectedRegion region;
+        if( !FindRegion( lower, region ) ) {
+            // Unknown to the region map; fall back to leaving the rest writable for good
+            smutils->LogError(myself, "Unable to find the protection of %p, leaving %u byte(s) from it writable and executable", reinterpret_cast< void* >( lower ), static_cast< unsigned int >( upper - lower ));
+
+            SourceHook::SetMemAccess(reinterpret_cast< void* >( lower ), upper - lower, SH_MEM_READ | SH_MEM_WRITE | SH_MEM_EXEC);
+            return;
+        }
+
+        uintptr_t end = std::min( region.upper, upper );
+        if( !IsWritable( region.prot ) && SetProtection( lower, end, MakeWritable( region.prot ) ) ) {
+            UpdateCachedRegions( lower, end, MakeWritable( region.prot ) );
+
+            this->m_Changes.push_back( { lower, end, region.prot } );
+        }
+
+        lower = end;
+    }
+}
+
+bool MakeExecutable( void* addr, size_t size ) {
+#if defined PLATFORM_WINDOWS
+    unsigned long prot = PAGE_EXECUTE_READ;
+#else
+    unsigned long prot = PROT_READ | PROT_EXEC;
+#endif
+
+    uintptr_t lower = reinterpret_cast< uintptr_t >( addr ) & ~( PROTECT_PAGE_SIZE - 1 );
+    uintptr_t upper = ( reinterpret_cast< uintptr_t >( addr ) + size + PROTECT_PAGE_SIZE - 1 ) & ~( PROTECT_PAGE_SIZE - 1 );
+    if( !SetProtection( lower, upper, prot ) ) {
+        return false;
+    }
+
+    UpdateCachedRegions( lower, upper, prot );
+    return true;
+}
\ No newline at end of file
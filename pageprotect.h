@@ -0,0 +1,76 @@
+/**
+ * vim: set ts=4 sw=4 tw=99 noet :
+ * =============================================================================
+ * SourceMod Source Scramble Extension
+ * 
+ * Copyright (C) 2019 nosoop
+ * Copyright (C) 2023 cravenge
+ *
+ * All rights reserved
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2", the
+ * "Source Engine", the "SourcePawn JIT" and any Game MODs that run on software
+ * by the Valve Corporation. You must obey the GNU General Public License in
+ * all respects for all other code used. Additionally, AlliedModders LLC grants
+ * this exception to all derivative works. AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>
+ *
+ * Version: $Id$
+ */
+
+#ifndef _INCLUDE_SOURCEMOD_SRCSCRMBL_PAGEPROTECT_H_
+#define _INCLUDE_SOURCEMOD_SRCSCRMBL_PAGEPROTECT_H_
+
+# ifndef _STDLIB_H_
+# include <stdlib.h>
+
+# endif
+# ifndef _STDINT_H
+# include "stdint.h"
+
+# endif
+#include <vector>
+
+// Makes ranges writable for as long as it lives, then puts back whatever protection each
+// page had before. Pages that are already writable are left alone, so no system call is
+// made for them at all. Scopes must not overlap: an inner scope would restore pages the
+// outer one still writes to
+class WritableScope {
+public:
+    WritableScope();
+    WritableScope( void* addr, size_t size );
+    ~WritableScope();
+
+    WritableScope( const WritableScope& ) = delete;
+    WritableScope &operator=( const WritableScope& ) = delete;
+
+    void Add( void* addr, size_t size );
+private:
+    struct Change {
+        uintptr_t lower;
+        uintptr_t upper;
+        unsigned long prot;
+    };
+
+    std::vector< Change > m_Changes;
+};
+
+// Turns the pages of freshly written code read-only and executable for good
+bool MakeExecutable( void* addr, size_t size );
+
+#endif // _INCLUDE_SOURCEMOD_SRCSCRMBL_PAGEPROTECT_H_
\ No newline at end of file
@@ -0,0 +1,179 @@
+/**
+ * vim: set ts=4 sw=4 tw=99 noet :
+ * =============================================================================
+ * SourceMod Source Scramble Extension
+ * 
+ * Copyright (C) 2019 nosoop
+ * Copyright (C) 2023 cravenge
+ *
+ * All rights reserved
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2", the
+ * "Source Engine", the "SourcePawn JIT" and any Game MODs that run on software
+ * by the Valve Corporation. You must obey the GNU General Public License in
+ * all respects for all other code used. Additionally, AlliedModders LLC grants
+ * this exception to all derivative works. AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>
+ *
+ * Version: $Id$
+ */
+
+#include "patchbytes.h"
+
+#include "stddef.h"
+#include "string.h"
+
+#include <algorithm>
+
+PatchBytes::PatchBytes() {
+    this->m_Block = nullptr;
+}
+
+PatchBytes::PatchBytes( const std::vector< uint8_t > &match, const std::vector< uint8_t > &mask, const std::vector< uint8_t > &preserve, const std::vector< uint8_t > &overwrite ) {
+    const std::vector< uint8_t >* fields[PatchField_Count] = { &match, &mask, &preserve, &overwrite };
+
+    size_t sizes[PatchField_Count];
+    for( int i = 0; i < PatchField_Count; i++ ) {
+        sizes[i] = fields[i]->size();
+    }
+
+    this->m_Block = Allocate( sizes );
+    if( this->m_Block == nullptr ) {
+        return;
+    }
+
+    for( int i = 0; i < PatchField_Count; i++ ) {
+        if( sizes[i] ) {
+            memcpy( this->m_Block->bytes + this->m_Block->offsets[i], fields[i]->data(), sizes[i] );
+        }
+    }
+}
+
+PatchBytes::PatchBytes( const PatchBytes &other ) {
+    this->m_Block = other.m_Block;
+    if( this->m_Block != nullptr ) {
+        this->m_Block->refs++;
+    }
+}
+
+PatchBytes &PatchBytes::operator=( const PatchBytes &other ) {
+    Block* block = other.m_Block;
+    if( block != nullptr ) {
+        block->refs++;
+    }
+
+    this->Release();
+    this->m_Block = block;
+    return *this;
+}
+
+PatchBytes::~PatchBytes() {
+    this->Release();
+}
+
+const uint8_t* PatchBytes::Data( PatchField field ) const {
+    return this->m_Block != nullptr ? this->m_Block->bytes + this->m_Block->offsets[field] : nullptr;
+}
+
+size_t PatchBytes::Size( PatchField field ) const {
+    return this->m_Block != nullptr ? this->m_Block->offsets[field + 1] - this->m_Block->offsets[field] : 0;
+}
+
+uint8_t* PatchBytes::MutableData( PatchField field ) {
+    if( this->m_Block == nullptr ) {
+        return nullptr;
+    }
+
+    if( this->m_Block->refs > 1 ) {
+        size_t total = this->m_Block->offsets[PatchField_Count];
+
+        Block* copy = static_cast< Block* >( malloc( offsetof( Block, bytes ) + std::max< size_t >( total, 1 ) ) );
+        if( copy == nullptr ) {
+            return nullptr;
+        }
+
+        memcpy( copy->offsets, this->m_Block->offsets, sizeof( copy->offsets ) );
+        memcpy( copy->bytes, this->m_Block->bytes, total );
+        copy->refs = 1;
+
+        this->m_Block->refs--;
+        this->m_Block = copy;
+    }
+
+    return this->m_Block->bytes + this->m_Block->offsets[field];
+}
+
+void PatchBytes::Resize( PatchField field, size_t size, uint8_t fill ) {
+    size_t sizes[PatchField_Count];
+    for( int i = 0; i < PatchField_Count; i++ ) {
+        sizes[i] = this->Size( static_cast< PatchField >( i ) );
+    }
+
+    if( sizes[field] == size ) {
+        return;
+    }
+
+    size_t old = sizes[field];
+    sizes[field] = size;
+
+    Block* resized = Allocate( sizes );
+    if( resized == nullptr ) {
+        return;
+    }
+
+    for( int i = 0; i < PatchField_Count; i++ ) {
+        uint8_t* dest = resized->bytes + resized->offsets[i];
+        size_t kept = i == field ? std::min( old, size ) : sizes[i];
+
+        if( kept ) {
+            memcpy( dest, this->Data( static_cast< PatchField >( i ) ), kept );
+        }
+        if( i == field && size > kept ) {
+            memset( dest + kept, fill, size - kept );
+        }
+    }
+
+    this->Release();
+    this->m_Block = resized;
+}
+
+PatchBytes::Block* PatchBytes::Allocate( const size_t sizes[PatchField_Count] ) {
+    size_t total = 0;
+    for( int i = 0; i < PatchField_Count; i++ ) {
+        total += sizes[i];
+    }
+
+    Block* block = static_cast< Block* >( malloc( offsetof( Block, bytes ) + std::max< size_t >( total, 1 ) ) );
+    if( block == nullptr ) {
+        return nullptr;
+    }
+
+    block->refs = 1;
+    block->offsets[0] = 0;
+    for( int i = 0; i < PatchField_Count; i++ ) {
+        block->offsets[i + 1] = block->offsets[i] + sizes[i];
+    }
+    return block;
+}
+
+void PatchBytes::Release() {
+    if( this->m_Block != nullptr && !--this->m_Block->refs ) {
+        free( this->m_Block );
+    }
+    this->m_Block = nullptr;
+}
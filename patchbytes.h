@@ -0,0 +1,91 @@
+/**
+ * vim: set ts=4 sw=4 tw=99 noet :
+ * =============================================================================
+ * SourceMod Source Scramble Extension
+ * 
+ * Copyright (C) 2019 nosoop
+ * Copyright (C) 2023 cravenge
+ *
+ * All rights reserved
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2", the
+ * "Source Engine", the "SourcePawn JIT" and any Game MODs that run on software
+ * by the Valve Corporation. You must obey the GNU General Public License in
+ * all respects for all other code used. Additionally, AlliedModders LLC grants
+ * this exception to all derivative works. AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>
+ *
+ * Version: $Id$
+ */
+
+#ifndef _INCLUDE_SOURCEMOD_SRCSCRMBL_PATCHBYTES_H_
+#define _INCLUDE_SOURCEMOD_SRCSCRMBL_PATCHBYTES_H_
+
+# ifndef _STDLIB_H_
+# include <stdlib.h>
+
+# endif
+# ifndef _STDINT_H
+# include "stdint.h"
+
+# endif
+#include <vector>
+
+enum PatchField {
+    PatchField_Match,
+    PatchField_Mask,        // Bits of each "match" byte that are compared; always as long as match
+    PatchField_Preserve,
+    PatchField_Overwrite,
+
+    PatchField_Count
+};
+
+// The byte arrays of a patch, laid out back to back in one reference-counted allocation.
+// Copies share it until one of them is changed, so every MemoryPatch made from the same
+// PatchConf reads the bytes parsed from the game config instead of holding its own. Patches
+// only live on the main thread, so the count is not atomic
+class PatchBytes {
+public:
+    PatchBytes();
+    PatchBytes( const std::vector< uint8_t > &match, const std::vector< uint8_t > &mask, const std::vector< uint8_t > &preserve, const std::vector< uint8_t > &overwrite );
+    PatchBytes( const PatchBytes &other );
+    PatchBytes &operator=( const PatchBytes &other );
+    ~PatchBytes();
+
+    const uint8_t* Data( PatchField field ) const;
+    size_t Size( PatchField field ) const;
+
+    // Gives this copy a block of its own first if any other copy still shares it
+    uint8_t* MutableData( PatchField field );
+
+    // New bytes past the old end are set to "fill"
+    void Resize( PatchField field, size_t size, uint8_t fill );
+private:
+    struct Block {
+        unsigned int refs;
+        size_t offsets[PatchField_Count + 1];
+        uint8_t bytes[1];
+    };
+
+    static Block* Allocate( const size_t sizes[PatchField_Count] );
+    void Release();
+
+    Block* m_Block;
+};
+
+#endif // _INCLUDE_SOURCEMOD_SRCSCRMBL_PATCHBYTES_H_
@@ -34,11 +34,21 @@
  */
 
 #include "patches.h"
+#include "patchkernels.h"
 #include "util.h"
 
+#include <algorithm>
+
 #define PSTATE_GAMEDEFS_PATCHES			1
 #define PSTATE_GAMEDEFS_PATCHES_PATCH		2
 #define PSTATE_GAMEDEFS_PATCHES_PATCH_MATCH 	3
+#define PSTATE_GAMEDEFS_PATCHES_PATCH_VARIANTS	4
+#define PSTATE_GAMEDEFS_PATCHES_PATCH_VARIANT	5
+
+#define VariantKey_Offset			( 1 << 0 )
+#define VariantKey_Match			( 1 << 1 )
+#define VariantKey_Preserve			( 1 << 2 )
+#define VariantKey_Overwrite			( 1 << 3 )
 
 #ifdef PLATFORM_X64
 #define PLATFORM_ARCH_SUFFIX			"64"
@@ -60,12 +70,27 @@ static inline bool DoesPlatformMatch( const char* platform ) {
     return !strcmp( platform, PLATFORM_NAME );
 }
 
+static inline int ParseOffset( const char* value ) {
+    if( value[strlen( value ) - 1] == 'h' ) {
+        return static_cast< int >( strtol( value, nullptr, 16 ) );
+    }
+    return static_cast< int >( strtol( value, nullptr, 0 ) );
+}
+
+static inline void AssignField( std::vector< uint8_t > &dest, const PatchBytes &bytes, PatchField field ) {
+    dest.assign( bytes.Data( field ), bytes.Data( field ) + bytes.Size( field ) );
+}
+
 void PatchGameConfig::ReadSMC_ParseStart() {
     m_ParseState = PSTATE_GAMEDEFS_PATCHES;
     m_IgnoreLevel = 0;
 
     m_PatchOffset = 0;
+    m_PatchNopFill = 0;
+    m_PatchCaveOriginal = PatchCaveOriginal_After;
+    m_PatchSearch = 0;
     m_PatchOneTime = false;
+    m_PatchBoundary = false;
 }
 
 SMCResult PatchGameConfig::ReadSMC_NewSection(const SMCStates *states, const char *name)
@@ -84,13 +109,43 @@ SMCResult PatchGameConfig::ReadSMC_NewSection(const SMCStates *states, const cha
 
             m_PatchSignature = std::move( patConf.signatureName );
             m_PatchOffset = patConf.offset;
-            m_PatchMatch = std::move( patConf.match );
-            m_PatchPreserve = std::move( patConf.preserve );
-            m_PatchOverwrite = std::move( patConf.overwrite );
+            AssignField( m_PatchMatch, patConf.bytes, PatchField_Match );
+            AssignField( m_PatchMatchMask, patConf.bytes, PatchField_Mask );
+            AssignField( m_PatchPreserve, patConf.bytes, PatchField_Preserve );
+            AssignField( m_PatchOverwrite, patConf.bytes, PatchField_Overwrite );
+            m_PatchParams = std::move( patConf.params );
             m_PatchOneTime = patConf.onetime;
+            m_PatchNopFill = patConf.nopFill;
+            m_PatchBoundary = patConf.boundary;
+            m_PatchCave = std::move( patConf.cave );
+            m_PatchCaveOriginal = patConf.caveOriginal;
+            m_PatchSearch = patConf.search;
+
+            // Variants read before already had their missing keys filled in
+            for( PatchVariant &variant : patConf.variants ) {
+                VariantKeys keys;
+                keys.name = std::move( variant.name );
+                keys.given = VariantKey_Offset | VariantKey_Match | VariantKey_Preserve | VariantKey_Overwrite;
+                keys.offset = variant.offset;
+                AssignField( keys.match, variant.bytes, PatchField_Match );
+                AssignField( keys.matchMask, variant.bytes, PatchField_Mask );
+                AssignField( keys.preserve, variant.bytes, PatchField_Preserve );
+                AssignField( keys.overwrite, variant.bytes, PatchField_Overwrite );
+                keys.params = std::move( variant.params );
+                m_PatchVariants.push_back( std::move( keys ) );
+            }
         }
 
         m_ParseState = PSTATE_GAMEDEFS_PATCHES_PATCH;
+    } else if( ( m_ParseState == PSTATE_GAMEDEFS_PATCHES_PATCH || m_ParseState == PSTATE_GAMEDEFS_PATCHES_PATCH_MATCH ) && !strcmp( name, "variants" ) ) {
+        m_VariantsParent = m_ParseState;
+        m_ParseState = PSTATE_GAMEDEFS_PATCHES_PATCH_VARIANTS;
+    } else if( m_ParseState == PSTATE_GAMEDEFS_PATCHES_PATCH_VARIANTS ) {
+        m_Variant.name = name;
+        m_Variant.given = 0;
+        m_Variant.offset = 0;
+
+        m_ParseState = PSTATE_GAMEDEFS_PATCHES_PATCH_VARIANT;
     } else if( m_ParseState == PSTATE_GAMEDEFS_PATCHES_PATCH ) {
         if( DoesPlatformMatch( name ) ) {
             m_ParseState = PSTATE_GAMEDEFS_PATCHES_PATCH_MATCH;
@@ -112,32 +167,108 @@ SMCResult PatchGameConfig::ReadSMC_NewSection(const SMCStates *states, const cha
 
 SMCResult PatchGameConfig::ReadSMC_KeyValue(const SMCStates *states, const char *key, const char *value)
 {
-    if( ( m_IgnoreLevel ) || ( ( m_ParseState != PSTATE_GAMEDEFS_PATCHES_PATCH ) && ( m_ParseState != PSTATE_GAMEDEFS_PATCHES_PATCH_MATCH ) ) || ( !*key ) ||
-        ( !*value ) ) {
+    if( ( m_IgnoreLevel ) || ( ( m_ParseState != PSTATE_GAMEDEFS_PATCHES_PATCH ) && ( m_ParseState != PSTATE_GAMEDEFS_PATCHES_PATCH_MATCH ) &&
+        ( m_ParseState != PSTATE_GAMEDEFS_PATCHES_PATCH_VARIANT ) ) || ( !*key ) || ( !*value ) ) {
         return SMCResult_Continue;
     }
 
+    if( m_ParseState == PSTATE_GAMEDEFS_PATCHES_PATCH_VARIANT ) {
+        return ReadVariantKeyValue( key, value );
+    }
+
     if( !strcmp( key, "one-time" ) ) {
         if( !strcmp( value, "yes" ) )
             m_PatchOneTime = true;
+    } else if( !strcmp( key, "boundary" ) ) {
+        m_PatchBoundary = !strcmp( value, "yes" );
+    } else if( !strcmp( key, "nop-fill" ) ) {
+        m_PatchNopFill = static_cast< int >( strtol( value, nullptr, 0 ) );
+        if( m_PatchNopFill < 0 || m_PatchNopFill > 64 ) {
+            smutils->LogError(myself, "Error while parsing Patch section for \"%s\":", m_Patch.c_str());
+            smutils->LogError(myself, "Invalid instruction count \"%s\"", value);
+
+            m_PatchNopFill = 0;
+        }
+    } else if( !strcmp( key, "search" ) ) {
+        m_PatchSearch = static_cast< int >( strtol( value, nullptr, 0 ) );
+        if( m_PatchSearch < 0 || m_PatchSearch > 4096 ) {
+            smutils->LogError(myself, "Error while parsing Patch section for \"%s\":", m_Patch.c_str());
+            smutils->LogError(myself, "Invalid search window \"%s\"", value);
+
+            m_PatchSearch = 0;
+        }
+    } else if( !strcmp( key, "cave" ) ) {
+        m_PatchCave = EscapedHexToByteVector( value );
+    } else if( !strcmp( key, "cave-original" ) ) {
+        if( !strcmp( value, "after" ) ) {
+            m_PatchCaveOriginal = PatchCaveOriginal_After;
+        } else if( !strcmp( value, "before" ) ) {
+            m_PatchCaveOriginal = PatchCaveOriginal_Before;
+        } else if( !strcmp( value, "none" ) ) {
+            m_PatchCaveOriginal = PatchCaveOriginal_None;
+        } else {
+            smutils->LogError(myself, "Error while parsing Patch section for \"%s\":", m_Patch.c_str());
+            smutils->LogError(myself, "Invalid cave-original \"%s\" (must be after, before or none)", value);
+        }
     } else if( !strcmp( key, "overwrite" ) ) {
-        m_PatchOverwrite = EscapedHexToByteVector( value );
+        if( !CompileOverwriteTemplate( value, m_PatchOverwrite, m_PatchParams ) ) {
+            smutils->LogError(myself, "Error while parsing Patch section for \"%s\":", m_Patch.c_str());
+            smutils->LogError(myself, "Invalid overwrite template \"%s\"", value);
+
+            m_PatchOverwrite.clear();
+            m_PatchParams.clear();
+        }
     } else if( !strcmp( key, "preserve" ) ) {
         m_PatchPreserve = EscapedHexToByteVector( value );
     } else if( !strcmp( key, "match" ) ) {
-        m_PatchMatch = EscapedHexToByteVector( value );
-    } else if( !strcmp( key, "offset" ) ) {
-        if( value[strlen( value ) - 1] == 'h' ) {
-            m_PatchOffset = static_cast< int >( strtol( value, nullptr, 16 ) );
-        } else {
-            m_PatchOffset = static_cast< int >( strtol( value, nullptr, 0 ) );
+        if( !ParseMatchPattern( value, m_PatchMatch, m_PatchMatchMask ) ) {
+            smutils->LogError(myself, "Error while parsing Patch section for \"%s\":", m_Patch.c_str());
+            smutils->LogError(myself, "Invalid match pattern \"%s\"", value);
+
+            m_PatchMatch.clear();
+            m_PatchMatchMask.clear();
         }
+    } else if( !strcmp( key, "offset" ) ) {
+        m_PatchOffset = ParseOffset( value );
     } else if( !strcmp( key, "signature" ) ) {
         m_PatchSignature = value;
     }
     return SMCResult_Continue;
 }
 
+SMCResult PatchGameConfig::ReadVariantKeyValue( const char* key, const char* value )
+{
+    if( !strcmp( key, "offset" ) ) {
+        m_Variant.offset = ParseOffset( value );
+        m_Variant.given |= VariantKey_Offset;
+    } else if( !strcmp( key, "match" ) ) {
+        if( !ParseMatchPattern( value, m_Variant.match, m_Variant.matchMask ) ) {
+            smutils->LogError(myself, "Error while parsing Patch section for \"%s\":", m_Patch.c_str());
+            smutils->LogError(myself, "Invalid match pattern \"%s\" in variant \"%s\"", value, m_Variant.name.c_str());
+
+            m_Variant.match.clear();
+            m_Variant.matchMask.clear();
+        }
+        m_Variant.given |= VariantKey_Match;
+    } else if( !strcmp( key, "preserve" ) ) {
+        m_Variant.preserve = EscapedHexToByteVector( value );
+        m_Variant.given |= VariantKey_Preserve;
+    } else if( !strcmp( key, "overwrite" ) ) {
+        if( !CompileOverwriteTemplate( value, m_Variant.overwrite, m_Variant.params ) ) {
+            smutils->LogError(myself, "Error while parsing Patch section for \"%s\":", m_Patch.c_str());
+            smutils->LogError(myself, "Invalid overwrite template \"%s\" in variant \"%s\"", value, m_Variant.name.c_str());
+
+            m_Variant.overwrite.clear();
+            m_Variant.params.clear();
+        }
+        m_Variant.given |= VariantKey_Overwrite;
+    } else {
+        smutils->LogError(myself, "Error while parsing Patch section for \"%s\":", m_Patch.c_str());
+        smutils->LogError(myself, "Key \"%s\" cannot be set in variant \"%s\"", key, m_Variant.name.c_str());
+    }
+    return SMCResult_Continue;
+}
+
 SMCResult PatchGameConfig::ReadSMC_LeavingSection(const SMCStates *states)
 {
     if( m_IgnoreLevel ) {
@@ -146,30 +277,110 @@ SMCResult PatchGameConfig::ReadSMC_LeavingSection(const SMCStates *states)
     }
 
     if( m_ParseState == PSTATE_GAMEDEFS_PATCHES_PATCH ) {
-        PatchConf patConf( std::move( m_PatchSignature ), m_PatchOffset, std::move( m_PatchMatch ), std::move( m_PatchPreserve ), std::move( m_PatchOverwrite ), m_PatchOneTime );
+        std::vector< PatchVariant > variants;
+        for( const VariantKeys &keys : m_PatchVariants ) {
+            bool match = keys.given & VariantKey_Match, overwrite = keys.given & VariantKey_Overwrite;
+
+            PatchVariant variant;
+            variant.name = keys.name;
+            variant.offset = ( keys.given & VariantKey_Offset ) ? keys.offset : m_PatchOffset;
+            variant.bytes = PatchBytes( match ? keys.match : m_PatchMatch, match ? keys.matchMask : m_PatchMatchMask,
+                                        ( keys.given & VariantKey_Preserve ) ? keys.preserve : m_PatchPreserve, overwrite ? keys.overwrite : m_PatchOverwrite );
+            variant.params = overwrite ? keys.params : m_PatchParams;
+            variants.push_back( std::move( variant ) );
+        }
+
+        PatchConf patConf( std::move( m_PatchSignature ), m_PatchOffset, m_PatchMatch, m_PatchMatchMask, m_PatchPreserve, m_PatchOverwrite,
+                           std::move( m_PatchParams ), m_PatchOneTime, m_PatchNopFill, m_PatchBoundary );
+        patConf.variants = std::move( variants );
+        patConf.cave = std::move( m_PatchCave );
+        patConf.caveOriginal = m_PatchCaveOriginal;
+        patConf.search = m_PatchSearch;
         m_Patches.replace(m_Patch.c_str(), patConf);
 
         if( m_PatchOneTime )
             m_PatchOneTime = false;
+        m_PatchBoundary = false;
+        m_PatchNopFill = 0;
+        m_PatchCave.clear();
+        m_PatchCaveOriginal = PatchCaveOriginal_After;
+        m_PatchSearch = 0;
         m_PatchOverwrite.clear();
+        m_PatchParams.clear();
         m_PatchPreserve.clear();
         m_PatchMatch.clear();
+        m_PatchMatchMask.clear();
         if( m_PatchOffset )
             m_PatchOffset = 0;
         m_PatchSignature.clear();
+        m_PatchVariants.clear();
 
         m_ParseState = PSTATE_GAMEDEFS_PATCHES;
     } else if( m_ParseState == PSTATE_GAMEDEFS_PATCHES_PATCH_MATCH ) {
         m_ParseState = PSTATE_GAMEDEFS_PATCHES_PATCH;
+    } else if( m_ParseState == PSTATE_GAMEDEFS_PATCHES_PATCH_VARIANT ) {
+        // A variant of the same name from an earlier file is replaced in place
+        std::vector< VariantKeys >::iterator it = std::find_if( m_PatchVariants.begin(), m_PatchVariants.end(), [this]( const VariantKeys &keys ) {
+            return keys.name == m_Variant.name;
+        } );
+
+        if( it != m_PatchVariants.end() ) {
+            *it = std::move( m_Variant );
+        } else {
+            m_PatchVariants.push_back( std::move( m_Variant ) );
+        }
+
+        m_Variant.match.clear();
+        m_Variant.matchMask.clear();
+        m_Variant.preserve.clear();
+        m_Variant.overwrite.clear();
+        m_Variant.params.clear();
+
+        m_ParseState = PSTATE_GAMEDEFS_PATCHES_PATCH_VARIANTS;
+    } else if( m_ParseState == PSTATE_GAMEDEFS_PATCHES_PATCH_VARIANTS ) {
+        m_ParseState = m_VariantsParent;
     }
     return SMCResult_Continue;
 }
 
-PatchGameConfig::PatchConf::PatchConf( std::string &&sigName, int ofst, std::vector< uint8_t > &&mtch, std::vector< uint8_t > &&presv, std::vector< uint8_t > &&ovr, bool ot ) {
+PatchGameConfig::PatchConf::PatchConf( std::string &&sigName, int ofst, const std::vector< uint8_t > &mtch, const std::vector< uint8_t > &mask, const std::vector< uint8_t > &presv,
+                                      const std::vector< uint8_t > &ovr, std::vector< PatchParam > &&ovrParams, bool ot, int nops, bool bound )
+    : bytes( mtch, mask, presv, ovr ) {
     this->signatureName = std::move( sigName );
     this->offset = ofst;
-    this->match = std::move( mtch );
-    this->preserve = std::move( presv );
-    this->overwrite = std::move( ovr );
+    this->params = std::move( ovrParams );
     this->onetime = ot;
-}
\ No newline at end of file
+    this->nopFill = nops;
+    this->boundary = bound;
+    this->caveOriginal = PatchCaveOriginal_After;
+    this->search = 0;
+}
+
+// Reads the code every variant's "match" covers in one go, then tries the variants in order
+// against that copy. Variants without "match" always fit
+int PatchGameConfig::PatchConf::SelectVariant( const void* addr ) const {
+    if( this->variants.empty() ) {
+        return -1;
+    }
+
+    int lower = this->variants[0].offset, upper = lower;
+    for( const PatchVariant &variant : this->variants ) {
+        lower = std::min( lower, variant.offset );
+        upper = std::max( upper, variant.offset + static_cast< int >( variant.bytes.Size( PatchField_Match ) ) );
+    }
+
+    std::vector< uint8_t > code( upper - lower );
+    size_t read = ReadMemorySafe( code.data(), reinterpret_cast< const uint8_t* >( addr ) + lower, code.size() );
+
+    for( size_t i = 0; i < this->variants.size(); i++ ) {
+        const PatchVariant &variant = this->variants[i];
+
+        size_t start = static_cast< size_t >( variant.offset - lower ), size = variant.bytes.Size( PatchField_Match );
+        if( !size ) {
+            return static_cast< int >( i );
+        } else if( start + size <= read && GetPatchKernels().Match( code.data() + start, variant.bytes.Data( PatchField_Match ), variant.bytes.Data( PatchField_Mask ), size ) ) {
+            return static_cast< int >( i );
+        }
+    }
+    return -1;
+}
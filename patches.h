@@ -36,6 +36,8 @@
 #ifndef _INCLUDE_SOURCEMOD_SRCSCRMBL_PATCHES_H_
 #define _INCLUDE_SOURCEMOD_SRCSCRMBL_PATCHES_H_
 
+#include "patchbytes.h"
+#include "patchparams.h"
 #include "smsdk_ext.h"
 
 #include <string>
@@ -43,6 +45,13 @@
 
 #include <sm_stringhashmap.h>
 
+// Where the instructions a cave's jump replaces are run
+enum PatchCaveOriginal {
+    PatchCaveOriginal_After,    // After the cave code
+    PatchCaveOriginal_Before,
+    PatchCaveOriginal_None
+};
+
 class PatchGameConfig : public ITextListener_SMC {
     int m_ParseState;
     unsigned int m_IgnoreLevel;
@@ -53,26 +62,73 @@ class PatchGameConfig : public ITextListener_SMC {
     int m_PatchOffset;
 
     std::vector< uint8_t > m_PatchMatch;
+    std::vector< uint8_t > m_PatchMatchMask;
     std::vector< uint8_t > m_PatchPreserve;
     std::vector< uint8_t > m_PatchOverwrite;
+    std::vector< PatchParam > m_PatchParams;
+    std::vector< uint8_t > m_PatchCave;
+
+    int m_PatchNopFill;
+    int m_PatchCaveOriginal;
+    int m_PatchSearch;
 
     bool m_PatchOneTime;
+    bool m_PatchBoundary;
+
+    // A section under "variants", as read. Keys it leaves out are taken from the patch once the
+    // whole patch section has been read
+    struct VariantKeys {
+        std::string name;
+        int given;  // VariantKey_* flags
+        int offset;
+        std::vector< uint8_t > match;
+        std::vector< uint8_t > matchMask;
+        std::vector< uint8_t > preserve;
+        std::vector< uint8_t > overwrite;
+        std::vector< PatchParam > params;
+    };
+
+    std::vector< VariantKeys > m_PatchVariants;
+    VariantKeys m_Variant;
+    int m_VariantsParent;   // State the "variants" section was entered from
+
+    SMCResult ReadVariantKeyValue( const char* key, const char* value );
 public:
     void ReadSMC_ParseStart();
     SMCResult ReadSMC_NewSection(const SMCStates *states, const char *name);
     SMCResult ReadSMC_KeyValue(const SMCStates *states, const char *key, const char *value);
     SMCResult ReadSMC_LeavingSection(const SMCStates *states);
 
+    struct PatchVariant {
+        std::string name;
+        int offset;
+        PatchBytes bytes;
+        std::vector< PatchParam > params;
+    };
+
     struct PatchConf {
         PatchConf() {}
-        PatchConf( std::string &&sigName, int ofst, std::vector< uint8_t > &&mtch, std::vector< uint8_t > &&presv, std::vector< uint8_t > &&ovr, bool ot );
+        PatchConf( std::string &&sigName, int ofst, const std::vector< uint8_t > &mtch, const std::vector< uint8_t > &mask, const std::vector< uint8_t > &presv, const std::vector< uint8_t > &ovr,
+                   std::vector< PatchParam > &&ovrParams, bool ot, int nops, bool bound );
 
         std::string signatureName;
         int offset;
-        std::vector< uint8_t > match;
-        std::vector< uint8_t > preserve;
-        std::vector< uint8_t > overwrite;
+        PatchBytes bytes;   // Shared with every MemoryPatch created from this section
+        std::vector< PatchParam > params;   // Placeholders in "overwrite"
         bool onetime;
+        int nopFill;    // Instructions that "overwrite" is padded with NOPs to cover, or 0
+        int search;     // Bytes either side of "offset" that "match" is looked for in when it fails there
+        bool boundary;  // Validation also requires "overwrite" to end on an instruction boundary
+
+        // Replace offset, bytes and params above when there are any
+        std::vector< PatchVariant > variants;
+
+        // Code jumped out to instead of "overwrite", if any
+        std::vector< uint8_t > cave;
+        int caveOriginal;
+
+        // Index of the first variant whose "match" fits the code at "addr", or -1
+        int SelectVariant( const void* addr ) const;
     };
 
     StringHashMap< PatchConf > m_Patches;
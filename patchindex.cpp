@@ -0,0 +1,194 @@
+/**
+ * vim: set ts=4 sw=4 tw=99 noet :
+ * =============================================================================
+ * SourceMod Source Scramble Extension
+ * 
+ * Copyright (C) 2019 nosoop
+ * Copyright (C) 2023 cravenge
+ *
+ * All rights reserved
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2", the
+ * "Source Engine", the "SourcePawn JIT" and any Game MODs that run on software
+ * by the Valve Corporation. You must obey the GNU General Public License in
+ * all respects for all other code used. Additionally, AlliedModders LLC grants
+ * this exception to all derivative works. AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>
+ *
+ * Version: $Id$
+ */
+
+#include "patchindex.h"
+
+#include <algorithm>
+
+PatchIndex g_ActivePatches;
+
+PatchIndex::PatchIndex() {
+    this->m_Root = nullptr;
+    this->m_NextSequence = 1;
+    this->m_Count = 0;
+}
+
+void PatchIndex::Insert( PatchIndexNode* node, uintptr_t lower, uintptr_t upper ) {
+    node->lower = lower;
+    node->upper = upper;
+    node->maxUpper = upper;
+    node->sequence = this->m_NextSequence++;
+
+    // Any well-mixed value keeps the treap balanced with high probability
+    uint64_t mixed = node->sequence * 0x9E3779B97F4A7C15ULL;
+    node->priority = static_cast< uint32_t >( mixed >> 32 );
+
+    node->left = nullptr;
+    node->right = nullptr;
+
+    this->m_Root = Insert( this->m_Root, node );
+    this->m_Count++;
+}
+
+void PatchIndex::Remove( PatchIndexNode* node ) {
+    this->m_Root = Remove( this->m_Root, node );
+    this->m_Count--;
+
+    node->left = nullptr;
+    node->right = nullptr;
+    node->sequence = 0;
+}
+
+void PatchIndex::FindOverlaps( uintptr_t lower, uintptr_t upper, std::vector< MemoryPatch* > &out ) const {
+    FindOverlaps( this->m_Root, lower, upper, out );
+}
+
+void PatchIndex::GetAll( std::vector< MemoryPatch* > &out ) const {
+    out.reserve( out.size() + this->m_Count );
+    GetAll( this->m_Root, out );
+}
+
+size_t PatchIndex::Count() const {
+    return this->m_Count;
+}
+
+void PatchIndex::Update( PatchIndexNode* node ) {
+    node->maxUpper = node->upper;
+    if( node->left != nullptr )
+        node->maxUpper = std::max( node->maxUpper, node->left->maxUpper );
+    if( node->right != nullptr )
+        node->maxUpper = std::max( node->maxUpper, node->right->maxUpper );
+}
+
+bool PatchIndex::Less( const PatchIndexNode* a, const PatchIndexNode* b ) {
+    return a->lower < b->lower || ( a->lower == b->lower && a->sequence < b->sequence );
+}
+
+PatchIndexNode* PatchIndex::Insert( PatchIndexNode* root, PatchIndexNode* node ) {
+    if( root == nullptr ) {
+        return node;
+    }
+
+    if( Less( node, root ) ) {
+        root->left = Insert( root->left, node );
+        if( root->left->priority > root->priority ) {
+            PatchIndexNode* top = root->left;
+            root->left = top->right;
+            top->right = root;
+
+            Update( root );
+            root = top;
+        }
+    } else {
+        root->right = Insert( root->right, node );
+        if( root->right->priority > root->priority ) {
+            PatchIndexNode* top = root->right;
+            root->right = top->left;
+            top->left = root;
+
+            Update( root );
+            root = top;
+        }
+    }
+
+    Update( root );
+    return root;
+}
+
+PatchIndexNode* PatchIndex::Remove( PatchIndexNode* root, PatchIndexNode* node ) {
+    if( root == nullptr ) {
+        return nullptr;
+    } else if( root == node ) {
+        return Merge( root->left, root->right );
+    }
+
+    if( Less( node, root ) ) {
+        root->left = Remove( root->left, node );
+    } else {
+        root->right = Remove( root->right, node );
+    }
+
+    Update( root );
+    return root;
+}
+
+// Every node of "a" comes before every node of "b"
+PatchIndexNode* PatchIndex::Merge( PatchIndexNode* a, PatchIndexNode* b ) {
+    if( a == nullptr ) {
+        return b;
+    } else if( b == nullptr ) {
+        return a;
+    }
+
+    if( a->priority > b->priority ) {
+        a->right = Merge( a->right, b );
+
+        Update( a );
+        return a;
+    }
+
+    b->left = Merge( a, b->left );
+
+    Update( b );
+    return b;
+}
+
+void PatchIndex::FindOverlaps( const PatchIndexNode* root, uintptr_t lower, uintptr_t upper, std::vector< MemoryPatch* > &out ) {
+    // Subtrees that end before the range are skipped whole, which is what keeps a lookup
+    // logarithmic when nothing overlaps
+    if( root == nullptr || root->maxUpper <= lower ) {
+        return;
+    }
+
+    FindOverlaps( root->left, lower, upper, out );
+
+    if( root->lower < upper ) {
+        if( root->upper > lower ) {
+            out.push_back( root->patch );
+        }
+
+        FindOverlaps( root->right, lower, upper, out );
+    }
+}
+
+void PatchIndex::GetAll( const PatchIndexNode* root, std::vector< MemoryPatch* > &out ) {
+    if( root == nullptr ) {
+        return;
+    }
+
+    GetAll( root->left, out );
+    out.push_back( root->patch );
+    GetAll( root->right, out );
+}
\ No newline at end of file
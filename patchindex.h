@@ -0,0 +1,102 @@
+/**
+ * vim: set ts=4 sw=4 tw=99 noet :
+ * =============================================================================
+ * SourceMod Source Scramble Extension
+ * 
+ * Copyright (C) 2019 nosoop
+ * Copyright (C) 2023 cravenge
+ *
+ * All rights reserved
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2", the
+ * "Source Engine", the "SourcePawn JIT" and any Game MODs that run on software
+ * by the Valve Corporation. You must obey the GNU General Public License in
+ * all respects for all other code used. Additionally, AlliedModders LLC grants
+ * this exception to all derivative works. AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>
+ *
+ * Version: $Id$
+ */
+
+#ifndef _INCLUDE_SOURCEMOD_SRCSCRMBL_PATCHINDEX_H_
+#define _INCLUDE_SOURCEMOD_SRCSCRMBL_PATCHINDEX_H_
+
+# ifndef _STDLIB_H_
+# include <stdlib.h>
+
+# endif
+# ifndef _STDINT_H
+# include "stdint.h"
+
+# endif
+#include <vector>
+
+struct MemoryPatch;
+
+// Lives inside every MemoryPatch, so enabling or disabling one never allocates
+struct PatchIndexNode {
+    MemoryPatch* patch;
+
+    uintptr_t lower;
+    uintptr_t upper;
+    uintptr_t maxUpper; // Highest upper bound in this subtree
+
+    // Order in which patches were enabled; later patches sit on top of earlier ones
+    uint64_t sequence;
+    uint32_t priority;
+
+    PatchIndexNode* left;
+    PatchIndexNode* right;
+};
+
+// Interval tree (a treap ordered by lower bound) of every enabled patch in the process,
+// regardless of which plug-in owns it
+class PatchIndex {
+public:
+    PatchIndex();
+
+    void Insert( PatchIndexNode* node, uintptr_t lower, uintptr_t upper );
+    void Remove( PatchIndexNode* node );
+
+    // Appends every enabled patch intersecting [lower, upper)
+    void FindOverlaps( uintptr_t lower, uintptr_t upper, std::vector< MemoryPatch* > &out ) const;
+
+    // Lists enabled patches by address
+    void GetAll( std::vector< MemoryPatch* > &out ) const;
+
+    size_t Count() const;
+private:
+    static void Update( PatchIndexNode* node );
+    static bool Less( const PatchIndexNode* a, const PatchIndexNode* b );
+
+    static PatchIndexNode* Insert( PatchIndexNode* root, PatchIndexNode* node );
+    static PatchIndexNode* Remove( PatchIndexNode* root, PatchIndexNode* node );
+    static PatchIndexNode* Merge( PatchIndexNode* a, PatchIndexNode* b );
+
+    static void FindOverlaps( const PatchIndexNode* root, uintptr_t lower, uintptr_t upper, std::vector< MemoryPatch* > &out );
+    static void GetAll( const PatchIndexNode* root, std::vector< MemoryPatch* > &out );
+
+    PatchIndexNode* m_Root;
+
+    uint64_t m_NextSequence;
+    size_t m_Count;
+};
+
+extern PatchIndex g_ActivePatches;
+
+#endif // _INCLUDE_SOURCEMOD_SRCSCRMBL_PATCHINDEX_H_
\ No newline at end of file
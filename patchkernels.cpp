@@ -0,0 +1,271 @@
+/**
+ * vim: set ts=4 sw=4 tw=99 noet :
+ * =============================================================================
+ * SourceMod Source Scramble Extension
+ * 
+ * Copyright (C) 2019 nosoop
+ * Copyright (C) 2023 cravenge
+ *
+ * All rights reserved
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2", the
+ * "Source Engine", the "SourcePawn JIT" and any Game MODs that run on software
+ * by the Valve Corporation. You must obey the GNU General Public License in
+ * all respects for all other code used. Additionally, AlliedModders LLC grants
+ * this exception to all derivative works. AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>
+ *
+ * Version: $Id$
+ */
+
+#include "patchkernels.h"
+
+#include "string.h"
+
+#if defined __i386__ || defined __x86_64__ || defined _M_IX86 || defined _M_X64
+#include <immintrin.h>
+
+# ifdef _MSC_VER
+# include <intrin.h>
+
+# endif
+#define KERNELS_X86
+
+#endif
+// GCC and Clang only emit SSE2/AVX2 instructions in functions that ask for them, which
+// lets 32-bit builds without -msse2 still carry the vector variants. MSVC allows the
+// intrinsics anywhere
+#ifdef __GNUC__
+#define KERNEL_TARGET( isa )	__attribute__(( target( isa ) ))
+#else
+#define KERNEL_TARGET( isa )
+#endif
+
+static bool MatchScalar( const uint8_t* mem, const uint8_t* match, const uint8_t* mask, size_t size ) {
+    uint8_t diff = 0;
+    for( size_t i = 0; i < size; i++ ) {
+        diff |= ( mem[i] ^ match[i] ) & mask[i];
+    }
+    return !diff;
+}
+
+static void ApplyScalar( uint8_t* mem, uint8_t* backup, const uint8_t* overwrite, const uint8_t* preserve, size_t size ) {
+    for( size_t i = 0; i < size; i++ ) {
+        backup[i] = mem[i];
+        mem[i] = ( overwrite[i] & ~preserve[i] ) | ( backup[i] & preserve[i] );
+    }
+}
+
+// Candidates are found by looking for one byte of the pattern that has to match exactly, then
+// checked in full. Patterns with no such byte are checked at every offset
+static size_t FindAnchor( const uint8_t* mask, size_t length ) {
+    for( size_t i = 0; i < length; i++ ) {
+        if( mask[i] == 0xFF ) {
+            return i;
+        }
+    }
+    return length;
+}
+
+// Checks every offset from "start" on, adding to the "count" offsets already found
+static size_t FindFrom( const uint8_t* mem, size_t size, const uint8_t* match, const uint8_t* mask, size_t length, size_t* found, size_t max, size_t start, size_t count ) {
+    for( size_t i = start; length <= size && i <= size - length && count < max; i++ ) {
+        if( MatchScalar( mem + i, match, mask, length ) ) {
+            found[count++] = i;
+        }
+    }
+    return count;
+}
+
+static size_t FindScalar( const uint8_t* mem, size_t size, const uint8_t* match, const uint8_t* mask, size_t length, size_t* found, size_t max ) {
+    return FindFrom( mem, size, match, mask, length, found, max, 0, 0 );
+}
+
+#ifdef KERNELS_X86
+static inline unsigned int LowestBit( unsigned int bits ) {
+# ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward( &index, bits );
+    return static_cast< unsigned int >( index );
+# else
+    return static_cast< unsigned int >( __builtin_ctz( bits ) );
+# endif
+}
+
+KERNEL_TARGET( "sse2" ) static bool MatchSSE2( const uint8_t* mem, const uint8_t* match, const uint8_t* mask, size_t size ) {
+    __m128i diff = _mm_setzero_si128();
+
+    size_t i = 0;
+    for( ; i + 16 <= size; i += 16 ) {
+        __m128i v = _mm_loadu_si128( reinterpret_cast< const __m128i* >( mem + i ) );
+        __m128i m = _mm_loadu_si128( reinterpret_cast< const __m128i* >( match + i ) );
+        __m128i k = _mm_loadu_si128( reinterpret_cast< const __m128i* >( mask + i ) );
+        diff = _mm_or_si128( diff, _mm_and_si128( _mm_xor_si128( v, m ), k ) );
+    }
+
+    if( _mm_movemask_epi8( _mm_cmpeq_epi8( diff, _mm_setzero_si128() ) ) != 0xFFFF )
+        return false;
+    return MatchScalar( mem + i, match + i, mask + i, size - i );
+}
+
+KERNEL_TARGET( "sse2" ) static void ApplySSE2( uint8_t* mem, uint8_t* backup, const uint8_t* overwrite, const uint8_t* preserve, size_t size ) {
+    size_t i = 0;
+    for( ; i + 16 <= size; i += 16 ) {
+        __m128i old = _mm_loadu_si128( reinterpret_cast< const __m128i* >( mem + i ) );
+        __m128i ovr = _mm_loadu_si128( reinterpret_cast< const __m128i* >( overwrite + i ) );
+        __m128i presv = _mm_loadu_si128( reinterpret_cast< const __m128i* >( preserve + i ) );
+
+        _mm_storeu_si128( reinterpret_cast< __m128i* >( backup + i ), old );
+        _mm_storeu_si128( reinterpret_cast< __m128i* >( mem + i ), _mm_or_si128( _mm_andnot_si128( presv, ovr ), _mm_and_si128( old, presv ) ) );
+    }
+    ApplyScalar( mem + i, backup + i, overwrite + i, preserve + i, size - i );
+}
+
+KERNEL_TARGET( "sse2" ) static size_t FindSSE2( const uint8_t* mem, size_t size, const uint8_t* match, const uint8_t* mask, size_t length, size_t* found, size_t max ) {
+    size_t anchor = FindAnchor( mask, length );
+    if( anchor == length || length > size ) {
+        return FindScalar( mem, size, match, mask, length, found, max );
+    }
+
+    __m128i needle = _mm_set1_epi8( static_cast< char >( match[anchor] ) );
+    size_t last = size - length, count = 0, i = 0;
+
+    for( ; i + 16 <= last + 1 && count < max; i += 16 ) {
+        __m128i v = _mm_loadu_si128( reinterpret_cast< const __m128i* >( mem + i + anchor ) );
+        unsigned int hits = static_cast< unsigned int >( _mm_movemask_epi8( _mm_cmpeq_epi8( v, needle ) ) );
+
+        while( hits && count < max ) {
+            size_t at = i + LowestBit( hits );
+            if( MatchSSE2( mem + at, match, mask, length ) ) {
+                found[count++] = at;
+            }
+            hits &= hits - 1;
+        }
+    }
+    return FindFrom( mem, size, match, mask, length, found, max, i, count );
+}
+
+KERNEL_TARGET( "avx2" ) static bool MatchAVX2( const uint8_t* mem, const uint8_t* match, const uint8_t* mask, size_t size ) {
+    __m256i diff = _mm256_setzero_si256();
+
+    size_t i = 0;
+    for( ; i + 32 <= size; i += 32 ) {
+        __m256i v = _mm256_loadu_si256( reinterpret_cast< const __m256i* >( mem + i ) );
+        __m256i m = _mm256_loadu_si256( reinterpret_cast< const __m256i* >( match + i ) );
+        __m256i k = _mm256_loadu_si256( reinterpret_cast< const __m256i* >( mask + i ) );
+        diff = _mm256_or_si256( diff, _mm256_and_si256( _mm256_xor_si256( v, m ), k ) );
+    }
+
+    if( !_mm256_testz_si256( diff, diff ) )
+        return false;
+
+    // The SSE2 tail is not VEX encoded; running it with the upper halves still dirty costs a
+    // state transition on every call, and GCC leaves that out before tail calls
+    _mm256_zeroupper();
+    return MatchSSE2( mem + i, match + i, mask + i, size - i );
+}
+
+KERNEL_TARGET( "avx2" ) static size_t FindAVX2( const uint8_t* mem, size_t size, const uint8_t* match, const uint8_t* mask, size_t length, size_t* found, size_t max ) {
+    size_t anchor = FindAnchor( mask, length );
+    if( anchor == length || length > size ) {
+        return FindScalar( mem, size, match, mask, length, found, max );
+    }
+
+    __m256i needle = _mm256_set1_epi8( static_cast< char >( match[anchor] ) );
+    size_t last = size - length, count = 0, i = 0;
+
+    for( ; i + 32 <= last + 1 && count < max; i += 32 ) {
+        __m256i v = _mm256_loadu_si256( reinterpret_cast< const __m256i* >( mem + i + anchor ) );
+        unsigned int hits = static_cast< unsigned int >( _mm256_movemask_epi8( _mm256_cmpeq_epi8( v, needle ) ) );
+
+        while( hits && count < max ) {
+            size_t at = i + LowestBit( hits );
+            if( MatchAVX2( mem + at, match, mask, length ) ) {
+                found[count++] = at;
+            }
+            hits &= hits - 1;
+        }
+    }
+    return FindFrom( mem, size, match, mask, length, found, max, i, count );
+}
+
+KERNEL_TARGET( "avx2" ) static void ApplyAVX2( uint8_t* mem, uint8_t* backup, const uint8_t* overwrite, const uint8_t* preserve, size_t size ) {
+    size_t i = 0;
+    for( ; i + 32 <= size; i += 32 ) {
+        __m256i old = _mm256_loadu_si256( reinterpret_cast< const __m256i* >( mem + i ) );
+        __m256i ovr = _mm256_loadu_si256( reinterpret_cast< const __m256i* >( overwrite + i ) );
+        __m256i presv = _mm256_loadu_si256( reinterpret_cast< const __m256i* >( preserve + i ) );
+
+        _mm256_storeu_si256( reinterpret_cast< __m256i* >( backup + i ), old );
+        _mm256_storeu_si256( reinterpret_cast< __m256i* >( mem + i ), _mm256_or_si256( _mm256_andnot_si256( presv, ovr ), _mm256_and_si256( old, presv ) ) );
+    }
+
+    _mm256_zeroupper();
+    ApplySSE2( mem + i, backup + i, overwrite + i, preserve + i, size - i );
+}
+
+static bool CPUSupports( bool avx2 ) {
+# ifdef _MSC_VER
+    int info[4];
+    __cpuid( info, 1 );
+    if( !avx2 )
+        return ( info[3] & ( 1 << 26 ) ) != 0;
+
+    // The OS has to save the upper halves of the YMM registers too
+    if( !( info[2] & ( 1 << 27 ) ) || ( _xgetbv( 0 ) & 6 ) != 6 )
+        return false;
+
+    __cpuid( info, 0 );
+    if( info[0] < 7 )
+        return false;
+
+    __cpuidex( info, 7, 0 );
+    return ( info[1] & ( 1 << 5 ) ) != 0;
+# else
+    __builtin_cpu_init();
+    return avx2 ? __builtin_cpu_supports( "avx2" ) : __builtin_cpu_supports( "sse2" );
+# endif
+}
+#endif
+
+static const PatchKernels s_Scalar = { MatchScalar, ApplyScalar, FindScalar, "scalar" };
+#ifdef KERNELS_X86
+static const PatchKernels s_SSE2 = { MatchSSE2, ApplySSE2, FindSSE2, "SSE2" };
+static const PatchKernels s_AVX2 = { MatchAVX2, ApplyAVX2, FindAVX2, "AVX2" };
+#endif
+
+const PatchKernels &GetPatchKernels() {
+#ifdef KERNELS_X86
+    static const PatchKernels &best = CPUSupports( true ) ? s_AVX2 : ( CPUSupports( false ) ? s_SSE2 : s_Scalar );
+    return best;
+#else
+    return s_Scalar;
+#endif
+}
+
+const PatchKernels* FindPatchKernels( const char* name ) {
+    if( !strcmp( name, s_Scalar.name ) )
+        return &s_Scalar;
+#ifdef KERNELS_X86
+    if( !strcmp( name, s_SSE2.name ) && CPUSupports( false ) )
+        return &s_SSE2;
+    if( !strcmp( name, s_AVX2.name ) && CPUSupports( true ) )
+        return &s_AVX2;
+#endif
+    return nullptr;
+}
\ No newline at end of file
@@ -0,0 +1,70 @@
+/**
+ * vim: set ts=4 sw=4 tw=99 noet :
+ * =============================================================================
+ * SourceMod Source Scramble Extension
+ * 
+ * Copyright (C) 2019 nosoop
+ * Copyright (C) 2023 cravenge
+ *
+ * All rights reserved
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2", the
+ * "Source Engine", the "SourcePawn JIT" and any Game MODs that run on software
+ * by the Valve Corporation. You must obey the GNU General Public License in
+ * all respects for all other code used. Additionally, AlliedModders LLC grants
+ * this exception to all derivative works. AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>
+ *
+ * Version: $Id$
+ */
+
+#ifndef _INCLUDE_SOURCEMOD_SRCSCRMBL_PATCHKERNELS_H_
+#define _INCLUDE_SOURCEMOD_SRCSCRMBL_PATCHKERNELS_H_
+
+# ifndef _STDLIB_H_
+# include <stdlib.h>
+
+# endif
+# ifndef _STDINT_H
+# include "stdint.h"
+
+# endif
+// Byte loops used by memory patches, in the widest variant the CPU supports
+struct PatchKernels {
+    // Compares memory against a pattern, only looking at the bits set in mask
+    bool ( *Match )( const uint8_t* mem, const uint8_t* match, const uint8_t* mask, size_t size );
+
+    // Copies memory into backup, then replaces it with overwrite except for the bits
+    // set in preserve
+    void ( *Apply )( uint8_t* mem, uint8_t* backup, const uint8_t* overwrite, const uint8_t* preserve, size_t size );
+
+    // Stores the offsets in mem where a pattern of "length" bytes matches, stopping once "max"
+    // of them were found, and returns how many there were
+    size_t ( *Find )( const uint8_t* mem, size_t size, const uint8_t* match, const uint8_t* mask, size_t length, size_t* found, size_t max );
+
+    const char* name;
+};
+
+// Picks the variant on first use
+const PatchKernels &GetPatchKernels();
+
+// Variant called "name" ("scalar", "SSE2" or "AVX2"), or null if this CPU cannot run it.
+// Only meant for comparing them, as in tests/patchkernels_bench.cpp
+const PatchKernels* FindPatchKernels( const char* name );
+
+#endif // _INCLUDE_SOURCEMOD_SRCSCRMBL_PATCHKERNELS_H_
\ No newline at end of file
@@ -0,0 +1,179 @@
+/**
+ * vim: set ts=4 sw=4 tw=99 noet :
+ * =============================================================================
+ * SourceMod Source Scramble Extension
+ * 
+ * Copyright (C) 2019 nosoop
+ * Copyright (C) 2023 cravenge
+ *
+ * All rights reserved
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2", the
+ * "Source Engine", the "SourcePawn JIT" and any Game MODs that run on software
+ * by the Valve Corporation. You must obey the GNU General Public License in
+ * all respects for all other code used. Additionally, AlliedModders LLC grants
+ * this exception to all derivative works. AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>
+ *
+ * Version: $Id$
+ */
+
+#include <sm_platform.h>
+
+#include "patchparams.h"
+#include "util.h"
+
+#include "string.h"
+
+static const struct {
+    const char* name;
+    PatchParamType type;
+} s_ParamTypes[] = {
+    { "i8",     PatchParamType_Int8 },
+    { "i16",    PatchParamType_Int16 },
+    { "i32",    PatchParamType_Int32 },
+    { "f32",    PatchParamType_Float32 },
+    { "abs32",  PatchParamType_Abs32 },
+    { "abs64",  PatchParamType_Abs64 },
+    { "ptr",    PatchParamType_Pointer },
+    { "rel32",  PatchParamType_Rel32 }
+};
+
+bool CompileOverwriteTemplate( const char* str, std::vector< uint8_t > &bytes, std::vector< PatchParam > &params ) {
+    bytes.clear();
+    params.clear();
+
+    const char* p = str;
+    while( *p ) {
+        // Plain bytes up to the next placeholder are read as before
+        const char* open = strchr( p, '{' );
+        if( open != p ) {
+            std::string plain = open != nullptr ? std::string( p, open ) : std::string( p );
+            std::vector< uint8_t > run = EscapedHexToByteVector( plain.c_str() );
+            bytes.insert( bytes.end(), run.begin(), run.end() );
+
+            if( open == nullptr )
+                break;
+            p = open;
+        }
+
+        const char* colon = strchr( p, ':' );
+        const char* close = strchr( p, '}' );
+        if( colon == nullptr || close == nullptr || colon > close || colon + 1 == close )
+            return false;
+
+        // rel32 may be followed by "+N", the number of bytes the instruction still has after
+        // the field, such as an immediate, which the displacement is measured past
+        const char* plus = static_cast< const char* >( memchr( p, '+', colon - p ) );
+        const char* typeEnd = plus != nullptr ? plus : colon;
+
+        size_t i = 0, count = sizeof( s_ParamTypes ) / sizeof( s_ParamTypes[0] );
+        while( i < count && ( strlen( s_ParamTypes[i].name ) != static_cast< size_t >( typeEnd - p - 1 ) ||
+                              strncmp( s_ParamTypes[i].name, p + 1, typeEnd - p - 1 ) ) ) {
+            i++;
+        }
+
+        if( i == count )
+            return false;
+
+        PatchParam param;
+        param.name.assign( colon + 1, close );
+        param.type = s_ParamTypes[i].type;
+        param.offset = bytes.size();
+        param.trailing = 0;
+
+        if( plus != nullptr ) {
+            char* end;
+            unsigned long trailing = strtoul( plus + 1, &end, 10 );
+            if( param.type != PatchParamType_Rel32 || end == plus + 1 || end != colon || trailing > 10 )
+                return false;
+
+            param.trailing = static_cast< size_t >( trailing );
+        }
+
+        bytes.resize( bytes.size() + GetPatchParamSize( param.type ), 0x00 );
+        params.push_back( std::move( param ) );
+
+        p = close + 1;
+    }
+    return true;
+}
+
+size_t GetPatchParamSize( PatchParamType type ) {
+    switch( type ) {
+        case PatchParamType_Int8:
+            return 1;
+        case PatchParamType_Int16:
+            return 2;
+        case PatchParamType_Abs64:
+            return 8;
+        case PatchParamType_Pointer:
+            return sizeof( void* );
+        default:
+            return 4;
+    }
+}
+
+bool EncodePatchParam( const PatchParam &param, uint64_t value, uintptr_t base, uint8_t* dest ) {
+    int64_t signedValue = static_cast< int64_t >( value );
+
+    switch( param.type ) {
+        case PatchParamType_Int8:
+            if( signedValue < INT8_MIN || signedValue > UINT8_MAX )
+                return false;
+            break;
+        case PatchParamType_Int16:
+            if( signedValue < INT16_MIN || signedValue > UINT16_MAX )
+                return false;
+            break;
+        case PatchParamType_Int32:
+        case PatchParamType_Float32:
+            if( signedValue < INT32_MIN || signedValue > UINT32_MAX )
+                return false;
+            break;
+        case PatchParamType_Abs32:
+            if( value > UINT32_MAX )
+                return false;
+            break;
+        case PatchParamType_Rel32: {
+            if( value > UINTPTR_MAX )
+                return false;
+
+            // Worked out in pointer width, so on x86 the displacement wraps around the address
+            // space just like the CPU adding it does, and every target is within reach
+            uintptr_t end = base + param.offset + 4 + param.trailing;
+            intptr_t diff = static_cast< intptr_t >( static_cast< uintptr_t >( value ) - end );
+#ifdef PLATFORM_X64
+            if( diff < INT32_MIN || diff > INT32_MAX )
+                return false;
+#endif
+
+            value = static_cast< uint64_t >( static_cast< int64_t >( diff ) );
+            break;
+        }
+        default:
+            break;
+    }
+
+    // Fields are little-endian like the code they are written into
+    size_t size = GetPatchParamSize( param.type );
+    for( size_t i = 0; i < size; i++ ) {
+        dest[i] = static_cast< uint8_t >( value >> ( i * 8 ) );
+    }
+    return true;
+}
@@ -0,0 +1,81 @@
+/**
+ * vim: set ts=4 sw=4 tw=99 noet :
+ * =============================================================================
+ * SourceMod Source Scramble Extension
+ * 
+ * Copyright (C) 2019 nosoop
+ * Copyright (C) 2023 cravenge
+ *
+ * All rights reserved
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2", the
+ * "Source Engine", the "SourcePawn JIT" and any Game MODs that run on software
+ * by the Valve Corporation. You must obey the GNU General Public License in
+ * all respects for all other code used. Additionally, AlliedModders LLC grants
+ * this exception to all derivative works. AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>
+ *
+ * Version: $Id$
+ */
+
+#ifndef _INCLUDE_SOURCEMOD_SRCSCRMBL_PATCHPARAMS_H_
+#define _INCLUDE_SOURCEMOD_SRCSCRMBL_PATCHPARAMS_H_
+
+# ifndef _STDLIB_H_
+# include <stdlib.h>
+
+# endif
+# ifndef _STDINT_H
+# include "stdint.h"
+
+# endif
+#include <string>
+#include <vector>
+
+enum PatchParamType {
+    PatchParamType_Int8,
+    PatchParamType_Int16,
+    PatchParamType_Int32,
+    PatchParamType_Float32,
+    PatchParamType_Abs32,
+    PatchParamType_Abs64,
+    PatchParamType_Pointer,     // abs32 or abs64, whichever the server is built for
+    PatchParamType_Rel32        // Displacement from the end of the instruction to the value
+};
+
+// A placeholder in "overwrite", left as zero bytes until it is bound
+struct PatchParam {
+    std::string name;
+    PatchParamType type;
+    size_t offset;
+    size_t trailing;            // Bytes of the instruction past a rel32 field
+};
+
+// Compiles an "overwrite" string into its bytes and the placeholders within them. Besides
+// plain bytes, it takes "{type:name}" where type is i8, i16, i32, f32, abs32, abs64, ptr or
+// rel32. A rel32 may be written "{rel32+N:name}" when N more bytes of its instruction follow
+// the field
+bool CompileOverwriteTemplate( const char* str, std::vector< uint8_t > &bytes, std::vector< PatchParam > &params );
+
+size_t GetPatchParamSize( PatchParamType type );
+
+// Addresses are passed in "value" as is. "base" is the address the patch is written to, which
+// rel32 displacements are computed from. Fails if the value does not fit in the field
+bool EncodePatchParam( const PatchParam &param, uint64_t value, uintptr_t base, uint8_t* dest );
+
+#endif // _INCLUDE_SOURCEMOD_SRCSCRMBL_PATCHPARAMS_H_
@@ -0,0 +1,118 @@
+/**
+ * vim: set ts=4 sw=4 tw=99 noet :
+ * =============================================================================
+ * SourceMod Source Scramble Extension
+ * 
+ * Copyright (C) 2019 nosoop
+ * Copyright (C) 2023 cravenge
+ *
+ * All rights reserved
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2", the
+ * "Source Engine", the "SourcePawn JIT" and any Game MODs that run on software
+ * by the Valve Corporation. You must obey the GNU General Public License in
+ * all respects for all other code used. Additionally, AlliedModders LLC grants
+ * this exception to all derivative works. AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>
+ *
+ * Version: $Id$
+ */
+
+#include "memorypatch.h"
+#include "memorypatchgroup.h"
+#include "pageprotect.h"
+#include "patchqueue.h"
+
+PatchQueue g_PatchQueue;
+
+PatchQueue::PatchQueue() {
+    this->m_Count = 0;
+}
+
+void PatchQueue::Request( MemoryPatch* patch, bool enable ) {
+    if( patch->queued == PatchQueued_None ) {
+        patch->queueSlot = this->m_Pending.size();
+        this->m_Pending.push_back( patch );
+        this->m_Count++;
+    }
+
+    patch->queued = enable ? PatchQueued_Enable : PatchQueued_Disable;
+}
+
+void PatchQueue::Cancel( MemoryPatch* patch ) {
+    if( patch->queued == PatchQueued_None ) {
+        return;
+    }
+
+    this->m_Pending[patch->queueSlot] = nullptr;
+    this->m_Count--;
+
+    patch->queued = PatchQueued_None;
+}
+
+size_t PatchQueue::Flush() {
+    if( this->m_Pending.empty() ) {
+        return 0;
+    }
+
+    // Toggles that cancelled each other out during the frame never reach memory
+    size_t kept = 0;
+    for( MemoryPatch* patch : this->m_Pending ) {
+        if( patch == nullptr ) {
+            continue;
+        }
+
+        if( patch->IsEnabled() == ( patch->queued == PatchQueued_Enable ) ) {
+            patch->queued = PatchQueued_None;
+            continue;
+        }
+
+        this->m_Pending[kept++] = patch;
+    }
+    this->m_Pending.resize( kept );
+
+    // One protection change per run of adjacent pages for the whole batch
+    WritableScope scope;
+    AddPatchPages( this->m_Pending, scope );
+
+    size_t changed = 0;
+    for( MemoryPatch* patch : this->m_Pending ) {
+        bool enable = patch->queued == PatchQueued_Enable;
+        patch->queued = PatchQueued_None;
+
+        if( enable ? patch->Enable( false ) : patch->Disable( false ) ) {
+            changed++;
+        } else {
+            smutils->LogError(myself, "Queued patch at %p (%s) could not be %s", patch->pAddr, patch->owner.c_str(), enable ? "enabled" : "disabled");
+        }
+    }
+
+    this->m_Pending.clear();
+    this->m_Count = 0;
+    return changed;
+}
+
+size_t PatchQueue::Count() const {
+    return this->m_Count;
+}
+
+// SourceMod runs frame hooks ahead of the engine's GameFrame, so no entity code is on the
+// stack while the batch is written
+void PatchQueue::OnGameFrame( bool simulating ) {
+    g_PatchQueue.Flush();
+}
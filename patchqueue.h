@@ -0,0 +1,79 @@
+/**
+ * vim: set ts=4 sw=4 tw=99 noet :
+ * =============================================================================
+ * SourceMod Source Scramble Extension
+ * 
+ * Copyright (C) 2019 nosoop
+ * Copyright (C) 2023 cravenge
+ *
+ * All rights reserved
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2", the
+ * "Source Engine", the "SourcePawn JIT" and any Game MODs that run on software
+ * by the Valve Corporation. You must obey the GNU General Public License in
+ * all respects for all other code used. Additionally, AlliedModders LLC grants
+ * this exception to all derivative works. AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>
+ *
+ * Version: $Id$
+ */
+
+#ifndef _INCLUDE_SOURCEMOD_SRCSCRMBL_PATCHQUEUE_H_
+#define _INCLUDE_SOURCEMOD_SRCSCRMBL_PATCHQUEUE_H_
+
+# ifndef _STDLIB_H_
+# include <stdlib.h>
+
+# endif
+#include <vector>
+
+struct MemoryPatch;
+
+enum PatchQueued {
+    PatchQueued_None,
+    PatchQueued_Enable,
+    PatchQueued_Disable
+};
+
+// Enable/Disable requests made from anywhere during a frame, applied together at the start
+// of the next one, before any game code runs. Only the last request for each patch counts,
+// and a patch that already is in the requested state by then is not touched at all
+class PatchQueue {
+public:
+    PatchQueue();
+
+    // A later request for the same patch replaces an earlier one but keeps its place
+    void Request( MemoryPatch* patch, bool enable );
+
+    // Forgets whatever is pending for a patch
+    void Cancel( MemoryPatch* patch );
+
+    // Returns how many patches actually changed state
+    size_t Flush();
+
+    size_t Count() const;
+
+    static void OnGameFrame( bool simulating );
+private:
+    std::vector< MemoryPatch* > m_Pending; // Cancelled requests leave a null behind
+    size_t m_Count;
+};
+
+extern PatchQueue g_PatchQueue;
+
+#endif // _INCLUDE_SOURCEMOD_SRCSCRMBL_PATCHQUEUE_H_
@@ -0,0 +1,172 @@
+/**
+ * vim: set ts=4 sw=4 tw=99 noet :
+ * =============================================================================
+ * SourceMod Source Scramble Extension
+ * 
+ * Copyright (C) 2019 nosoop
+ * Copyright (C) 2023 cravenge
+ *
+ * All rights reserved
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2", the
+ * "Source Engine", the "SourcePawn JIT" and any Game MODs that run on software
+ * by the Valve Corporation. You must obey the GNU General Public License in
+ * all respects for all other code used. Additionally, AlliedModders LLC grants
+ * this exception to all derivative works. AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>
+ *
+ * Version: $Id$
+ */
+
+#include "livewrite.h"
+#include "memorypatch.h"
+#include "pageprotect.h"
+#include "patchwatchdog.h"
+
+#include "string.h"
+
+#include <algorithm>
+#include <chrono>
+
+// Bytes compared between two looks at the clock
+static constexpr size_t WATCH_CHUNK = 64;
+
+static constexpr unsigned int WATCH_DEFAULT_BUDGET = 20;
+
+PatchWatchdog g_PatchWatchdog;
+
+PatchWatchdog::PatchWatchdog() {
+    this->m_Next = 0;
+    this->m_Budget = WATCH_DEFAULT_BUDGET;
+}
+
+void PatchWatchdog::Watch( MemoryPatch* patch ) {
+    if( std::find( this->m_Watched.begin(), this->m_Watched.end(), patch ) == this->m_Watched.end() ) {
+        this->m_Watched.push_back( patch );
+    }
+}
+
+void PatchWatchdog::Unwatch( MemoryPatch* patch ) {
+    auto it = std::find( this->m_Watched.begin(), this->m_Watched.end(), patch );
+    if( it == this->m_Watched.end() ) {
+        return;
+    }
+
+    // Keeps the next frame on the same patch
+    if( static_cast< size_t >( it - this->m_Watched.begin() ) < this->m_Next ) {
+        this->m_Next--;
+    }
+    this->m_Watched.erase( it );
+
+    patch->watchCursor = 0;
+}
+
+void PatchWatchdog::SetBudget( unsigned int microseconds ) {
+    this->m_Budget = microseconds;
+}
+
+unsigned int PatchWatchdog::GetBudget() const {
+    return this->m_Budget;
+}
+
+size_t PatchWatchdog::Count() const {
+    return this->m_Watched.size();
+}
+
+void PatchWatchdog::Run() {
+    if( this->m_Watched.empty() || !this->m_Budget ) {
+        return;
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds( this->m_Budget );
+
+    // Every patch is looked at no more than once per frame, however much time is left
+    for( size_t visited = 0; visited < this->m_Watched.size(); visited++ ) {
+        if( this->m_Next >= this->m_Watched.size() ) {
+            this->m_Next = 0;
+        }
+
+        MemoryPatch* patch = this->m_Watched[this->m_Next];
+        if( !patch->IsEnabled() ) {
+            patch->watchCursor = 0;
+            this->m_Next++;
+            continue;
+        }
+
+        auto mem = reinterpret_cast< const uint8_t* >( patch->pAddr );
+        size_t size = patch->staged.size();
+
+        bool drifted = false;
+        while( patch->watchCursor < size ) {
+            size_t chunk = std::min( WATCH_CHUNK, size - patch->watchCursor );
+            if( memcmp( mem + patch->watchCursor, patch->staged.data() + patch->watchCursor, chunk ) ) {
+                drifted = true;
+                break;
+            }
+            patch->watchCursor += chunk;
+
+            if( patch->watchCursor < size && std::chrono::steady_clock::now() >= deadline ) {
+                return;
+            }
+        }
+
+        patch->watchCursor = 0;
+        this->m_Next++;
+
+        if( drifted ) {
+            // May free the patch, which takes it out of the list
+            this->Drifted( patch );
+        } else {
+            patch->lastVerified = timersys->GetTickedTime();
+        }
+
+        if( std::chrono::steady_clock::now() >= deadline ) {
+            return;
+        }
+    }
+}
+
+void PatchWatchdog::Drifted( MemoryPatch* patch ) {
+    size_t size = patch->staged.size();
+
+    bool reapplied = patch->watch == PatchWatch_Reapply;
+    if( reapplied ) {
+        WritableScope scope( patch->pAddr, size );
+        WriteCode( patch->pAddr, patch->staged.data(), size );
+
+        patch->lastVerified = timersys->GetTickedTime();
+    } else {
+        // Reported once; only further changes are reported again
+        auto mem = reinterpret_cast< const uint8_t* >( patch->pAddr );
+        patch->staged.assign( mem, mem + size );
+    }
+
+    smutils->LogMessage(myself, "Patch at %p (%s) was overwritten by something else%s", patch->pAddr, patch->owner.c_str(), reapplied ? "; it has been reapplied" : "");
+
+    IPluginFunction* callback = patch->watchCallback;
+    if( callback != nullptr && callback->IsRunnable() ) {
+        callback->PushCell( static_cast< cell_t >( patch->hndl ) );
+        callback->PushCell( static_cast< cell_t >( reapplied ) );
+        callback->PushCell( patch->watchData );
+        callback->Execute( nullptr );
+    }
+}
+
+void PatchWatchdog::OnGameFrame( bool simulating ) {
+    g_PatchWatchdog.Run();
+}
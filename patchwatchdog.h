@@ -0,0 +1,83 @@
+/**
+ * vim: set ts=4 sw=4 tw=99 noet :
+ * =============================================================================
+ * SourceMod Source Scramble Extension
+ * 
+ * Copyright (C) 2019 nosoop
+ * Copyright (C) 2023 cravenge
+ *
+ * All rights reserved
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2", the
+ * "Source Engine", the "SourcePawn JIT" and any Game MODs that run on software
+ * by the Valve Corporation. You must obey the GNU General Public License in
+ * all respects for all other code used. Additionally, AlliedModders LLC grants
+ * this exception to all derivative works. AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>
+ *
+ * Version: $Id$
+ */
+
+#ifndef _INCLUDE_SOURCEMOD_SRCSCRMBL_PATCHWATCHDOG_H_
+#define _INCLUDE_SOURCEMOD_SRCSCRMBL_PATCHWATCHDOG_H_
+
+# ifndef _STDLIB_H_
+# include <stdlib.h>
+
+# endif
+#include <vector>
+
+struct MemoryPatch;
+
+// Mirrors the PatchWatch enumeration in srcscramble.inc
+enum PatchWatch {
+    PatchWatch_None,
+    PatchWatch_Report,      // Reports drift once, then takes the new bytes as the ones to expect
+    PatchWatch_Reapply      // Writes the patch back over the drifted bytes, then reports it
+};
+
+// Re-checks the bytes of watched, enabled patches a few at a time every frame, picking up
+// where the last frame ran out of time, so that bytes overwritten by someone else are
+// noticed without ever spending more than the budget in a single frame
+class PatchWatchdog {
+public:
+    PatchWatchdog();
+
+    void Watch( MemoryPatch* patch );
+    void Unwatch( MemoryPatch* patch );
+
+    // Microseconds per frame; 0 turns the watchdog off
+    void SetBudget( unsigned int microseconds );
+    unsigned int GetBudget() const;
+
+    size_t Count() const;
+
+    static void OnGameFrame( bool simulating );
+private:
+    void Run();
+    void Drifted( MemoryPatch* patch );
+
+    std::vector< MemoryPatch* > m_Watched;
+    size_t m_Next;  // Patch the next frame starts or resumes with
+
+    unsigned int m_Budget;
+};
+
+extern PatchWatchdog g_PatchWatchdog;
+
+#endif // _INCLUDE_SOURCEMOD_SRCSCRMBL_PATCHWATCHDOG_H_
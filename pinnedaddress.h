@@ -0,0 +1,91 @@
+/**
+ * vim: set ts=4 sw=4 tw=99 noet :
+ * =============================================================================
+ * SourceMod Source Scramble Extension
+ * 
+ * Copyright (C) 2019 nosoop
+ * Copyright (C) 2023 cravenge
+ *
+ * All rights reserved
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2", the
+ * "Source Engine", the "SourcePawn JIT" and any Game MODs that run on software
+ * by the Valve Corporation. You must obey the GNU General Public License in
+ * all respects for all other code used. Additionally, AlliedModders LLC grants
+ * this exception to all derivative works. AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>
+ *
+ * Version: $Id$
+ */
+
+#ifndef _INCLUDE_SOURCEMOD_SRCSCRMBL_PINNEDADDR_H_
+#define _INCLUDE_SOURCEMOD_SRCSCRMBL_PINNEDADDR_H_
+
+#include <sm_platform.h>
+
+# ifndef _STDINT_H
+# include "stdint.h"
+
+# endif
+#ifdef PLATFORM_X64
+#include "PseudoAddrManager.h"
+
+#endif
+// Pseudo address a handle gives out for memory it refers to, pinned for as long as the handle
+// lives so it keeps decoding to that memory. Asking for another address releases the last one
+class PinnedAddress {
+public:
+    PinnedAddress() : m_Addr( nullptr ), m_PseudoAddr( 0 ) {}
+    ~PinnedAddress() { this->Release(); }
+
+    PinnedAddress( const PinnedAddress& ) = delete;
+    PinnedAddress &operator=( const PinnedAddress& ) = delete;
+
+    uint32_t Get( void* addr ) {
+#ifdef PLATFORM_X64
+        if( addr != this->m_Addr ) {
+            this->Release();
+
+            // A full table hands out 0, which is also a valid address, so only one that
+            // decodes back was actually pinned
+            uint32_t paddr = pseudoAddr.Pin( addr );
+            if( pseudoAddr.FromPseudoAddress( paddr ) != addr )
+                return 0;
+
+            this->m_PseudoAddr = paddr;
+            this->m_Addr = addr;
+        }
+        return this->m_PseudoAddr;
+#else
+        return static_cast< uint32_t >( reinterpret_cast< uintptr_t >( addr ) );
+#endif
+    }
+
+    void Release() {
+#ifdef PLATFORM_X64
+        if( this->m_Addr != nullptr )
+            pseudoAddr.Unpin( this->m_PseudoAddr );
+#endif
+        this->m_Addr = nullptr;
+    }
+private:
+    void* m_Addr;
+    uint32_t m_PseudoAddr;
+};
+
+#endif // _INCLUDE_SOURCEMOD_SRCSCRMBL_PINNEDADDR_H_
\ No newline at end of file
@@ -0,0 +1,165 @@
+/**
+ * vim: set ts=4 sw=4 tw=99 noet :
+ * =============================================================================
+ * SourceMod Source Scramble Extension
+ * 
+ * Copyright (C) 2019 nosoop
+ * Copyright (C) 2023 cravenge
+ *
+ * All rights reserved
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2", the
+ * "Source Engine", the "SourcePawn JIT" and any Game MODs that run on software
+ * by the Valve Corporation. You must obey the GNU General Public License in
+ * all respects for all other code used. Additionally, AlliedModders LLC grants
+ * this exception to all derivative works. AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>
+ *
+ * Version: $Id$
+ */
+
+// Times every patch kernel variant this CPU can run against each other. Large patches show
+// raw Match/Apply throughput; the toggle runs mimic a frame that validates, enables and
+// disables a few thousand small patches, which is the byte work MemoryPatch::Enable and
+// Disable do around their page protection and live writes (those are left out, as they
+// cost the same whichever variant is picked)
+//
+// Build and run with "make -C tests bench"
+
+#include "patchkernels.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <initializer_list>
+#include <random>
+#include <vector>
+
+static const char* const s_Variants[] = { "scalar", "SSE2", "AVX2" };
+
+// Defeats dead code elimination of the Match results
+static volatile size_t s_Sink = 0;
+
+template< typename F >
+static double TimeNs( size_t rounds, F body ) {
+    auto start = std::chrono::steady_clock::now();
+    for( size_t r = 0; r < rounds; r++ ) {
+        body();
+    }
+    std::chrono::duration< double, std::nano > elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / rounds;
+}
+
+static void BenchLarge( const PatchKernels &kernels, size_t size ) {
+    std::mt19937 rng( 1 );
+    std::vector< uint8_t > mem( size ), match( size ), mask( size, 0xFF ), overwrite( size ), preserve( size ), backup( size );
+    for( size_t i = 0; i < size; i++ ) {
+        mem[i] = match[i] = static_cast< uint8_t >( rng() );
+        overwrite[i] = static_cast< uint8_t >( rng() );
+        preserve[i] = ( i % 7 ) ? 0x00 : 0x0F;
+    }
+
+    // Enough rounds for about 256MB of traffic either way
+    size_t rounds = std::max< size_t >( ( size_t( 256 ) << 20 ) / size, 1 );
+
+    double matchNs = TimeNs( rounds, [&]() {
+        s_Sink += kernels.Match( mem.data(), match.data(), mask.data(), size );
+    } );
+    double applyNs = TimeNs( rounds, [&]() {
+        kernels.Apply( mem.data(), backup.data(), overwrite.data(), preserve.data(), size );
+    } );
+
+    printf( "  %-7s %8zu bytes  Match %8.2f GB/s  Apply %8.2f GB/s\n", kernels.name, size, size / matchNs, size / applyNs );
+}
+
+struct BenchPatch {
+    size_t offset;
+    std::vector< uint8_t > match, mask, overwrite, preserve, original, staged;
+};
+
+static void BenchToggles( const PatchKernels &kernels, size_t count, size_t maxSize ) {
+    std::mt19937 rng( 2 );
+    std::vector< uint8_t > code( count * maxSize );
+    for( uint8_t &byte : code ) {
+        byte = static_cast< uint8_t >( rng() );
+    }
+
+    std::vector< BenchPatch > patches( count );
+    for( size_t i = 0; i < count; i++ ) {
+        BenchPatch &patch = patches[i];
+        size_t size = 4 + rng() % ( maxSize - 3 );
+
+        patch.offset = i * maxSize;
+        patch.match.assign( code.begin() + patch.offset, code.begin() + patch.offset + size );
+        patch.mask.assign( size, 0xFF );
+        patch.overwrite.resize( size );
+        patch.preserve.assign( size, 0x00 );
+        patch.original.resize( size );
+        patch.staged.resize( size );
+        for( size_t j = 0; j < size; j++ ) {
+            patch.overwrite[j] = static_cast< uint8_t >( rng() );
+        }
+    }
+
+    // Same steps as Validate, Enable and Disable, without the writes to real code
+    double frame = TimeNs( 2000, [&]() {
+        for( BenchPatch &patch : patches ) {
+            uint8_t* mem = code.data() + patch.offset;
+            size_t size = patch.match.size();
+
+            s_Sink += kernels.Match( mem, patch.match.data(), patch.mask.data(), size );
+
+            memcpy( patch.staged.data(), mem, size );
+            kernels.Apply( patch.staged.data(), patch.original.data(), patch.overwrite.data(), patch.preserve.data(), size );
+            memcpy( mem, patch.staged.data(), size );
+        }
+        for( BenchPatch &patch : patches ) {
+            memcpy( code.data() + patch.offset, patch.original.data(), patch.original.size() );
+        }
+    } );
+
+    printf( "  %-7s %5zu patches of 4-%zu bytes  %9.1f us/frame  %6.1f ns/toggle\n", kernels.name, count, maxSize, frame / 1000.0, frame / ( count * 2 ) );
+}
+
+int main() {
+    printf( "Picked by GetPatchKernels(): %s\n", GetPatchKernels().name );
+
+    printf( "Large patches:\n" );
+    for( size_t size : { size_t( 64 ), size_t( 4096 ), size_t( 65536 ), size_t( 1 ) << 20 } ) {
+        for( const char* name : s_Variants ) {
+            const PatchKernels* kernels = FindPatchKernels( name );
+            if( kernels != nullptr ) {
+                BenchLarge( *kernels, size );
+            }
+        }
+    }
+
+    printf( "Toggles per frame:\n" );
+    for( size_t count : { size_t( 100 ), size_t( 1000 ), size_t( 5000 ) } ) {
+        for( const char* name : s_Variants ) {
+            const PatchKernels* kernels = FindPatchKernels( name );
+            if( kernels != nullptr ) {
+                BenchToggles( *kernels, count, 64 );
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,226 @@
+/**
+ * vim: set ts=4 sw=4 tw=99 noet :
+ * =============================================================================
+ * SourceMod Source Scramble Extension
+ * 
+ * Copyright (C) 2019 nosoop
+ * Copyright (C) 2023 cravenge
+ *
+ * All rights reserved
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2", the
+ * "Source Engine", the "SourcePawn JIT" and any Game MODs that run on software
+ * by the Valve Corporation. You must obey the GNU General Public License in
+ * all respects for all other code used. Additionally, AlliedModders LLC grants
+ * this exception to all derivative works. AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>
+ *
+ * Version: $Id$
+ */
+
+// Hammers PseudoAddressManager from several threads at once. Every worker translates
+// addresses inside its own mappings back and forth, and checks that a pseudo address plus
+// an offset that stays within the same 16MB window of the mapping decodes to the real
+// address plus that offset. A churn thread keeps mapping, pinning and unmapping memory so
+// the region map is refreshed and chunk entries are retired and revived under the workers'
+// feet, and checks that an address whose entry was retired never decodes to anything but
+// null or the memory it was made for
+//
+// Build and run with "make -C tests SOURCEMOD=/path/to/sourcemod"
+
+#include <sm_platform.h>
+
+#include "PseudoAddrManager.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <random>
+#include <thread>
+#include <vector>
+
+static std::atomic< bool > s_Stop( false );
+static std::atomic< uint64_t > s_Checks( 0 );
+static std::atomic< uint64_t > s_Failures( 0 );
+static std::atomic< uint64_t > s_Full( 0 );
+
+// "full" accepts a null address, which is what a table with no room left hands out
+static void Check( void* expected, uint32_t paddr, const char* what, bool full = false ) {
+    void* decoded = pseudoAddr.FromPseudoAddress( paddr );
+    if( full && !paddr && decoded != expected ) {
+        s_Full.fetch_add( 1, std::memory_order_relaxed );
+    } else if( decoded != expected ) {
+        if( s_Failures++ < 10 )
+            fprintf( stderr, "%s: %p encoded as %08x decodes to %p\n", what, expected, paddr, decoded );
+    }
+    s_Checks.fetch_add( 1, std::memory_order_relaxed );
+}
+
+// Another address in the same 16MB window of the mapping, counted from its first 256KB chunk
+static uint8_t* PickNeighbour( std::mt19937 &rng, uint8_t* map, size_t size, uint8_t* addr ) {
+    const uintptr_t window = uintptr_t( 16 ) << 20;
+
+    uintptr_t origin = reinterpret_cast< uintptr_t >( map ) & ~( ( uintptr_t( 1 ) << 18 ) - 1 );
+    uintptr_t lower = origin + ( reinterpret_cast< uintptr_t >( addr ) - origin ) / window * window;
+    uintptr_t upper = std::min( lower + window, reinterpret_cast< uintptr_t >( map ) + size );
+    lower = std::max( lower, reinterpret_cast< uintptr_t >( map ) );
+
+    return reinterpret_cast< uint8_t* >( lower + rng() % ( upper - lower ) );
+}
+
+typedef std::vector< std::pair< uint8_t*, size_t > > Mappings;
+
+static const size_t s_Guard = 4096;
+
+// A few small mappings that fit an allocation base, and one large enough that addresses past
+// its first 64MB need chunks. Each one sits between inaccessible guard pages, or the kernel
+// would merge it with its neighbours into a single region. They are all made before anything
+// is translated, since the cached region map only learns about new mappings on a miss.
+//
+// Every 4MB of them is pinned for the whole run, so the workers' Pin/Unpin pairs never
+// retire the entries their other translations rely on
+static Mappings MapWorkerMemory( std::vector< uint32_t > &pins ) {
+    Mappings maps;
+    for( size_t size : { size_t( 64 ) << 10, size_t( 1 ) << 20, size_t( 96 ) << 20 } ) {
+        void* mem = mmap( nullptr, size + 2 * s_Guard, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+        if( mem == MAP_FAILED || mprotect( static_cast< uint8_t* >( mem ) + s_Guard, size, PROT_READ | PROT_WRITE ) ) {
+            perror( "mmap" );
+            exit( 1 );
+        }
+        maps.emplace_back( static_cast< uint8_t* >( mem ) + s_Guard, size );
+
+        for( size_t offset = 0; offset < size; offset += size_t( 4 ) << 20 ) {
+            pins.push_back( pseudoAddr.Pin( maps.back().first + offset ) );
+        }
+    }
+    return maps;
+}
+
+static void Worker( unsigned int seed, const Mappings &maps ) {
+    std::mt19937 rng( seed );
+
+    while( !s_Stop.load( std::memory_order_relaxed ) ) {
+        const auto &map = maps[rng() % maps.size()];
+        uint8_t* addr = map.first + rng() % map.second;
+
+        if( rng() % 8 ) {
+            uint32_t paddr = pseudoAddr.ToPseudoAddress( addr );
+            Check( addr, paddr, "ToPseudoAddress" );
+
+            uint8_t* other = PickNeighbour( rng, map.first, map.second, addr );
+            Check( other, paddr + static_cast< uint32_t >( other - addr ), "Offset" );
+        } else {
+            uint32_t paddr = pseudoAddr.Pin( addr );
+            Check( addr, paddr, "Pin" );
+            pseudoAddr.Unpin( paddr );
+        }
+    }
+}
+
+// Every new mapping misses the cached region map and takes a new chunk entry, which is
+// retired again once unpinned. The kernel keeps handing out the same few addresses, so
+// most of them are revived rather than added
+static void Churn() {
+    // Mappings are kept alive for a while so the kernel does not keep handing out the
+    // same address
+    struct Slot {
+        void* mem;
+        uint32_t paddr;
+        bool pinned;
+    };
+    Slot ring[256] = {};
+
+    for( unsigned int i = 0; !s_Stop.load( std::memory_order_relaxed ); i++ ) {
+        Slot &slot = ring[i % 256];
+        if( slot.mem != nullptr && slot.pinned ) {
+            // Retired by now, unless a revival for the same memory beat us to it
+            void* decoded = pseudoAddr.FromPseudoAddress( slot.paddr );
+            if( decoded != nullptr && decoded != slot.mem && s_Failures++ < 10 )
+                fprintf( stderr, "Retired: %p encoded as %08x decodes to %p\n", slot.mem, slot.paddr, decoded );
+        }
+
+        if( slot.mem != nullptr )
+            munmap( slot.mem, 64 << 10 );
+
+        void* mem = slot.mem = mmap( nullptr, 64 << 10, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+        if( mem == MAP_FAILED ) {
+            slot.mem = nullptr;
+            continue;
+        }
+
+        slot.paddr = pseudoAddr.Pin( mem );
+        slot.pinned = pseudoAddr.FromPseudoAddress( slot.paddr ) == mem;
+        Check( mem, slot.paddr, "Pin (churn)", true );
+        if( slot.pinned )
+            pseudoAddr.Unpin( slot.paddr );
+    }
+
+    for( const Slot &slot : ring ) {
+        if( slot.mem != nullptr )
+            munmap( slot.mem, 64 << 10 );
+    }
+}
+
+int main( int argc, char** argv ) {
+    unsigned int numThreads = argc > 1 ? static_cast< unsigned int >( atoi( argv[1] ) ) : 8;
+    unsigned int seconds = argc > 2 ? static_cast< unsigned int >( atoi( argv[2] ) ) : 3;
+
+    std::vector< uint32_t > pins;
+    std::vector< Mappings > maps;
+    for( unsigned int i = 0; i < numThreads; i++ ) {
+        maps.push_back( MapWorkerMemory( pins ) );
+    }
+
+    std::vector< std::thread > threads;
+    for( unsigned int i = 0; i < numThreads; i++ ) {
+        threads.emplace_back( Worker, 1234 + i, std::cref( maps[i] ) );
+    }
+    threads.emplace_back( Churn );
+
+    std::this_thread::sleep_for( std::chrono::seconds( seconds ) );
+    s_Stop = true;
+
+    for( std::thread &thread : threads ) {
+        thread.join();
+    }
+
+    for( uint32_t paddr : pins ) {
+        pseudoAddr.Unpin( paddr );
+    }
+
+    for( const Mappings &worker : maps ) {
+        for( const auto &map : worker ) {
+            munmap( map.first - s_Guard, map.second + 2 * s_Guard );
+        }
+    }
+
+    PseudoAddressManager::Usage usage;
+    pseudoAddr.GetUsage( usage );
+
+    printf( "%u threads, %llu translations, %llu failures, %llu refused by a full table\n", numThreads,
+            static_cast< unsigned long long >( s_Checks.load() ), static_cast< unsigned long long >( s_Failures.load() ),
+            static_cast< unsigned long long >( s_Full.load() ) );
+    printf( "bases %u/%u, chunks %u/%u, retired %u, evictions %u, failed lookups %u\n", usage.primaryUsed, usage.primaryCapacity,
+            usage.chunksUsed, usage.chunksCapacity, usage.retired, usage.evictions, usage.failures );
+    return s_Failures.load() ? 1 : 0;
+}
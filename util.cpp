@@ -33,11 +33,29 @@
  * Version: $Id$
  */
 
+#include <sm_platform.h>
+
 #include "util.h"
+#include "smsdk_ext.h"
 
 #include "stdlib.h"
 #include "string.h"
 
+#if defined PLATFORM_LINUX
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+#elif defined PLATFORM_APPLE
+#include <mach/mach.h>
+
+#endif
+
 std::vector< uint8_t > EscapedHexToByteVector( const char* str ) {
     std::vector< uint8_t > payload;
 
@@ -54,4 +72,272 @@ std::vector< uint8_t > EscapedHexToByteVector( const char* str ) {
 
     free( tmp );
     return payload;
+}
+
+static inline int HexDigitValue( char c ) {
+    if( c >= '0' && c <= '9' )
+        return c - '0';
+    if( c >= 'a' && c <= 'f' )
+        return c - 'a' + 10;
+    if( c >= 'A' && c <= 'F' )
+        return c - 'A' + 10;
+    return -1;
+}
+
+// Parses a "match" string into the bytes to compare and the bits of each byte that
+// matter. Besides plain bytes, "??" matches any byte, "4?" or "?4" any byte with that
+// nibble and "C0/F8" any byte whose bits under F8 equal C0. A lone \x2A still matches
+// any byte like in SourceMod signatures; \x2A/FF matches it literally
+bool ParseMatchPattern( const char* str, std::vector< uint8_t > &value, std::vector< uint8_t > &mask ) {
+    value.clear();
+    mask.clear();
+
+    const char* p = str;
+    while( *p ) {
+        if( *p == '\\' || *p == 'x' || *p == ' ' ) {
+            p++;
+            continue;
+        }
+
+        uint8_t val = 0, msk = 0;
+        int digits = 0;
+        bool wild = false;
+        while( digits < 2 && ( *p == '?' || HexDigitValue( *p ) != -1 ) ) {
+            val <<= 4;
+            msk <<= 4;
+            if( *p == '?' ) {
+                wild = true;
+            } else {
+                val |= HexDigitValue( *p );
+                msk |= 0x0F;
+            }
+
+            p++;
+            digits++;
+        }
+
+        if( !digits )
+            return false;
+
+        if( *p == '/' ) {
+            if( wild )
+                return false;
+
+            p++;
+
+            int maskDigits = 0;
+            msk = 0;
+            while( maskDigits < 2 && HexDigitValue( *p ) != -1 ) {
+                msk = static_cast< uint8_t >( ( msk << 4 ) | HexDigitValue( *p ) );
+
+                p++;
+                maskDigits++;
+            }
+
+            if( !maskDigits )
+                return false;
+        } else if( digits == 1 ) {
+            msk = wild ? 0x00 : 0xFF;
+        } else if( !wild && val == 0x2A ) {
+            msk = 0x00;
+        }
+
+        value.emplace_back( val );
+        mask.emplace_back( msk );
+    }
+    return true;
+}
+
+size_t GetNumberTypeByteCount( int type ) {
+    switch( type ) {
+        case NumberType_Int8:
+            return 1;
+        case NumberType_Int16:
+            return 2;
+        case NumberType_Int32:
+            return 4;
+    }
+    return 0;
+}
+
+#if defined PLATFORM_LINUX
+// Seccomp filters and some container runtimes refuse process_vm_readv/writev outright. Memory
+// then goes through a pipe instead: the kernel reads "src" as it is written into the pipe and
+// writes "dest" as it is read back out, and fails with EFAULT on bad memory either way
+static constexpr size_t PIPE_COPY_PAGE = 0x1000;
+
+static std::atomic< bool > s_ProcessVmRefused( false );
+static std::mutex s_PipeLock;
+static int s_Pipe[2] = { -1, -1 };
+
+static bool IsProcessVmRefused( const char* name ) {
+    int error = errno;
+    if( error != EPERM && error != ENOSYS )
+        return false;
+
+    if( !s_ProcessVmRefused.exchange( true ) )
+        smutils->LogError(myself, "%s failed (%s), copying memory through a pipe from now on", name, strerror( error ));
+    return true;
+}
+
+// Goes a page at a time so a fault only ever cuts the copy short at a page boundary
+static size_t CopyThroughPipe( void* dest, const void* src, size_t size ) {
+    std::lock_guard< std::mutex > lock( s_PipeLock );
+
+    if( s_Pipe[0] == -1 && pipe2( s_Pipe, O_CLOEXEC | O_NONBLOCK ) != 0 ) {
+        s_Pipe[0] = s_Pipe[1] = -1;
+        return 0;
+    }
+
+    uintptr_t from = reinterpret_cast< uintptr_t >( src ), to = reinterpret_cast< uintptr_t >( dest );
+
+    size_t copied = 0;
+    while( copied < size ) {
+        size_t piece = std::min( { size - copied, PIPE_COPY_PAGE - ( ( from + copied ) & ( PIPE_COPY_PAGE - 1 ) ), PIPE_COPY_PAGE - ( ( to + copied ) & ( PIPE_COPY_PAGE - 1 ) ) } );
+
+        ssize_t numIn = write( s_Pipe[1], reinterpret_cast< const void* >( from + copied ), piece );
+        if( numIn <= 0 )
+            break;
+
+        ssize_t numOut = read( s_Pipe[0], reinterpret_cast< void* >( to + copied ), static_cast< size_t >( numIn ) );
+        if( numOut < numIn ) {
+            // The next copy has to start from an empty pipe
+            uint8_t rest[PIPE_COPY_PAGE];
+            while( read( s_Pipe[0], rest, sizeof( rest ) ) > 0 ) {}
+
+            if( numOut > 0 )
+                copied += static_cast< size_t >( numOut );
+            break;
+        }
+
+        copied += static_cast< size_t >( numIn );
+        if( static_cast< size_t >( numIn ) < piece )
+            break;
+    }
+    return copied;
+}
+
+#endif
+// Copies memory that may not be mapped or readable without faulting. Returns how many bytes
+// could be copied, which is only ever less than "size" when a fault was hit.
+size_t ReadMemorySafe( void* dest, const void* src, size_t size ) {
+#if defined PLATFORM_WINDOWS
+    SIZE_T numRead = 0;
+    if( !ReadProcessMemory( GetCurrentProcess(), src, dest, size, &numRead ) )
+        return static_cast< size_t >( numRead );
+
+    return size;
+#elif defined PLATFORM_LINUX
+    if( s_ProcessVmRefused.load( std::memory_order_relaxed ) )
+        return CopyThroughPipe( dest, src, size );
+
+    struct iovec local = { dest, size };
+    struct iovec remote = { const_cast< void* >( src ), size };
+
+    ssize_t numRead = process_vm_readv( getpid(), &local, 1, &remote, 1, 0 );
+    if( numRead < 0 )
+        return IsProcessVmRefused( "process_vm_readv" ) ? CopyThroughPipe( dest, src, size ) : 0;
+
+    return static_cast< size_t >( numRead );
+#elif defined PLATFORM_APPLE
+    vm_size_t numRead = 0;
+    if( vm_read_overwrite( mach_task_self(), reinterpret_cast< vm_address_t >( src ), size, reinterpret_cast< vm_address_t >( dest ), &numRead ) != KERN_SUCCESS )
+        return 0;
+
+    return static_cast< size_t >( numRead );
+#endif
+}
+
+// Counterpart of ReadMemorySafe() which also refuses to write to memory that is not writable,
+// so code and read-only data are left alone
+size_t WriteMemorySafe( void* dest, const void* src, size_t size ) {
+#if defined PLATFORM_LINUX
+    if( s_ProcessVmRefused.load( std::memory_order_relaxed ) )
+        return CopyThroughPipe( dest, src, size );
+
+    struct iovec local = { const_cast< void* >( src ), size };
+    struct iovec remote = { dest, size };
+
+    ssize_t numWritten = process_vm_writev( getpid(), &local, 1, &remote, 1, 0 );
+    if( numWritten < 0 )
+        return IsProcessVmRefused( "process_vm_writev" ) ? CopyThroughPipe( dest, src, size ) : 0;
+
+    return static_cast< size_t >( numWritten );
+#else
+    uintptr_t addr = reinterpret_cast< uintptr_t >( dest );
+    uintptr_t end = addr + size;
+
+    // Only the leading writable part of the range is written
+    uintptr_t writableEnd = addr;
+    while( writableEnd < end ) {
+# if defined PLATFORM_WINDOWS
+        MEMORY_BASIC_INFORMATION info;
+        if( !VirtualQuery( reinterpret_cast< void* >( writableEnd ), &info, sizeof( MEMORY_BASIC_INFORMATION ) ) )
+            break;
+
+        if( info.State != MEM_COMMIT || ( info.Protect & ( PAGE_GUARD | PAGE_NOACCESS ) ) ||
+            !( info.Protect & ( PAGE_READWRITE | PAGE_WRITECOPY | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE_WRITECOPY ) ) )
+            break;
+
+        writableEnd = reinterpret_cast< uintptr_t >( info.BaseAddress ) + info.RegionSize;
+# elif defined PLATFORM_APPLE
+        vm_address_t regionAddr = static_cast< vm_address_t >( writableEnd );
+        vm_size_t regionSize;
+
+        vm_region_basic_info_data_64_t info;
+        mach_msg_type_number_t count = VM_REGION_BASIC_INFO_COUNT_64;
+        memory_object_name_t obj;
+
+        if( vm_region_64( mach_task_self(), &regionAddr, &regionSize, VM_REGION_BASIC_INFO_64, reinterpret_cast< vm_region_info_64_t >( &info ), &count, &obj ) != KERN_SUCCESS )
+            break;
+
+        // vm_region_64() skips ahead to the next region if the address is unmapped
+        if( regionAddr > writableEnd || !( info.protection & VM_PROT_WRITE ) )
+            break;
+
+        writableEnd = regionAddr + regionSize;
+# endif
+    }
+
+    if( writableEnd <= addr )
+        return 0;
+
+    size_t numWritten = ( writableEnd < end ) ? static_cast< size_t >( writableEnd - addr ) : size;
+    memcpy( dest, src, numWritten );
+    return numWritten;
+#endif
+}
+
+// Copies a NUL-terminated string of at most maxChars characters into a buffer that can hold
+// maxChars + 1 bytes. Memory is read a page at a time so that a string ending right before
+// an unmapped page is still copied in full. Returns false if unreadable memory came first.
+bool ReadStringSafe( char* dest, const void* src, size_t maxChars, size_t &length ) {
+    const size_t pageSize = 0x1000;
+
+    uintptr_t addr = reinterpret_cast< uintptr_t >( src );
+    bool readable = true;
+
+    length = 0;
+    while( length < maxChars ) {
+        size_t piece = pageSize - ( ( addr + length ) & ( pageSize - 1 ) );
+        if( piece > maxChars - length )
+            piece = maxChars - length;
+
+        size_t numRead = ReadMemorySafe( dest + length, reinterpret_cast< const void* >( addr + length ), piece );
+
+        const char* nul = static_cast< const char* >( memchr( dest + length, '\0', numRead ) );
+        if( nul != nullptr ) {
+            length = static_cast< size_t >( nul - dest );
+            return true;
+        }
+
+        length += numRead;
+        if( numRead < piece ) {
+            readable = false;
+            break;
+        }
+    }
+
+    dest[length] = '\0';
+    return readable;
 }
\ No newline at end of file
@@ -36,12 +36,32 @@
 #ifndef _INCLUDE_SOURCEMOD_SRCSCRMBL_UTIL_H_
 #define _INCLUDE_SOURCEMOD_SRCSCRMBL_UTIL_H_
 
+# ifndef _STDLIB_H_
+# include <stdlib.h>
+
+# endif
 # ifndef _STDINT_H
 # include "stdint.h"
 
 # endif
 #include <vector>
 
+// Mirrors the NumberType enumeration used by LoadFromAddress and StoreToAddress
+enum NumberType {
+    NumberType_Int8,
+    NumberType_Int16,
+    NumberType_Int32
+};
+
 std::vector< uint8_t > EscapedHexToByteVector( const char* str );
 
+bool ParseMatchPattern( const char* str, std::vector< uint8_t > &value, std::vector< uint8_t > &mask );
+
+size_t GetNumberTypeByteCount( int type );
+
+size_t ReadMemorySafe( void* dest, const void* src, size_t size );
+size_t WriteMemorySafe( void* dest, const void* src, size_t size );
+
+bool ReadStringSafe( char* dest, const void* src, size_t maxChars, size_t &length );
+
 #endif // _INCLUDE_SOURCEMOD_SRCSCRMBL_UTIL_H_
\ No newline at end of file
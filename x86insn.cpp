@@ -0,0 +1,572 @@
+/**
+ * vim: set ts=4 sw=4 tw=99 noet :
+ * =============================================================================
+ * SourceMod Source Scramble Extension
+ * 
+ * Copyright (C) 2019 nosoop
+ * Copyright (C) 2023 cravenge
+ *
+ * All rights reserved
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2", the
+ * "Source Engine", the "SourcePawn JIT" and any Game MODs that run on software
+ * by the Valve Corporation. You must obey the GNU General Public License in
+ * all respects for all other code used. Additionally, AlliedModders LLC grants
+ * this exception to all derivative works. AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>
+ *
+ * Version: $Id$
+ */
+
+#include <sm_platform.h>
+
+#include "x86insn.h"
+#include "util.h"
+
+#include "string.h"
+
+#ifdef PLATFORM_X64
+static constexpr bool INSN_X64 = true;
+#else
+static constexpr bool INSN_X64 = false;
+#endif
+
+// What follows an opcode byte
+enum InsnOperands {
+    Operands_None = 0,
+    Operands_ModRM = 1 << 0,
+    Operands_Imm8 = 1 << 1,
+    Operands_Imm16 = 1 << 2,
+    Operands_Imm32 = 1 << 3,
+    Operands_ImmZ = 1 << 4,     // 16 or 32 bits, by operand size
+    Operands_ImmV = 1 << 5,     // 16, 32 or 64 bits, by operand size (MOV r, imm)
+    Operands_Rel = 1 << 6,      // Like ImmZ, but always 32 bits on x86_64
+    Operands_MOffs = 1 << 7,    // Address-sized offset
+    Operands_Far = 1 << 8,      // ptr16:16 or ptr16:32
+    Operands_Invalid = 1 << 9,
+    Operands_Rel8 = 1 << 10     // Short branch
+};
+
+static unsigned int OneByteOperands( uint8_t op, bool x64 ) {
+    if( op < 0x40 ) {
+        switch( op & 7 ) {
+        case 4:
+            return Operands_Imm8;
+        case 5:
+            return Operands_ImmZ;
+        case 6:
+        case 7:
+            // Segment pushes/pops and BCD adjustments; prefixes and 0F never get here
+            return x64 ? Operands_Invalid : Operands_None;
+        default:
+            return Operands_ModRM;
+        }
+    }
+
+    // INC/DEC (REX on x86_64, which never gets here), PUSH/POP r
+    if( op < 0x60 ) {
+        return Operands_None;
+    }
+
+    if( op >= 0x70 && op <= 0x7F ) {
+        return Operands_Rel8;
+    } else if( op >= 0x84 && op <= 0x8F ) {
+        return Operands_ModRM;
+    } else if( op >= 0x90 && op <= 0x9F ) {
+        return op == 0x9A ? ( x64 ? Operands_Invalid : Operands_Far ) : Operands_None;
+    } else if( op >= 0xA0 && op <= 0xA3 ) {
+        return Operands_MOffs;
+    } else if( op >= 0xB0 && op <= 0xB7 ) {
+        return Operands_Imm8;
+    } else if( op >= 0xB8 && op <= 0xBF ) {
+        return Operands_ImmV;
+    } else if( op >= 0xD8 && op <= 0xDF ) {
+        return Operands_ModRM;
+    } else if( op >= 0xE0 && op <= 0xE3 ) {
+        return Operands_Rel8;
+    } else if( op >= 0xE4 && op <= 0xE7 ) {
+        return Operands_Imm8;
+    }
+
+    switch( op ) {
+    case 0x60:
+    case 0x61:
+    case 0xCE:
+    case 0xD6:
+        return x64 ? Operands_Invalid : Operands_None;
+    case 0x62:
+    case 0xC4:
+    case 0xC5:
+        // Only reached when not a VEX/EVEX prefix
+        return x64 ? Operands_Invalid : Operands_ModRM;
+    case 0x63:
+    case 0xD0:
+    case 0xD1:
+    case 0xD2:
+    case 0xD3:
+    case 0xF6:
+    case 0xF7:
+    case 0xFE:
+    case 0xFF:
+        return Operands_ModRM;
+    case 0x68:
+    case 0xA9:
+        return Operands_ImmZ;
+    case 0x69:
+    case 0x81:
+    case 0xC7:
+        return Operands_ModRM | Operands_ImmZ;
+    case 0x6A:
+    case 0xA8:
+    case 0xCD:
+        return Operands_Imm8;
+    case 0xEB:
+        return Operands_Rel8;
+    case 0x6B:
+    case 0x80:
+    case 0x83:
+    case 0xC0:
+    case 0xC1:
+    case 0xC6:
+        return Operands_ModRM | Operands_Imm8;
+    case 0x82:
+        return x64 ? Operands_Invalid : Operands_ModRM | Operands_Imm8;
+    case 0xC2:
+    case 0xCA:
+        return Operands_Imm16;
+    case 0xC8:
+        return Operands_Imm16 | Operands_Imm8;
+    case 0xD4:
+    case 0xD5:
+        return x64 ? Operands_Invalid : Operands_Imm8;
+    case 0xE8:
+    case 0xE9:
+        return Operands_Rel;
+    case 0xEA:
+        return x64 ? Operands_Invalid : Operands_Far;
+    default:
+        return Operands_None;
+    }
+}
+
+static unsigned int TwoByteOperands( uint8_t op ) {
+    if( op >= 0x80 && op <= 0x8F ) {
+        return Operands_Rel;
+    } else if( op >= 0xC8 && op <= 0xCF ) {
+        return Operands_None;
+    } else if( op >= 0x30 && op <= 0x37 ) {
+        return Operands_None;
+    }
+
+    switch( op ) {
+    case 0x04:
+    case 0x0A:
+    case 0x0C:
+    case 0x24:
+    case 0x25:
+    case 0x26:
+    case 0x27:
+    case 0x39:
+    case 0x3B:
+    case 0x3C:
+    case 0x3D:
+    case 0x3E:
+    case 0x3F:
+    case 0x7A:
+    case 0x7B:
+    case 0xA6:
+    case 0xA7:
+        return Operands_Invalid;
+    case 0x05:
+    case 0x06:
+    case 0x07:
+    case 0x08:
+    case 0x09:
+    case 0x0B:
+    case 0x0E:
+    case 0x77:
+    case 0xA0:
+    case 0xA1:
+    case 0xA2:
+    case 0xA8:
+    case 0xA9:
+    case 0xAA:
+        return Operands_None;
+    case 0x0F:      // 3DNow! puts its opcode where the immediate would be
+    case 0x70:
+    case 0x71:
+    case 0x72:
+    case 0x73:
+    case 0xA4:
+    case 0xAC:
+    case 0xBA:
+    case 0xC2:
+    case 0xC4:
+    case 0xC5:
+    case 0xC6:
+        return Operands_ModRM | Operands_Imm8;
+    default:
+        return Operands_ModRM;
+    }
+}
+
+// VEX (maps 1-3) and EVEX (maps 1-3, 5 and 6) encoded instructions
+static unsigned int VexOperands( unsigned int map, uint8_t op ) {
+    switch( map ) {
+    case 1:
+        if( op == 0x77 ) {
+            return Operands_None;   // VZEROUPPER/VZEROALL
+        } else if( ( op >= 0x70 && op <= 0x73 ) || op == 0xC2 || ( op >= 0xC4 && op <= 0xC6 ) ) {
+            return Operands_ModRM | Operands_Imm8;
+        }
+        return Operands_ModRM;
+    case 2:
+    case 5:
+    case 6:
+        return Operands_ModRM;
+    case 3:
+        return Operands_ModRM | Operands_Imm8;
+    default:
+        return Operands_Invalid;
+    }
+}
+
+static size_t DecodeLength( const uint8_t* code, size_t size, bool x64, X86Instruction* insn = nullptr ) {
+    if( insn != nullptr ) {
+        insn->ripDisp = 0;
+        insn->rel = 0;
+        insn->relSize = 0;
+    }
+
+    if( size > X86_MAX_INSN_LENGTH ) {
+        size = X86_MAX_INSN_LENGTH;
+    }
+
+    size_t i = 0;
+    bool opsize16 = false, addrPrefix = false, rexW = false;
+
+    for( ;; i++ ) {
+        if( i >= size ) {
+            return 0;
+        }
+
+        uint8_t b = code[i];
+        if( b == 0x66 ) {
+            opsize16 = true;
+        } else if( b == 0x67 ) {
+            addrPrefix = true;
+        } else if( b != 0xF0 && b != 0xF2 && b != 0xF3 && b != 0x26 && b != 0x2E && b != 0x36 && b != 0x3E && b != 0x64 && b != 0x65 ) {
+            break;
+        }
+    }
+
+    // Only the REX right before the opcode counts
+    while( x64 && ( code[i] & 0xF0 ) == 0x40 ) {
+        rexW = ( code[i] & 0x08 ) != 0;
+        if( ++i >= size ) {
+            return 0;
+        }
+    }
+
+    uint8_t op = code[i++];
+    bool oneByte = false;
+    unsigned int operands;
+
+    // Outside of x86_64, C4/C5/62 are only VEX/EVEX when their next byte could not be a ModRM
+    // with a memory operand, which LES/LDS/BOUND require
+    bool vexLike = i < size && ( x64 || ( code[i] & 0xC0 ) == 0xC0 );
+
+    if( op == 0x0F ) {
+        if( i >= size ) {
+            return 0;
+        }
+
+        op = code[i++];
+        if( op == 0x38 || op == 0x3A ) {
+            operands = op == 0x3A ? Operands_ModRM | Operands_Imm8 : Operands_ModRM;
+            if( i++ >= size ) {
+                return 0;
+            }
+        } else {
+            operands = TwoByteOperands( op );
+        }
+    } else if( ( op == 0xC4 || op == 0xC5 ) && vexLike ) {
+        unsigned int map = 1;
+        if( op == 0xC4 ) {
+            map = code[i] & 0x1F;
+            i++;
+        }
+        i++;
+
+        if( i >= size ) {
+            return 0;
+        }
+        operands = VexOperands( map, code[i++] );
+    } else if( op == 0x62 && vexLike ) {
+        unsigned int map = code[i] & 0x07;
+        i += 3;
+
+        if( i >= size ) {
+            return 0;
+        }
+        operands = VexOperands( map, code[i++] ) | Operands_ModRM;
+    } else if( op == 0x8F && i < size && ( code[i] & 0x1F ) >= 8 ) {
+        // XOP, which otherwise shares its opcode with POP r/m
+        unsigned int map = code[i] & 0x1F;
+        i += 2;
+
+        if( i++ >= size ) {
+            return 0;
+        }
+        operands = map == 8 ? Operands_ModRM | Operands_Imm8 : ( map == 9 ? Operands_ModRM : ( map == 10 ? Operands_ModRM | Operands_Imm32 : Operands_Invalid ) );
+    } else {
+        oneByte = true;
+        operands = OneByteOperands( op, x64 );
+    }
+
+    if( operands & Operands_Invalid ) {
+        return 0;
+    }
+
+    if( operands & Operands_ModRM ) {
+        if( i >= size ) {
+            return 0;
+        }
+
+        uint8_t modrm = code[i++];
+        uint8_t mod = modrm >> 6, reg = ( modrm >> 3 ) & 7, rm = modrm & 7;
+
+        // TEST is the only member of group 3 with an immediate
+        if( oneByte && ( op == 0xF6 || op == 0xF7 ) && reg < 2 ) {
+            operands |= op == 0xF6 ? Operands_Imm8 : Operands_ImmZ;
+        }
+
+        if( mod != 3 ) {
+            if( !x64 && addrPrefix ) {
+                if( mod == 0 && rm == 6 ) {
+                    i += 2;
+                } else {
+                    i += mod;
+                }
+            } else {
+                if( rm == 4 ) {
+                    if( i >= size ) {
+                        return 0;
+                    }
+
+                    uint8_t sib = code[i++];
+                    if( mod == 0 && ( sib & 7 ) == 5 ) {
+                        i += 4;
+                    }
+                } else if( mod == 0 && rm == 5 ) {
+                    // Relative to the next instruction on x86_64, absolute otherwise
+                    if( x64 && insn != nullptr ) {
+                        insn->ripDisp = i;
+                    }
+                    i += 4;
+                }
+
+                if( mod == 1 ) {
+                    i += 1;
+                } else if( mod == 2 ) {
+                    i += 4;
+                }
+            }
+        }
+    }
+
+    size_t immz = opsize16 && !rexW ? 2 : 4;
+    if( operands & Operands_Imm8 ) {
+        i += 1;
+    }
+    if( operands & Operands_Imm16 ) {
+        i += 2;
+    }
+    if( operands & Operands_Imm32 ) {
+        i += 4;
+    }
+    if( operands & Operands_ImmZ ) {
+        i += immz;
+    }
+    if( operands & Operands_ImmV ) {
+        i += rexW ? 8 : immz;
+    }
+    if( operands & Operands_Rel ) {
+        if( insn != nullptr ) {
+            insn->rel = i;
+            insn->relSize = x64 ? 4 : immz;
+        }
+        i += x64 ? 4 : immz;
+    }
+    if( operands & Operands_Rel8 ) {
+        if( insn != nullptr ) {
+            insn->rel = i;
+            insn->relSize = 1;
+        }
+        i += 1;
+    }
+    if( operands & Operands_MOffs ) {
+        i += x64 ? ( addrPrefix ? 4 : 8 ) : ( addrPrefix ? 2 : 4 );
+    }
+    if( operands & Operands_Far ) {
+        i += immz + 2;
+    }
+
+    if( insn != nullptr ) {
+        insn->length = i <= size ? i : 0;
+    }
+    return i <= size ? i : 0;
+}
+
+size_t GetInstructionLength( const uint8_t* code, size_t size ) {
+    return DecodeLength( code, size, INSN_X64 );
+}
+
+bool DecodeInstruction( const uint8_t* code, size_t size, X86Instruction &insn ) {
+    return DecodeLength( code, size, INSN_X64, &insn ) != 0;
+}
+
+// Displacement from the end of an instruction at "next" to "target", or false if it does not
+// fit in 32 bits. Addresses wrap around outside of x86_64, where everything is in reach
+static bool GetDisplacement( uintptr_t target, uintptr_t next, int32_t &disp ) {
+    intptr_t diff = static_cast< intptr_t >( target - next );
+    if( INSN_X64 && ( diff < INT32_MIN || diff > INT32_MAX ) ) {
+        return false;
+    }
+
+    disp = static_cast< int32_t >( diff );
+    return true;
+}
+
+size_t RelocateInstructions( const uint8_t* code, size_t size, uintptr_t from, uintptr_t to, uint8_t* out, size_t outSize ) {
+    size_t in = 0, written = 0;
+    while( in < size ) {
+        X86Instruction insn;
+        if( !DecodeInstruction( code + in, size - in, insn ) ) {
+            return 0;
+        }
+
+        uint8_t moved[X86_MAX_INSN_LENGTH + 4];
+        size_t length = insn.length;
+        memcpy( moved, code + in, length );
+
+        uintptr_t next = from + in + insn.length;
+        if( insn.relSize ) {
+            int32_t disp;
+            if( insn.relSize == 1 ) {
+                disp = static_cast< int8_t >( code[in + insn.rel] );
+            } else if( insn.relSize == 4 ) {
+                memcpy( &disp, code + in + insn.rel, sizeof( disp ) );
+            } else {
+                return 0;
+            }
+
+            // Such a branch would land in the middle of whatever replaced the copied code
+            uintptr_t target = next + static_cast< intptr_t >( disp );
+            if( target > from && target < from + size ) {
+                return 0;
+            }
+
+            size_t field = insn.rel;
+            if( insn.relSize == 1 ) {
+                uint8_t op = code[in + insn.rel - 1];
+                field--;
+
+                if( op == 0xEB ) {
+                    moved[field++] = 0xE9;
+                } else if( op >= 0x70 && op <= 0x7F ) {
+                    moved[field++] = 0x0F;
+                    moved[field++] = static_cast< uint8_t >( 0x80 | ( op & 0x0F ) );
+                } else {
+                    // LOOP and JCXZ have no long form
+                    return 0;
+                }
+                length = field + 4;
+            }
+
+            if( !GetDisplacement( target, to + written + length, disp ) ) {
+                return 0;
+            }
+            memcpy( moved + field, &disp, sizeof( disp ) );
+        } else if( insn.ripDisp ) {
+            int32_t disp;
+            memcpy( &disp, code + in + insn.ripDisp, sizeof( disp ) );
+
+            if( !GetDisplacement( next + static_cast< intptr_t >( disp ), to + written + length, disp ) ) {
+                return 0;
+            }
+            memcpy( moved + insn.ripDisp, &disp, sizeof( disp ) );
+        }
+
+        if( written + length > outSize ) {
+            return 0;
+        }
+
+        if( out != nullptr ) {
+            memcpy( out + written, moved, length );
+        }
+        written += length;
+        in += insn.length;
+    }
+    return written;
+}
+
+size_t GetInstructionLengthAt( const void* addr ) {
+    uint8_t code[X86_MAX_INSN_LENGTH];
+
+    // The instruction may end well before a page that is not mapped
+    size_t read = ReadMemorySafe( code, addr, sizeof( code ) );
+    return DecodeLength( code, read, INSN_X64 );
+}
+
+size_t GetInstructionsLengthAt( const void* addr, size_t count ) {
+    auto code = reinterpret_cast< const uint8_t* >( addr );
+
+    size_t total = 0;
+    while( count-- ) {
+        size_t length = GetInstructionLengthAt( code + total );
+        if( !length ) {
+            return 0;
+        }
+        total += length;
+    }
+    return total;
+}
+
+// Indexed by length - 1
+static const uint8_t s_Nops[9][9] = {
+    { 0x90 },
+    { 0x66, 0x90 },
+    { 0x0F, 0x1F, 0x00 },
+    { 0x0F, 0x1F, 0x40, 0x00 },
+    { 0x0F, 0x1F, 0x44, 0x00, 0x00 },
+    { 0x66, 0x0F, 0x1F, 0x44, 0x00, 0x00 },
+    { 0x0F, 0x1F, 0x80, 0x00, 0x00, 0x00, 0x00 },
+    { 0x0F, 0x1F, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00 },
+    { 0x66, 0x0F, 0x1F, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00 }
+};
+
+void FillNops( uint8_t* out, size_t size ) {
+    while( size ) {
+        size_t length = size < 9 ? size : 9;
+        memcpy( out, s_Nops[length - 1], length );
+
+        out += length;
+        size -= length;
+    }
+}
@@ -0,0 +1,84 @@
+/**
+ * vim: set ts=4 sw=4 tw=99 noet :
+ * =============================================================================
+ * SourceMod Source Scramble Extension
+ * 
+ * Copyright (C) 2019 nosoop
+ * Copyright (C) 2023 cravenge
+ *
+ * All rights reserved
+ * =============================================================================
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License, version 3.0, as published by the
+ * Free Software Foundation
+ * 
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>
+ *
+ * As a special exception, AlliedModders LLC gives you permission to link the
+ * code of this program (as well as its derivative works) to "Half-Life 2", the
+ * "Source Engine", the "SourcePawn JIT" and any Game MODs that run on software
+ * by the Valve Corporation. You must obey the GNU General Public License in
+ * all respects for all other code used. Additionally, AlliedModders LLC grants
+ * this exception to all derivative works. AlliedModders LLC defines further
+ * exceptions, found in LICENSE.txt (as of this writing, version JULY-31-2007),
+ * or <http://www.sourcemod.net/license.php>
+ *
+ * Version: $Id$
+ */
+
+#ifndef _INCLUDE_SOURCEMOD_SRCSCRMBL_X86INSN_H_
+#define _INCLUDE_SOURCEMOD_SRCSCRMBL_X86INSN_H_
+
+# ifndef _STDLIB_H_
+# include <stdlib.h>
+
+# endif
+# ifndef _STDINT_H
+# include "stdint.h"
+
+# endif
+// Longest encoding the CPU accepts
+static constexpr size_t X86_MAX_INSN_LENGTH = 15;
+
+// Length of the instruction at the start of "code", decoded for the architecture this
+// extension was built for. Returns 0 if the bytes are not a valid instruction or it would
+// need more than "size" bytes
+size_t GetInstructionLength( const uint8_t* code, size_t size );
+
+// Same as above, but reads the instruction from memory that may not be mapped
+size_t GetInstructionLengthAt( const void* addr );
+
+// Total length of the first "count" instructions at "addr", or 0 if any of them cannot be
+// decoded
+size_t GetInstructionsLengthAt( const void* addr, size_t count );
+
+// Where the operands that depend on the instruction's own address sit, as offsets from its
+// first byte
+struct X86Instruction {
+    size_t length;
+    size_t ripDisp;     // 32-bit RIP-relative displacement, or 0 (x86_64 only)
+    size_t rel;         // Branch or call displacement, or 0
+    size_t relSize;     // Size of that displacement in bytes
+};
+
+// Same as GetInstructionLength, but also tells where the relative operands are
+bool DecodeInstruction( const uint8_t* code, size_t size, X86Instruction &insn );
+
+// Copies the instructions in "code", which ran at "from", into "out" so that they run the same
+// at "to". RIP-relative operands and branches are adjusted, and short branches are widened to
+// their rel32 forms. "out" may be null to only measure the copy. Returns its length, or 0 if
+// an instruction cannot be moved, such as LOOP or a branch into the copied code itself
+size_t RelocateInstructions( const uint8_t* code, size_t size, uintptr_t from, uintptr_t to, uint8_t* out, size_t outSize );
+
+// Fills "out" with as few NOP instructions as possible, using the multi-byte forms the
+// Intel and AMD optimization manuals recommend
+void FillNops( uint8_t* out, size_t size );
+
+#endif // _INCLUDE_SOURCEMOD_SRCSCRMBL_X86INSN_H_